@@ -5,6 +5,7 @@
 #include <bench/bench.h>
 
 #include <crypto/sha256.h>
+#include <libdevcore/SHA3.h>
 #include <key.h>
 #include <validation.h>
 #include <util.h>
@@ -43,6 +44,7 @@ main(int argc, char** argv)
     }
 
     SHA256AutoDetect();
+    dev::sha3AutoDetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
@@ -14,6 +14,7 @@
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
+#include <libdevcore/SHA3.h>
 
 /* Number of bytes to hash per iteration */
 static const uint64_t BUFFER_SIZE = 1000*1000;
@@ -52,6 +53,14 @@ static void SHA256_32b(benchmark::State& state)
     }
 }
 
+static void SHA256D64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256D64(in.data(), in.data(), 1024);
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -60,6 +69,48 @@ static void SHA512(benchmark::State& state)
         CSHA512().Write(in.data(), in.size()).Finalize(hash);
 }
 
+static void KECCAK256(benchmark::State& state)
+{
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        dev::sha3(dev::bytesConstRef(in.data(), in.size()));
+}
+
+static void KECCAK256_32b(benchmark::State& state)
+{
+    dev::h256 x;
+    while (state.KeepRunning())
+        x = dev::sha3(x);
+}
+
+/* Storage keys of a contract commit, hashed in one batch */
+static void KECCAK256_32b_Batch64(benchmark::State& state)
+{
+    std::vector<dev::h256> keys(64);
+    std::vector<dev::bytesConstRef> refs;
+    for (size_t i = 0; i < keys.size(); i++) {
+        keys[i] = dev::h256(i);
+        refs.push_back(keys[i].ref());
+    }
+    std::vector<dev::h256> hashes(keys.size());
+    while (state.KeepRunning())
+        dev::sha3(refs.data(), refs.size(), hashes.data());
+}
+
+static void Keccakf1600(benchmark::State& state)
+{
+    uint64_t lanes[25] = {0};
+    while (state.KeepRunning())
+        dev::keccak::keccakf(lanes);
+}
+
+static void Keccakf1600_Portable(benchmark::State& state)
+{
+    uint64_t lanes[25] = {0};
+    while (state.KeepRunning())
+        dev::keccak::keccakfPortable(lanes);
+}
+
 static void SipHash_32b(benchmark::State& state)
 {
     uint256 x;
@@ -91,8 +142,14 @@ BENCHMARK(RIPEMD160, 440);
 BENCHMARK(SHA1, 570);
 BENCHMARK(SHA256, 340);
 BENCHMARK(SHA512, 330);
+BENCHMARK(KECCAK256, 200);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
+BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(KECCAK256_32b, 1500 * 1000);
+BENCHMARK(KECCAK256_32b_Batch64, 60 * 1000);
+BENCHMARK(Keccakf1600, 1500 * 1000);
+BENCHMARK(Keccakf1600_Portable, 1200 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -0,0 +1,187 @@
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/qtum_state.h>
+
+#include <qtum/qtumDGP.h>
+#include <random.h>
+#include <validation.h>
+
+#include <cassert>
+
+// The contract benchmarks execute one transaction per iteration, so the
+// median is the time per transaction. Dividing the gasUsed of the receipt
+// of a reference transaction by it gives gas/sec.
+
+static const uint32_t STORE_SLOTS = 16;
+static const uint32_t CALLER_CALLS = 16;
+
+static void ExecuteTx(const dev::eth::EnvInfo& envInfo, const QtumTransaction& tx)
+{
+    ResultExecute result = globalState->execute(envInfo, *globalSealEngine.get(), tx);
+    assert(result.execRes.excepted == dev::eth::TransactionException::None);
+    globalSealEngine->deleteAddresses.clear();
+}
+
+static void QtumExecuteTokenTransfer(benchmark::State& state)
+{
+    QtumStateFixture& fixture = GetQtumStateFixture();
+    dev::eth::EnvInfo envInfo(fixture.BuildEnv());
+
+    // Rotate over a set of recipients: the first transfers create balances,
+    // later ones update them
+    std::vector<QtumTransaction> txs;
+    for (int i = 0; i < 1000; i++)
+        txs.push_back(fixture.MakeTransferTx(dev::Address(dev::u160(i + 1)), 1));
+
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        ExecuteTx(envInfo, txs[n++ % txs.size()]);
+    }
+}
+
+static void QtumExecuteStorageWrite(benchmark::State& state)
+{
+    QtumStateFixture& fixture = GetQtumStateFixture();
+    dev::eth::EnvInfo envInfo(fixture.BuildEnv());
+    QtumTransaction tx(fixture.MakeStoreTx(STORE_SLOTS));
+
+    while (state.KeepRunning()) {
+        ExecuteTx(envInfo, tx);
+    }
+}
+
+static void QtumExecuteContractCalls(benchmark::State& state)
+{
+    QtumStateFixture& fixture = GetQtumStateFixture();
+    dev::eth::EnvInfo envInfo(fixture.BuildEnv());
+    QtumTransaction tx(fixture.MakeCallTx(CALLER_CALLS));
+
+    while (state.KeepRunning()) {
+        ExecuteTx(envInfo, tx);
+    }
+}
+
+// A block worth of mixed contract transactions through ByteCodeExec, which
+// also commits the state and UTXO databases.
+static void QtumByteCodeExecBlock(benchmark::State& state)
+{
+    QtumStateFixture& fixture = GetQtumStateFixture();
+    std::vector<QtumTransaction> txs;
+    for (int i = 0; i < 10; i++) {
+        txs.push_back(fixture.MakeTransferTx(dev::Address(dev::u160(i + 1)), 1));
+        txs.push_back(fixture.MakeStoreTx(STORE_SLOTS));
+        txs.push_back(fixture.MakeCallTx(CALLER_CALLS));
+    }
+
+    while (state.KeepRunning()) {
+        ByteCodeExec exec(fixture.block, txs, fixture.nBlockGasLimit);
+        bool fExecuted = exec.performByteCode();
+        assert(fExecuted);
+        ByteCodeExecResult bceResult;
+        bool fProcessed = exec.processingResults(bceResult);
+        assert(fProcessed);
+    }
+}
+
+// Value transfers of a contract execution that passes coins around a ring
+// of contracts which already own an output.
+static std::vector<TransferInfo> MakeContractTransfers(int nContracts, int nTransfers)
+{
+    std::vector<dev::Address> contracts;
+    for (int i = 0; i < nContracts; i++) {
+        contracts.push_back(dev::Address(dev::u160(0x1000 + i)));
+        globalState->setCacheUTXO(contracts.back(), Vin{uintToh256(GetRandHash()), 0, 100000, 1});
+    }
+
+    std::vector<TransferInfo> transfers;
+    for (int i = 0; i < nTransfers; i++)
+        transfers.push_back(TransferInfo{contracts[(i * 7) % nContracts], contracts[(i * 7 + 1) % nContracts], dev::u256(1000 + i)});
+    return transfers;
+}
+
+static void QtumCondensingTX(benchmark::State& state)
+{
+    QtumStateFixture& fixture = GetQtumStateFixture();
+    std::vector<TransferInfo> transfers = MakeContractTransfers(8, 32);
+    QtumTransaction tx(fixture.MakeCallTx(0));
+    std::set<dev::Address> deleteAddresses;
+
+    while (state.KeepRunning()) {
+        CondensingTX ctx(globalState.get(), transfers, tx, deleteAddresses);
+        CTransaction condensed(ctx.createCondensingTX());
+        assert(!condensed.IsNull());
+        ctx.createVin(condensed);
+    }
+
+    // Drop the synthetic outputs again
+    globalState->setRootUTXO(globalState->rootHashUTXO());
+}
+
+// A block of 100 executions with many internal contract-to-contract
+// transfers each, condensed one after the other as ConnectBlock does.
+static void QtumCondensingTXBlock(benchmark::State& state)
+{
+    QtumStateFixture& fixture = GetQtumStateFixture();
+    std::vector<TransferInfo> transfers = MakeContractTransfers(64, 256);
+    QtumTransaction tx(fixture.MakeCallTx(0));
+    std::set<dev::Address> deleteAddresses;
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 100; i++) {
+            CondensingTX ctx(globalState.get(), transfers, tx, deleteAddresses);
+            CTransaction condensed(ctx.createCondensingTX());
+            assert(!condensed.IsNull());
+            ctx.createVin(condensed);
+        }
+    }
+
+    globalState->setRootUTXO(globalState->rootHashUTXO());
+}
+
+static void QtumDGPGetValues(benchmark::State& state)
+{
+    GetQtumStateFixture();
+    unsigned int nHeight = chainActive.Height() + 1;
+
+    while (state.KeepRunning()) {
+        QtumDGP qtumDGP(globalState.get(), true);
+        qtumDGP.getGasSchedule(nHeight);
+        qtumDGP.getBlockSize(nHeight);
+        qtumDGP.getMinGasPrice(nHeight);
+        qtumDGP.getBlockGasLimit(nHeight);
+    }
+}
+
+// Receipts of a block of token transfers, each with one log entry
+static void QtumStorageResultsCommit(benchmark::State& state)
+{
+    QtumStateFixture& fixture = GetQtumStateFixture();
+
+    dev::eth::LogEntries logs;
+    logs.push_back(dev::eth::LogEntry(fixture.token, {dev::h256(1), dev::h256(2), dev::h256(3)}, dev::bytes(32, 1)));
+    std::vector<TransactionReceiptInfo> receipts;
+    for (int i = 0; i < 100; i++) {
+        receipts.push_back(TransactionReceiptInfo{GetRandHash(), 100000, GetRandHash(), (uint32_t)i, fixture.sender, fixture.token,
+            21000 * (uint64_t)(i + 1), 21000, dev::Address(), logs, dev::eth::TransactionException::None});
+    }
+
+    while (state.KeepRunning()) {
+        for (TransactionReceiptInfo& receipt : receipts) {
+            receipt.transactionHash = GetRandHash();
+            std::vector<TransactionReceiptInfo> result(1, receipt);
+            pstorageresult->addResult(uintToh256(receipt.transactionHash), result);
+        }
+        pstorageresult->commitResults();
+    }
+}
+
+BENCHMARK(QtumExecuteTokenTransfer, 2000);
+BENCHMARK(QtumExecuteStorageWrite, 500);
+BENCHMARK(QtumExecuteContractCalls, 1000);
+BENCHMARK(QtumByteCodeExecBlock, 20);
+BENCHMARK(QtumCondensingTX, 20 * 1000);
+BENCHMARK(QtumCondensingTXBlock, 20);
+BENCHMARK(QtumDGPGetValues, 500);
+BENCHMARK(QtumStorageResultsCommit, 100);
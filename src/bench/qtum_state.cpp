@@ -0,0 +1,197 @@
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/qtum_state.h>
+
+#include <chainparams.h>
+#include <random.h>
+#include <util.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+
+#include <leveldb/env.h>
+#include <memenv.h>
+
+#include <cassert>
+
+/*
+    contract token {
+        mapping(address => uint256) balances;
+
+        function token() { balances[msg.sender] = 10**27; }
+
+        function transfer(address to, uint256 value) returns (bool) {
+            require(balances[msg.sender] >= value);
+            balances[msg.sender] -= value;
+            balances[to] += value;
+            Transfer(msg.sender, to, value);
+            return true;
+        }
+
+        function balanceOf(address owner) returns (uint256) { return balances[owner]; }
+    }
+*/
+static const char* TOKEN_CODE = "33600052600060205260406000206b033b2e3c9fd0803ce800000090556100c78061002a6000396000f36000357c010000000000000000000000000000000000000000000000000000000090048063a9059cbb1461005457806370a082311461003a57fe5b600435600052600060205260406000205460005260206000f35b336000526000602052604060002080546024358082106100c55790039055600435600052600060205260406000208054602435019055602435600052600435337fddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef60206000a3600160005260206000f35bfe";
+
+/*
+    contract store {
+        // slot 0 counts the slots written so far, calldata holds n
+        function () {
+            for (uint256 i = slot[0] + 1; i <= slot[0] + n; i++)
+                slot[i] = i;
+            slot[0] += n;
+        }
+    }
+*/
+static const char* STORE_CODE = "6100228061000d6000396000f36000546000358101905b8181101561001c57600101808055610009565b5060005500";
+
+/*
+    contract caller {
+        // calldata holds the token address and n
+        function () {
+            for (uint256 i = 0; i < n; i++)
+                require(token(target).balanceOf(this));
+        }
+    }
+*/
+static const char* CALLER_CODE = "6100528061000d6000396000f37f70a0823100000000000000000000000000000000000000000000000000000000600052306004526020355b801561004e57602060406024600060006000355af115610050576001900361002b565b005bfe";
+
+static const dev::u256 BENCH_GAS_LIMIT = 1000000;
+static const dev::u256 BENCH_GAS_PRICE = 40;
+// Past the EIP158 and UTXO cache fixes on mainnet
+static const int BENCH_TIP_HEIGHT = 100000;
+
+static dev::bytes EncodeWord(const dev::u256& value)
+{
+    return dev::toBigEndian(value);
+}
+
+QtumStateFixture::QtumStateFixture()
+{
+    // QtumState::execute looks at the consensus params
+    SelectParams(CBaseChainParams::MAIN);
+    const CChainParams& chainparams = Params();
+
+    pathTemp = fs::temp_directory_path() / strprintf("bench_qtum_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    fs::create_directories(pathTemp);
+
+    // Keep the account state in memory so that disk speed does not show up
+    penv.reset(leveldb::NewMemEnv(leveldb::Env::Default()));
+    leveldb::Options options;
+    options.create_if_missing = true;
+    options.env = penv.get();
+    leveldb::DB* pdb = nullptr;
+    leveldb::Status status = leveldb::DB::Open(options, "/state", &pdb);
+    assert(status.ok());
+
+    dev::eth::Ethash::init();
+    globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), dev::OverlayDB(pdb), pathTemp.string(), dev::eth::BaseState::Empty));
+    dev::eth::ChainParams cp((dev::eth::genesisInfo(dev::eth::Network::qtumMainNetwork)));
+    globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
+    globalState->populateFrom(cp.genesisState);
+    globalState->setRootUTXO(uintToh256(chainparams.GenesisBlock().hashUTXORoot));
+    globalState->db().commit();
+    globalState->dbUtxo().commit();
+    pstorageresult.reset(new StorageResults(pathTemp.string()));
+
+    hashTip = GetRandHash();
+    indexTip.phashBlock = &hashTip;
+    indexTip.nHeight = BENCH_TIP_HEIGHT;
+    chainActive.SetTip(&indexTip);
+
+    CMutableTransaction coinbase;
+    coinbase.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << ParseHex("abababababababababababababababababababab") << OP_EQUALVERIFY << OP_CHECKSIG));
+    block.vtx.push_back(MakeTransactionRef(CTransaction(coinbase)));
+    block.nTime = chainparams.GenesisBlock().nTime;
+    block.nBits = chainparams.GenesisBlock().nBits;
+
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    globalSealEngine->setQtumSchedule(qtumDGP.getGasSchedule(BENCH_TIP_HEIGHT + 1));
+    nBlockGasLimit = qtumDGP.getBlockGasLimit(BENCH_TIP_HEIGHT + 1);
+
+    sender = dev::Address("0101010101010101010101010101010101010101");
+    token = Deploy(ParseHex(TOKEN_CODE), 0);
+    store = Deploy(ParseHex(STORE_CODE), 1);
+    caller = Deploy(ParseHex(CALLER_CODE), 2);
+}
+
+QtumStateFixture::~QtumStateFixture()
+{
+    chainActive.SetTip(nullptr);
+    pstorageresult.reset();
+    globalState.reset();
+    globalSealEngine.reset();
+    penv.reset();
+    fs::remove_all(pathTemp);
+}
+
+QtumTransaction QtumStateFixture::MakeTx(const dev::Address& addrTo, const dev::bytes& data) const
+{
+    QtumTransaction tx;
+    if (addrTo == dev::Address()) {
+        tx = QtumTransaction(dev::u256(0), BENCH_GAS_PRICE, BENCH_GAS_LIMIT, data, dev::u256(0));
+    } else {
+        tx = QtumTransaction(dev::u256(0), BENCH_GAS_PRICE, BENCH_GAS_LIMIT, addrTo, data, dev::u256(0));
+    }
+    tx.forceSender(sender);
+    tx.setHashWith(uintToh256(GetRandHash()));
+    tx.setNVout(0);
+    tx.setVersion(VersionVM::GetEVMDefault());
+    return tx;
+}
+
+dev::Address QtumStateFixture::Deploy(const dev::bytes& code, uint32_t n)
+{
+    QtumTransaction tx = MakeTx(dev::Address(), code);
+    tx.setNVout(n);
+
+    ByteCodeExec exec(block, std::vector<QtumTransaction>(1, tx), nBlockGasLimit);
+    bool fExecuted = exec.performByteCode();
+    assert(fExecuted);
+    const ResultExecute& result = exec.getResult()[0];
+    assert(result.execRes.excepted == dev::eth::TransactionException::None);
+    return result.execRes.newAddress;
+}
+
+QtumTransaction QtumStateFixture::MakeTransferTx(const dev::Address& addrTo, const dev::u256& nAmount) const
+{
+    dev::bytes data = ParseHex("a9059cbb");
+    dev::bytes to = EncodeWord(dev::u256(dev::u160(addrTo)));
+    dev::bytes amount = EncodeWord(nAmount);
+    data.insert(data.end(), to.begin(), to.end());
+    data.insert(data.end(), amount.begin(), amount.end());
+    return MakeTx(token, data);
+}
+
+QtumTransaction QtumStateFixture::MakeStoreTx(uint32_t nSlots) const
+{
+    return MakeTx(store, EncodeWord(nSlots));
+}
+
+QtumTransaction QtumStateFixture::MakeCallTx(uint32_t nCalls) const
+{
+    dev::bytes data = EncodeWord(dev::u256(dev::u160(token)));
+    dev::bytes calls = EncodeWord(nCalls);
+    data.insert(data.end(), calls.begin(), calls.end());
+    return MakeTx(caller, data);
+}
+
+dev::eth::EnvInfo QtumStateFixture::BuildEnv() const
+{
+    dev::eth::EnvInfo env;
+    env.setNumber(dev::u256(BENCH_TIP_HEIGHT + 1));
+    env.setTimestamp(dev::u256(block.nTime));
+    env.setDifficulty(dev::u256(block.nBits));
+    dev::eth::LastHashes lh(256);
+    lh[0] = uintToh256(hashTip);
+    env.setLastHashes(std::move(lh));
+    env.setGasLimit(nBlockGasLimit);
+    env.setAuthor(dev::Address("abababababababababababababababababababab"));
+    return env;
+}
+
+QtumStateFixture& GetQtumStateFixture()
+{
+    static std::unique_ptr<QtumStateFixture> fixture(new QtumStateFixture());
+    return *fixture;
+}
@@ -0,0 +1,69 @@
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_QTUM_STATE_H
+#define BITCOIN_BENCH_QTUM_STATE_H
+
+#include <chain.h>
+#include <fs.h>
+#include <primitives/block.h>
+#include <qtum/qtumstate.h>
+
+#include <memory>
+#include <vector>
+
+namespace leveldb {
+class Env;
+}
+
+/**
+ * Contract state shared by the EVM benchmarks.
+ *
+ * Sets up globalState, globalSealEngine and pstorageresult the way init does,
+ * except that the account state is kept in a LevelDB on a memory environment,
+ * and deploys the reference contracts through ByteCodeExec:
+ *  - token: ERC20 style transfer(address,uint256) and balanceOf(address)
+ *  - store: every call writes n fresh storage slots
+ *  - caller: every call makes n calls to token.balanceOf(this)
+ *
+ * chainActive is pointed at a single block index so that ByteCodeExec can
+ * build its environment.
+ */
+class QtumStateFixture
+{
+public:
+    QtumStateFixture();
+    ~QtumStateFixture();
+
+    /** Call the token transfer function, sending nAmount to addrTo */
+    QtumTransaction MakeTransferTx(const dev::Address& addrTo, const dev::u256& nAmount) const;
+    /** Call the store contract, writing nSlots new storage slots */
+    QtumTransaction MakeStoreTx(uint32_t nSlots) const;
+    /** Call the caller contract, making nCalls calls into the token */
+    QtumTransaction MakeCallTx(uint32_t nCalls) const;
+
+    dev::eth::EnvInfo BuildEnv() const;
+
+    /** Block the transactions are executed in; its coinbase is the author */
+    CBlock block;
+    uint64_t nBlockGasLimit;
+
+    dev::Address sender;
+    dev::Address token;
+    dev::Address store;
+    dev::Address caller;
+
+private:
+    QtumTransaction MakeTx(const dev::Address& addrTo, const dev::bytes& data) const;
+    dev::Address Deploy(const dev::bytes& code, uint32_t n);
+
+    fs::path pathTemp;
+    std::unique_ptr<leveldb::Env> penv;
+    uint256 hashTip;
+    CBlockIndex indexTip;
+};
+
+/** Fixture built on first use */
+QtumStateFixture& GetQtumStateFixture();
+
+#endif // BITCOIN_BENCH_QTUM_STATE_H
@@ -0,0 +1,175 @@
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/stake_chain.h>
+
+#include <chainparams.h>
+#include <crypto/sha256.h>
+#include <script/script.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+
+static uint256 HeightHash(const char* tag, uint32_t n, uint32_t i = 0)
+{
+    uint256 hash;
+    CSHA256().Write((const unsigned char*)tag, strlen(tag)).Write((const unsigned char*)&n, sizeof(n)).Write((const unsigned char*)&i, sizeof(i)).Finalize(hash.begin());
+    return hash;
+}
+
+static std::vector<unsigned char> KeyID(const uint256& seed)
+{
+    return std::vector<unsigned char>(seed.begin(), seed.begin() + 20);
+}
+
+CMutableTransaction MakeBenchSStx(const uint256& seed, int nInputs)
+{
+    CMutableTransaction tx;
+    tx.nVersion = 0;
+    tx.vin.resize(nInputs);
+    tx.vout.resize(nInputs * 2 + 1);
+    tx.vout[0].nValue = 0x2123e300 * (CAmount)nInputs;
+    tx.vout[0].scriptPubKey = CScript() << OP_SSTX << OP_DUP << OP_HASH160 << KeyID(seed) << OP_EQUALVERIFY << OP_CHECKSIG;
+    for (int i = 0; i < nInputs; i++) {
+        tx.vin[i].prevout = COutPoint(seed, i);
+        // Signature and pubkey sized placeholders
+        tx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30) << std::vector<unsigned char>(33, 0x02);
+
+        // Commitment: 20 byte address, 8 byte amount, 2 byte fee limits
+        std::vector<unsigned char> commitment(30, 0);
+        std::copy(seed.begin(), seed.begin() + 20, commitment.begin());
+        commitment[22] = 0xe3; commitment[23] = 0x23; commitment[24] = 0x21;
+        commitment[28] = 0x44; commitment[29] = 0x3f;
+        tx.vout[i * 2 + 1].scriptPubKey = CScript() << OP_RETURN << commitment;
+        tx.vout[i * 2 + 2].nValue = 0x2223e300;
+        tx.vout[i * 2 + 2].scriptPubKey = CScript() << OP_SSTXCHANGE << OP_DUP << OP_HASH160 << KeyID(seed) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return tx;
+}
+
+CMutableTransaction MakeBenchSSGen(const uint256& ticketHash, const uint256& votedHash, uint32_t votedHeight)
+{
+    CMutableTransaction tx;
+    tx.nVersion = 0;
+    tx.vin.resize(2);
+    tx.vin[0].prevout.SetNull();
+    tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>{0x04, 0xff, 0xff, 0x00, 0x1d, 0x01, 0x04};
+    tx.vin[1].prevout = COutPoint(ticketHash, 0);
+    tx.vin[1].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30) << std::vector<unsigned char>(33, 0x02);
+
+    // Block reference: 32 byte hash and 4 byte height
+    std::vector<unsigned char> reference(votedHash.begin(), votedHash.end());
+    for (int i = 0; i < 4; i++)
+        reference.push_back((votedHeight >> (8 * i)) & 0xff);
+    tx.vout.resize(3);
+    tx.vout[0].scriptPubKey = CScript() << OP_RETURN << reference;
+    tx.vout[1].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>{0x01, 0x00};
+    tx.vout[2].nValue = 0x2123e300;
+    tx.vout[2].scriptPubKey = CScript() << OP_SSGEN << OP_DUP << OP_HASH160 << KeyID(ticketHash) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return tx;
+}
+
+CMutableTransaction MakeBenchSSRtx(const uint256& ticketHash)
+{
+    CMutableTransaction tx;
+    tx.nVersion = 0;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(ticketHash, 0);
+    tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30) << std::vector<unsigned char>(33, 0x02);
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 0x2123e300;
+    tx.vout[0].scriptPubKey = CScript() << OP_SSRTX << OP_DUP << OP_HASH160 << KeyID(ticketHash) << OP_EQUALVERIFY << OP_CHECKSIG;
+    tx.vout[1].nValue = 0x2223e300;
+    tx.vout[1].scriptPubKey = CScript() << OP_SSRTX << OP_HASH160 << KeyID(ticketHash) << OP_EQUAL;
+    return tx;
+}
+
+StakeChainFixture::StakeChainFixture(int nBlocksIn, int nFreshStakeIn) :
+    params(CreateChainParams(CBaseChainParams::MAIN)->GetConsensus()), nBlocks(nBlocksIn), nFreshStake(nFreshStakeIn)
+{
+    // Enable the lottery early so that most of the chain is spent voting
+    params.StakeEnabledHeight = 1;
+    params.StakeValidationHeight = std::max(2, nBlocks / 4);
+
+    // Size everything up front: nodes and index entries are referenced by address
+    vNodes.resize(nBlocks + 1);
+    vNewTickets.resize(nBlocks + 1);
+    vVoted.resize(nBlocks + 1);
+    vRevoked.resize(nBlocks + 1);
+    vLotteryIV.resize(nBlocks + 1);
+    vBlockHashes.resize(nBlocks + 1);
+    vIndex.resize(nBlocks + 1);
+
+    vBlockHashes[0] = HeightHash("block", 0);
+    vIndex[0].phashBlock = &vBlockHashes[0];
+    vIndex[0].sBits = params.MinimumStakeDiff;
+
+    // The votes of each block depend on the winners of its parent, so the
+    // inputs are generated while connecting the chain for the first time.
+    vNodes[0].genesisNode(params);
+    TicketHashes missed;
+    for (int h = 1; h <= nBlocks; h++) {
+        for (int i = 0; i < nFreshStake; i++)
+            vNewTickets[h].push_back(MakeBenchSStx(HeightHash("sstx", h, i), 1).GetHash());
+
+        // All winners of the parent vote except the last one, which is
+        // missed here and revoked in the next block.
+        vVoted[h] = vNodes[h - 1].Winners();
+        vRevoked[h] = missed;
+        missed.clear();
+        if (!vVoted[h].empty()) {
+            missed.push_back(vVoted[h].back());
+            vVoted[h].pop_back();
+        }
+
+        vLotteryIV[h] = HeightHash("lottery", h);
+        bool fConnected = connectNode(vNodes[h - 1], vLotteryIV[h], vVoted[h], vRevoked[h], vNewTickets[h], vNodes[h]);
+        assert(fConnected);
+
+        vBlockHashes[h] = HeightHash("block", h);
+        CBlockIndex& index = vIndex[h];
+        index.phashBlock = &vBlockHashes[h];
+        index.pprev = &vIndex[h - 1];
+        index.nHeight = h;
+        index.poolSize = vNodes[h].PoolSize();
+        index.freshStake = nFreshStake;
+        index.sBits = params.MinimumStakeDiff;
+        index.BuildSkip();
+    }
+}
+
+void StakeChainFixture::ConnectChain(std::vector<TicketNode>& nodes, int nHeight)
+{
+    assert(nHeight > 0 && nHeight <= nBlocks);
+    nodes.clear();
+    nodes.resize(nHeight + 1);
+    nodes[0].genesisNode(params);
+    for (int h = 1; h <= nHeight; h++) {
+        bool fConnected = connectNode(nodes[h - 1], vLotteryIV[h], vVoted[h], vRevoked[h], vNewTickets[h], nodes[h]);
+        assert(fConnected);
+    }
+}
+
+CBlock StakeChainFixture::MakeStakeBlock(int nHeight) const
+{
+    assert(nHeight > 0 && nHeight <= nBlocks);
+    CBlock block;
+    block.hashPrevBlock = vBlockHashes[nHeight - 1];
+    for (int i = 0; i < nFreshStake; i++)
+        block.svtx.push_back(MakeTransactionRef(MakeBenchSStx(HeightHash("sstx", nHeight, i), 1)));
+    for (const uint256& ticket : vVoted[nHeight])
+        block.svtx.push_back(MakeTransactionRef(MakeBenchSSGen(ticket, vBlockHashes[nHeight - 1], nHeight - 1)));
+    for (const uint256& ticket : vRevoked[nHeight])
+        block.svtx.push_back(MakeTransactionRef(MakeBenchSSRtx(ticket)));
+    return block;
+}
+
+StakeChainFixture& GetStakeChainFixture()
+{
+    // 20 fresh tickets per block (MaxFreshStakePerBlock) over 2048 blocks
+    // leaves roughly 30000 live tickets at the tip.
+    static std::unique_ptr<StakeChainFixture> fixture(new StakeChainFixture(2048, 20));
+    return *fixture;
+}
@@ -0,0 +1,68 @@
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_STAKE_CHAIN_H
+#define BITCOIN_BENCH_STAKE_CHAIN_H
+
+#include <chain.h>
+#include <consensus/params.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <stake/tickets.h>
+#include <uint256.h>
+
+#include <vector>
+
+/**
+ * Deterministic synthetic stake chain shared by the stake benchmarks.
+ *
+ * Every block buys nFreshStake tickets, which enter the live pool at once,
+ * and all winners of the previous node but one vote. The winner that misses
+ * is revoked in the following block, so the live, missed and revoked treaps
+ * all see traffic. Everything is derived from the block height, so numbers
+ * are comparable between runs.
+ *
+ * Connecting a child updates the ticket treaps shared with its parent in
+ * place, so a node may only be connected on top of once. Benchmarks that
+ * connect or disconnect nodes rebuild their own chain with ConnectChain.
+ */
+class StakeChainFixture
+{
+public:
+    StakeChainFixture(int nBlocksIn, int nFreshStakeIn);
+
+    /** Build the svtx of the block at nHeight: its tickets, votes and revocation */
+    CBlock MakeStakeBlock(int nHeight) const;
+
+    /** Connect a fresh chain of nodes from genesis up to nHeight using the recorded inputs */
+    void ConnectChain(std::vector<TicketNode>& nodes, int nHeight);
+
+    /** Height of the last connected node */
+    int Tip() const { return nBlocks; }
+
+    Consensus::Params params;
+    int nBlocks;
+    int nFreshStake;
+
+    //! vNodes[h] is the stake node after connecting block h
+    std::vector<TicketNode> vNodes;
+    //! Tickets added to the live pool at each height
+    std::vector<TicketHashes> vNewTickets;
+    //! Tickets that voted at each height
+    std::vector<TicketHashes> vVoted;
+    //! Tickets revoked at each height
+    std::vector<TicketHashes> vRevoked;
+    std::vector<uint256> vLotteryIV;
+    std::vector<uint256> vBlockHashes;
+    //! Block index entries linked through pprev/pskip, with the stake fields filled in
+    std::vector<CBlockIndex> vIndex;
+};
+
+/** Mainnet-sized fixture, built on first use */
+StakeChainFixture& GetStakeChainFixture();
+
+CMutableTransaction MakeBenchSStx(const uint256& seed, int nInputs);
+CMutableTransaction MakeBenchSSGen(const uint256& ticketHash, const uint256& votedHash, uint32_t votedHeight);
+CMutableTransaction MakeBenchSSRtx(const uint256& ticketHash);
+
+#endif // BITCOIN_BENCH_STAKE_CHAIN_H
@@ -0,0 +1,160 @@
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/stake_chain.h>
+
+#include <pos.h>
+#include <stake/lottery.h>
+#include <stake/tickets.h>
+#include <stake/tickettreap/common.h>
+
+#include <cassert>
+#include <set>
+
+// Treap holding the live ticket pool at the tip of the synthetic chain. The
+// treap uses the purchase height as heap priority, so tickets are put in the
+// order they were bought, as the node does.
+static void BuildLivePool(StakeChainFixture& fixture, Immutable& treap, TicketHashes& hashes)
+{
+    TicketHashes live;
+    fixture.vNodes[fixture.Tip()].LiveTickets(live);
+    std::set<uint256> setLive(live.begin(), live.end());
+
+    hashes.clear();
+    for (int h = 1; h <= fixture.Tip(); h++) {
+        for (uint256& hash : fixture.vNewTickets[h]) {
+            if (setLive.count(hash)) {
+                treap.Put(hash, h, 0);
+                hashes.push_back(hash);
+            }
+        }
+    }
+}
+
+static void StakeImmutablePut(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+
+    while (state.KeepRunning()) {
+        Immutable treap;
+        TicketHashes hashes;
+        BuildLivePool(fixture, treap, hashes);
+    }
+}
+
+// Delete and put back one block worth of winners. Copies of a treap share
+// their nodes and Delete rewrites them in place, so the same treap is
+// restored instead of copied.
+static void StakeImmutableDeletePut(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    Immutable pool;
+    TicketHashes hashes;
+    BuildLivePool(fixture, pool, hashes);
+
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < fixture.params.TicketsPerBlock; i++)
+            pool.Delete(hashes[(n + i) % hashes.size()]);
+        for (int i = 0; i < fixture.params.TicketsPerBlock; i++)
+            pool.Put(hashes[(n + i) % hashes.size()], fixture.Tip(), 0);
+        n += fixture.params.TicketsPerBlock;
+    }
+}
+
+static void StakeImmutableGet(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    Immutable pool;
+    TicketHashes hashes;
+    BuildLivePool(fixture, pool, hashes);
+
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 100; i++)
+            assert(pool.Get(hashes[n++ % hashes.size()]) != nullptr);
+    }
+}
+
+static void StakeImmutableForEach(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    Immutable pool;
+    TicketHashes hashes;
+    BuildLivePool(fixture, pool, hashes);
+
+    while (state.KeepRunning()) {
+        TicketHashes all;
+        pool.ForEach(all);
+        assert(all.size() == hashes.size());
+    }
+}
+
+// Connect every node of the synthetic chain from genesis
+static void StakeConnectChain(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+
+    while (state.KeepRunning()) {
+        std::vector<TicketNode> nodes;
+        fixture.ConnectChain(nodes, fixture.Tip());
+    }
+}
+
+// Same as StakeConnectChain followed by disconnecting the top blocks, as
+// done during a reorg. The difference between the two is the cost of the
+// disconnects.
+static void StakeConnectChainDisconnect(benchmark::State& state)
+{
+    static const int REORG_DEPTH = 64;
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    int tip = fixture.Tip();
+
+    while (state.KeepRunning()) {
+        std::vector<TicketNode> nodes;
+        fixture.ConnectChain(nodes, tip);
+
+        for (int h = tip; h > tip - REORG_DEPTH; h--) {
+            std::vector<UndoTicketData> parentUtds = nodes[h - 1].UndoData();
+            TicketHashes parentTickets = nodes[h - 1].NewTickets();
+            bool fDisconnected = disconnectNode(nodes[h], fixture.vLotteryIV[h - 1], parentUtds, parentTickets, nodes[h - 1]);
+            assert(fDisconnected);
+        }
+    }
+}
+
+static void StakeFindTicketIdxs(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    int tip = fixture.Tip();
+    int32_t poolSize = fixture.vNodes[tip].PoolSize();
+
+    while (state.KeepRunning()) {
+        Hash256PRNG prng = NewHash256PRNGFromIV(fixture.vLotteryIV[tip]);
+        std::vector<int32_t> idxs;
+        bool fFound = findTicketIdxs(poolSize, fixture.params.TicketsPerBlock, prng, idxs);
+        assert(fFound);
+    }
+}
+
+static void StakeEstimateNextDifficulty(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    const CBlockIndex* pindexTip = &fixture.vIndex[fixture.Tip()];
+
+    while (state.KeepRunning()) {
+        int64_t sBits = 0;
+        estimateNextStakeDifficulty(fixture.params, pindexTip, 0, true, sBits);
+        estimateNextStakeDifficulty(fixture.params, pindexTip, 0, false, sBits);
+    }
+}
+
+BENCHMARK(StakeImmutablePut, 20);
+BENCHMARK(StakeImmutableDeletePut, 20 * 1000);
+BENCHMARK(StakeImmutableGet, 20 * 1000);
+BENCHMARK(StakeImmutableForEach, 500);
+BENCHMARK(StakeConnectChain, 5);
+BENCHMARK(StakeConnectChainDisconnect, 5);
+BENCHMARK(StakeFindTicketIdxs, 500 * 1000);
+BENCHMARK(StakeEstimateNextDifficulty, 5 * 1000);
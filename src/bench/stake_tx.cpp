@@ -0,0 +1,71 @@
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/stake_chain.h>
+
+#include <chain.h>
+#include <primitives/transaction.h>
+#include <stake/staketx.h>
+
+#include <cassert>
+
+static void StakeIsSStx(benchmark::State& state)
+{
+    const CTransaction sstx(MakeBenchSStx(uint256S("0x87a157f3fd88ac7907c05fc55e271dc4acdc5605d187d646604ca8c0e9382e03"), 3));
+
+    while (state.KeepRunning()) {
+        CValidationStakeState stakeState;
+        assert(IsSStx(sstx, stakeState));
+    }
+}
+
+static void StakeIsSSGen(benchmark::State& state)
+{
+    const CTransaction ssgen(MakeBenchSSGen(uint256S("0x87a157f3fd88ac7907c05fc55e271dc4acdc5605d187d646604ca8c0e9382e03"), uint256(), 0));
+
+    while (state.KeepRunning()) {
+        CValidationStakeState stakeState;
+        assert(IsSSGen(ssgen, stakeState));
+    }
+}
+
+// Classify every stake transaction of a block of the synthetic chain, plus
+// a regular transaction which falls through all three checks.
+static void StakeDetermineTxType(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    CBlock block = fixture.MakeStakeBlock(fixture.Tip());
+
+    CMutableTransaction regular;
+    regular.vin.resize(1);
+    regular.vin[0].scriptSig = CScript() << OP_1;
+    regular.vout.resize(1);
+    regular.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    block.svtx.push_back(MakeTransactionRef(regular));
+
+    while (state.KeepRunning()) {
+        for (const auto& stx : block.svtx) {
+            CValidationStakeState stakeState;
+            DetermineTxType(*stx, stakeState);
+        }
+    }
+}
+
+static void StakeFindSpentTicketsInBlock(benchmark::State& state)
+{
+    StakeChainFixture& fixture = GetStakeChainFixture();
+    const CBlock block = fixture.MakeStakeBlock(fixture.Tip());
+
+    while (state.KeepRunning()) {
+        SpentTicketsInBlock ticketinfo;
+        CValidationStakeState stakeState;
+        FindSpentTicketsInBlock(block, ticketinfo, stakeState);
+        assert(ticketinfo.VotedTickets.size() == fixture.vVoted[fixture.Tip()].size());
+    }
+}
+
+BENCHMARK(StakeIsSStx, 300 * 1000);
+BENCHMARK(StakeIsSSGen, 300 * 1000);
+BENCHMARK(StakeDetermineTxType, 10 * 1000);
+BENCHMARK(StakeFindSpentTicketsInBlock, 20 * 1000);
@@ -17,7 +17,7 @@
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
+        shorttxids(block.vtx.size() - 1), prefilledtxn(1), stakeshorttxids(block.svtx.size()), header(block) {
     FillShortTxIDSelector();
     //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
     prefilledtxn[0] = {0, block.vtx[0]};
@@ -25,6 +25,11 @@ CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool f
         const CTransaction& tx = *block.vtx[i];
         shorttxids[i - 1] = GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash());
     }
+    // Votes, tickets and revocations are relayed ahead of the block like any other transaction
+    for (size_t i = 0; i < block.svtx.size(); i++) {
+        const CTransaction& tx = *block.svtx[i];
+        stakeshorttxids[i] = GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash());
+    }
 }
 
 void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const {
@@ -48,12 +53,14 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
 ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
         return READ_STATUS_INVALID;
-    if (cmpctblock.shorttxids.size() + cmpctblock.prefilledtxn.size() > dgpMaxBlockSize * WITNESS_SCALE_FACTOR / MIN_SERIALIZABLE_TRANSACTION_WEIGHT)
+    if (cmpctblock.BlockTxCount() > dgpMaxBlockSize * WITNESS_SCALE_FACTOR / MIN_SERIALIZABLE_TRANSACTION_WEIGHT)
         return READ_STATUS_INVALID;
 
     assert(header.IsNull() && txn_available.empty());
     header = cmpctblock.header;
     txn_available.resize(cmpctblock.BlockTxCount());
+    // The prefilled transactions are all in vtx, so the stake transactions fill the last holes
+    stake_index = cmpctblock.BlockTxCount() - cmpctblock.BlockStakeTxCount();
 
     int32_t lastprefilledindex = -1;
     for (size_t i = 0; i < cmpctblock.prefilledtxn.size(); i++) {
@@ -77,12 +84,14 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     // Because well-formed cmpctblock messages will have a (relatively) uniform distribution
     // of short IDs, any highly-uneven distribution of elements can be safely treated as a
     // READ_STATUS_FAILED.
-    std::unordered_map<uint64_t, uint16_t> shorttxids(cmpctblock.shorttxids.size());
+    const size_t shorttxids_count = cmpctblock.shorttxids.size() + cmpctblock.stakeshorttxids.size();
+    std::unordered_map<uint64_t, uint16_t> shorttxids(shorttxids_count);
     uint16_t index_offset = 0;
-    for (size_t i = 0; i < cmpctblock.shorttxids.size(); i++) {
+    for (size_t i = 0; i < shorttxids_count; i++) {
         while (txn_available[i + index_offset])
             index_offset++;
-        shorttxids[cmpctblock.shorttxids[i]] = i + index_offset;
+        const uint64_t shortid = i < cmpctblock.shorttxids.size() ? cmpctblock.shorttxids[i] : cmpctblock.stakeshorttxids[i - cmpctblock.shorttxids.size()];
+        shorttxids[shortid] = i + index_offset;
         // To determine the chance that the number of entries in a bucket exceeds N,
         // we use the fact that the number of elements in a single bucket is
         // binomially distributed (with n = the number of shorttxids S, and p =
@@ -93,12 +102,12 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
         // Thus: P(max_elements_per_bucket > N) <= S * (1 - cdf(binomial(n=S,p=1/S), N)).
         // If we assume blocks of up to 16000, allowing 12 elements per bucket should
         // only fail once per ~1 million block transfers (per peer and connection).
-        if (shorttxids.bucket_size(shorttxids.bucket(cmpctblock.shorttxids[i])) > 12)
+        if (shorttxids.bucket_size(shorttxids.bucket(shortid)) > 12)
             return READ_STATUS_FAILED;
     }
     // TODO: in the shortid-collision case, we should instead request both transactions
     // which collided. Falling back to full-block-request here is overkill.
-    if (shorttxids.size() != cmpctblock.shorttxids.size())
+    if (shorttxids.size() != shorttxids_count)
         return READ_STATUS_FAILED; // Short ID collision
 
     std::vector<bool> have_txn(txn_available.size());
@@ -177,16 +186,18 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
     assert(!header.IsNull());
     uint256 hash = header.GetHash();
     block = header;
-    block.vtx.resize(txn_available.size());
+    block.vtx.resize(stake_index);
+    block.svtx.resize(txn_available.size() - stake_index);
 
     size_t tx_missing_offset = 0;
     for (size_t i = 0; i < txn_available.size(); i++) {
+        CTransactionRef& tx = i < stake_index ? block.vtx[i] : block.svtx[i - stake_index];
         if (!txn_available[i]) {
             if (vtx_missing.size() <= tx_missing_offset)
                 return READ_STATUS_INVALID;
-            block.vtx[i] = vtx_missing[tx_missing_offset++];
+            tx = vtx_missing[tx_missing_offset++];
         } else
-            block.vtx[i] = std::move(txn_available[i]);
+            tx = std::move(txn_available[i]);
     }
 
     // Make sure we can't call FillBlock again.
@@ -207,7 +218,7 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
         return READ_STATUS_CHECKBLOCK_FAILED;
     }
 
-    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size());
+    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested, %lu of them stake txn\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size(), block.svtx.size());
     if (vtx_missing.size() < 5) {
         for (const auto& tx : vtx_missing) {
             LogPrint(BCLog::CMPCTBLOCK, "Reconstructed block %s required tx %s\n", hash.ToString(), tx->GetHash().ToString());
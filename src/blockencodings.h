@@ -6,6 +6,7 @@
 #define BITCOIN_BLOCK_ENCODINGS_H
 
 #include <primitives/block.h>
+#include <version.h>
 
 #include <memory>
 
@@ -138,9 +139,37 @@ private:
     friend class PartiallyDownloadedBlock;
 
     static const int SHORTTXIDS_LENGTH = 6;
+
+    template <typename Stream, typename Operation>
+    static void SerializeShortTxIDs(Stream& s, Operation ser_action, std::vector<uint64_t>& ids) {
+        uint64_t shorttxids_size = (uint64_t)ids.size();
+        READWRITE(COMPACTSIZE(shorttxids_size));
+        if (ser_action.ForRead()) {
+            size_t i = 0;
+            while (ids.size() < shorttxids_size) {
+                ids.resize(std::min((uint64_t)(1000 + ids.size()), shorttxids_size));
+                for (; i < ids.size(); i++) {
+                    uint32_t lsb = 0; uint16_t msb = 0;
+                    READWRITE(lsb);
+                    READWRITE(msb);
+                    ids[i] = (uint64_t(msb) << 32) | uint64_t(lsb);
+                    static_assert(SHORTTXIDS_LENGTH == 6, "shorttxids serialization assumes 6-byte shorttxids");
+                }
+            }
+        } else {
+            for (size_t i = 0; i < ids.size(); i++) {
+                uint32_t lsb = ids[i] & 0xffffffff;
+                uint16_t msb = (ids[i] >> 32) & 0xffff;
+                READWRITE(lsb);
+                READWRITE(msb);
+            }
+        }
+    }
 protected:
     std::vector<uint64_t> shorttxids;
     std::vector<PrefilledTransaction> prefilledtxn;
+    // Short ids of the stake transactions (svtx), their indexes follow the ones of vtx
+    std::vector<uint64_t> stakeshorttxids;
 
 public:
     CBlockHeader header;
@@ -152,7 +181,9 @@ public:
 
     uint64_t GetShortID(const uint256& txhash) const;
 
-    size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
+    size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size() + stakeshorttxids.size(); }
+
+    size_t BlockStakeTxCount() const { return stakeshorttxids.size(); }
 
     ADD_SERIALIZE_METHODS;
 
@@ -161,31 +192,14 @@ public:
         READWRITE(header);
         READWRITE(nonce);
 
-        uint64_t shorttxids_size = (uint64_t)shorttxids.size();
-        READWRITE(COMPACTSIZE(shorttxids_size));
-        if (ser_action.ForRead()) {
-            size_t i = 0;
-            while (shorttxids.size() < shorttxids_size) {
-                shorttxids.resize(std::min((uint64_t)(1000 + shorttxids.size()), shorttxids_size));
-                for (; i < shorttxids.size(); i++) {
-                    uint32_t lsb = 0; uint16_t msb = 0;
-                    READWRITE(lsb);
-                    READWRITE(msb);
-                    shorttxids[i] = (uint64_t(msb) << 32) | uint64_t(lsb);
-                    static_assert(SHORTTXIDS_LENGTH == 6, "shorttxids serialization assumes 6-byte shorttxids");
-                }
-            }
-        } else {
-            for (size_t i = 0; i < shorttxids.size(); i++) {
-                uint32_t lsb = shorttxids[i] & 0xffffffff;
-                uint16_t msb = (shorttxids[i] >> 32) & 0xffff;
-                READWRITE(lsb);
-                READWRITE(msb);
-            }
-        }
+        SerializeShortTxIDs(s, ser_action, shorttxids);
 
         READWRITE(prefilledtxn);
 
+        // Older peers get no stake short ids and fetch the svtx with the full block
+        if (s.GetVersion() >= STAKE_SHORT_IDS_BLOCKS_VERSION)
+            SerializeShortTxIDs(s, ser_action, stakeshorttxids);
+
         if (ser_action.ForRead())
             FillShortTxIDSelector();
     }
@@ -195,6 +209,8 @@ class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
+    // Index in txn_available of the first stake transaction
+    size_t stake_index = 0;
     CTxMemPool* pool;
 public:
     CBlockHeader header;
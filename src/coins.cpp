@@ -87,6 +87,16 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
+void CCoinsViewCache::WarmCoin(const COutPoint &outpoint, Coin&& coin) {
+    if (cacheCoins.count(outpoint))
+        return;
+    CCoinsMap::iterator it = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin))).first;
+    if (it->second.coin.IsSpent()) {
+        it->second.flags = CCoinsCacheEntry::FRESH;
+    }
+    cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+}
+
 void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, bool check) {
     bool fCoinbase = tx.IsCoinBase();
     bool fCoinstake = tx.IsCoinStake();
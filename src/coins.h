@@ -268,6 +268,14 @@ public:
      */
     bool SpendCoin(const COutPoint &outpoint, Coin* moveto = nullptr);
 
+    /**
+     * Insert a coin that was read from the backing view on behalf of this
+     * cache (e.g. by a prefetch thread), exactly as FetchCoin would have.
+     * If the outpoint is already cached, the cached entry wins and this call
+     * has no effect.
+     */
+    void WarmCoin(const COutPoint &outpoint, Coin&& coin);
+
     /**
      * Push the modifications applied to this cache to its base.
      * Failure to call this method before destruction will cause the changes to be forgotten.
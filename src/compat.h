@@ -86,8 +86,15 @@ typedef int32_t ssize_t;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
+// On Linux the socket handler uses epoll and the other socket waits use poll(),
+// so that sockets are not limited to FD_SETSIZE
+#ifdef __linux__
+#define USE_POLL
+#define USE_EPOLL
+#endif
+
 bool static inline IsSelectableSocket(const SOCKET& s) {
-#ifdef WIN32
+#if defined(USE_POLL) || defined(WIN32)
     return true;
 #else
     return (s < FD_SETSIZE);
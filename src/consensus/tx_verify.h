@@ -17,8 +17,11 @@ class CValidationState;
 
 /** Transaction validation functions */
 
-/** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, CValidationState& state, bool fCheckDuplicateInputs=true);
+/** Context-independent validity checks, except for the size against dgpMaxBlockWeight if fCheckBlockWeight is false */
+bool CheckTransaction(const CTransaction& tx, CValidationState& state, bool fCheckDuplicateInputs=true, bool fCheckBlockWeight=true);
+
+/** Check the size of a transaction against dgpMaxBlockWeight, which ConnectBlock changes under cs_main */
+bool CheckTransactionBlockWeight(const CTransaction& tx, CValidationState& state);
 
 namespace Consensus {
 /**
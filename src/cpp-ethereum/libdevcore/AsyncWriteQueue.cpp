@@ -0,0 +1,104 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file AsyncWriteQueue.cpp
+ * @date 2018
+ */
+
+#include "AsyncWriteQueue.h"
+#include "Log.h"
+using namespace std;
+using namespace dev;
+
+AsyncWriteQueue::AsyncWriteQueue(string const& _name): m_name(_name)
+{
+	m_thread = thread([this]() { run(); });
+}
+
+AsyncWriteQueue::~AsyncWriteQueue()
+{
+	{
+		Guard l(x_queue);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	m_thread.join();
+}
+
+void AsyncWriteQueue::enqueue(function<void()> _write)
+{
+	{
+		Guard l(x_queue);
+		m_queue.push_back(move(_write));
+	}
+	m_cv.notify_all();
+}
+
+void AsyncWriteQueue::wait() const
+{
+	UniqueGuard l(x_queue);
+	m_cv.wait(l, [&]() { return m_queue.empty(); });
+	if (m_failed)
+		throw runtime_error("Write failed in " + m_name + " writer: " + m_error);
+}
+
+size_t AsyncWriteQueue::pending() const
+{
+	Guard l(x_queue);
+	return m_queue.size();
+}
+
+void AsyncWriteQueue::run()
+{
+	setThreadName(m_name);
+	UniqueGuard l(x_queue);
+	while (true)
+	{
+		m_cv.wait(l, [&]() { return m_stop || !m_queue.empty(); });
+		// Stopping drains the queue first
+		if (m_queue.empty())
+			break;
+		function<void()>& write = m_queue.front();
+		l.unlock();
+		bool failed = false;
+		string error;
+		try
+		{
+			write();
+		}
+		catch (std::exception const& _e)
+		{
+			cwarn << "Exception thrown in" << m_name << "writer:" << _e.what();
+			failed = true;
+			error = _e.what();
+		}
+		catch (...)
+		{
+			cwarn << "Unknown exception thrown in" << m_name << "writer";
+			failed = true;
+			error = "unknown exception";
+		}
+		l.lock();
+		// Reported by wait() from now on, the owner cannot tell what is on disk
+		if (failed && !m_failed)
+		{
+			m_failed = true;
+			m_error = error;
+		}
+		m_queue.pop_front();
+		m_cv.notify_all();
+	}
+}
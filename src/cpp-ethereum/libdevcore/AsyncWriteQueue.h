@@ -0,0 +1,69 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file AsyncWriteQueue.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+
+/**
+ * @brief Runs database writes on a background thread, in the order they were queued.
+ * Lets the thread committing data hand it over without waiting for the disk. The owner
+ * of the queue keeps the data of a write readable until the write is done.
+ */
+class AsyncWriteQueue
+{
+public:
+	explicit AsyncWriteQueue(std::string const& _name);
+	/// Runs the writes still queued, then stops the thread.
+	~AsyncWriteQueue();
+
+	AsyncWriteQueue(AsyncWriteQueue const&) = delete;
+	AsyncWriteQueue& operator=(AsyncWriteQueue const&) = delete;
+
+	void enqueue(std::function<void()> _write);
+	/// Waits until the writes queued so far are done.
+	/// @throws std::runtime_error once a write threw, as the data it wrote is lost.
+	void wait() const;
+	/// @returns the number of writes queued or running.
+	size_t pending() const;
+
+private:
+	void run();
+
+	mutable Mutex x_queue;
+	mutable std::condition_variable m_cv;
+	std::deque<std::function<void()>> m_queue;	///< The front one is running, it is removed once done.
+	bool m_stop = false;
+	bool m_failed = false;
+	std::string m_error;	///< What the first write that threw said.
+	std::string m_name;
+	std::thread m_thread;
+};
+
+}
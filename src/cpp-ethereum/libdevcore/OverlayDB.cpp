@@ -20,9 +20,12 @@
  */
 #if !defined(ETH_EMSCRIPTEN)
 
+#include <deque>
 #include <thread>
 #include <libdevcore/db.h>
+#include <libdevcore/AsyncWriteQueue.h>
 #include <libdevcore/Common.h>
+#include <libdevcore/TrieNodeCache.h>
 #include "OverlayDB.h"
 using namespace std;
 using namespace dev;
@@ -44,9 +47,173 @@ class WriteBatchNoter: public ldb::WriteBatch::Handler
 	virtual void Delete(ldb::Slice const& _key) { cnote << "Delete" << toHex(bytesConstRef(_key)); }
 };
 
+namespace
+{
+
+void writeBatch(ldb::DB& _db, ldb::WriteOptions const& _options, ldb::WriteBatch& _batch)
+{
+	for (unsigned i = 0; i < 10; ++i)
+	{
+		ldb::Status o = _db.Write(_options, &_batch);
+		if (o.ok())
+			break;
+		if (i == 9)
+		{
+			cwarn << "Fail writing to state database. Bombing out.";
+			exit(-1);
+		}
+		cwarn << "Error writing to state database: " << o.ToString();
+		WriteBatchNoter n;
+		_batch.Iterate(&n);
+		cwarn << "Sleeping for" << (i + 1) << "seconds, then retrying.";
+		this_thread::sleep_for(chrono::seconds(i + 1));
+	}
+}
+
+void putAux(ldb::WriteBatch& _batch, h256 const& _h, bytes const& _value)
+{
+	bytes b = _h.asBytes();
+	b.push_back(255);	// for aux
+	_batch.Put(bytesConstRef(&b), bytesConstRef(&_value));
+}
+
+}
+
+/// Nodes committed to the background writer, readable until they are on disk.
+struct OverlayDB::AsyncCommit
+{
+	struct Layer
+	{
+		std::unordered_map<h256, std::string> main;
+		std::unordered_map<h256, bytes> aux;
+		bool writing = false;	///< Set once the writer picked the layer up, later commits go to a new one.
+	};
+
+	AsyncCommit(): writer("statedb-writer") {}
+
+	bool lookup(h256 const& _h, std::string& o_value) const
+	{
+		Guard l(x_layers);
+		for (auto it = layers.rbegin(); it != layers.rend(); ++it)
+		{
+			auto i = (*it)->main.find(_h);
+			if (i != (*it)->main.end())
+			{
+				o_value = i->second;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool lookupAux(h256 const& _h, bytes& o_value) const
+	{
+		Guard l(x_layers);
+		for (auto it = layers.rbegin(); it != layers.rend(); ++it)
+		{
+			auto i = (*it)->aux.find(_h);
+			if (i != (*it)->aux.end())
+			{
+				o_value = i->second;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// Writes the oldest layer, there is one queued write per layer.
+	void writeFront(ldb::DB& _db, ldb::WriteOptions const& _options)
+	{
+		std::shared_ptr<Layer> layer;
+		{
+			Guard l(x_layers);
+			layer = layers.front();
+			layer->writing = true;
+		}
+
+		ldb::WriteBatch batch;
+		for (auto const& i: layer->main)
+			batch.Put(ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second.data(), i.second.size()));
+		for (auto const& i: layer->aux)
+			putAux(batch, i.first, i.second);
+		writeBatch(_db, _options, batch);
+
+		TrieNodeCache& cache = TrieNodeCache::instance();
+		for (auto const& i: layer->main)
+			cache.insert(i.first, i.second);
+
+		Guard l(x_layers);
+		layers.pop_front();
+	}
+
+	mutable Mutex x_layers;
+	std::deque<std::shared_ptr<Layer>> layers;	///< Oldest first.
+	/// Last member, so that it is drained before the layers are destroyed.
+	AsyncWriteQueue writer;
+};
+
+void OverlayDB::setAsyncCommit()
+{
+	if (m_db && !m_async)
+		m_async = make_shared<AsyncCommit>();
+}
+
+void OverlayDB::flushCommits(bool _sync) const
+{
+	if (!m_db)
+		return;
+	if (m_async)
+		m_async->writer.wait();
+	if (_sync)
+	{
+		// Syncing the log of an empty write makes all the writes before it durable
+		ldb::WriteOptions o;
+		o.sync = true;
+		ldb::WriteBatch batch;
+		writeBatch(*m_db, o, batch);
+	}
+}
+
+size_t OverlayDB::pendingCommits() const
+{
+	return m_async ? m_async->writer.pending() : 0;
+}
+
 void OverlayDB::commit()
 {
-	if (m_db)
+	if (m_db && m_async)
+	{
+		bool newLayer;
+		{
+			Guard l(m_async->x_layers);
+			// Commits made while the writer is busy are merged and written in one batch
+			newLayer = m_async->layers.empty() || m_async->layers.back()->writing;
+			if (newLayer)
+				m_async->layers.push_back(make_shared<AsyncCommit::Layer>());
+			AsyncCommit::Layer& layer = *m_async->layers.back();
+#if DEV_GUARDED_DB
+			DEV_WRITE_GUARDED(x_this)
+#endif
+			{
+				for (auto& i: m_main)
+					if (i.second.second)
+						layer.main[i.first] = move(i.second.first);
+				for (auto& i: m_aux)
+					if (i.second.second)
+						layer.aux[i.first] = move(i.second.first);
+				m_aux.clear();
+				m_main.clear();
+			}
+		}
+		if (newLayer)
+		{
+			AsyncCommit* async = m_async.get();
+			shared_ptr<ldb::DB> db = m_db;
+			ldb::WriteOptions options = m_writeOptions;
+			m_async->writer.enqueue([async, db, options]() { async->writeFront(*db, options); });
+		}
+	}
+	else if (m_db)
 	{
 		ldb::WriteBatch batch;
 //		cnote << "Committing nodes to disk DB:";
@@ -62,29 +229,18 @@ void OverlayDB::commit()
 			}
 			for (auto const& i: m_aux)
 				if (i.second.second)
-				{
-					bytes b = i.first.asBytes();
-					b.push_back(255);	// for aux
-					batch.Put(bytesConstRef(&b), bytesConstRef(&i.second.first));
-				}
+					putAux(batch, i.first, i.second.first);
 		}
 
-		for (unsigned i = 0; i < 10; ++i)
-		{
-			ldb::Status o = m_db->Write(m_writeOptions, &batch);
-			if (o.ok())
-				break;
-			if (i == 9)
-			{
-				cwarn << "Fail writing to state database. Bombing out.";
-				exit(-1);
-			}
-			cwarn << "Error writing to state database: " << o.ToString();
-			WriteBatchNoter n;
-			batch.Iterate(&n);
-			cwarn << "Sleeping for" << (i + 1) << "seconds, then retrying.";
-			this_thread::sleep_for(chrono::seconds(i + 1));
-		}
+		writeBatch(*m_db, m_writeOptions, batch);
+		// The upper levels of the tries just written are read again by the next block.
+		TrieNodeCache& cache = TrieNodeCache::instance();
+#if DEV_GUARDED_DB
+		DEV_READ_GUARDED(x_this)
+#endif
+		for (auto const& i: m_main)
+			if (i.second.second)
+				cache.insert(i.first, i.second.first);
 #if DEV_GUARDED_DB
 		DEV_WRITE_GUARDED(x_this)
 #endif
@@ -98,7 +254,7 @@ void OverlayDB::commit()
 bytes OverlayDB::lookupAux(h256 const& _h) const
 {
 	bytes ret = MemoryDB::lookupAux(_h);
-	if (!ret.empty() || !m_db)
+	if (!ret.empty() || !m_db || (m_async && m_async->lookupAux(_h, ret)))
 		return ret;
 	std::string v;
 	bytes b = _h.asBytes();
@@ -120,8 +276,12 @@ void OverlayDB::rollback()
 std::string OverlayDB::lookup(h256 const& _h) const
 {
 	std::string ret = MemoryDB::lookup(_h);
-	if (ret.empty() && m_db)
+	if (ret.empty() && m_db && !(m_async && m_async->lookup(_h, ret)) && !TrieNodeCache::instance().lookup(_h, ret))
+	{
 		m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
+		if (!ret.empty())
+			TrieNodeCache::instance().insert(_h, ret);
+	}
 	return ret;
 }
 
@@ -130,6 +290,8 @@ bool OverlayDB::exists(h256 const& _h) const
 	if (MemoryDB::exists(_h))
 		return true;
 	std::string ret;
+	if (m_async && m_async->lookup(_h, ret))
+		return true;
 	if (m_db)
 		m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
 	return !ret.empty();
@@ -141,7 +303,9 @@ void OverlayDB::kill(h256 const& _h)
 	if (!MemoryDB::kill(_h))
 	{
 		std::string ret;
-		if (m_db)
+		if (m_async)
+			m_async->lookup(_h, ret);
+		if (ret.empty() && m_db)
 			m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
 		// No point node ref decreasing for EmptyTrie since we never bother incrementing it in the first place for
 		// empty storage tries.
@@ -159,8 +323,10 @@ bool OverlayDB::deepkill(h256 const& _h)
 {
 	// kill in memoryDB
 	kill(_h);
+	TrieNodeCache::instance().erase(_h);
 
-	//kill in overlayDB
+	//kill in overlayDB, after the writes that may still put it there
+	flushCommits();
 	ldb::Status s = m_db->Delete(m_writeOptions, ldb::Slice((char const*)_h.data(), 32));
 	if (s.ok())
 		return true;
@@ -41,6 +41,16 @@ public:
 	void commit();
 	void rollback();
 
+	/// Hands the next commits to a background writer instead of writing them in place.
+	/// The committed nodes stay readable until they are on disk. Copies share the writer.
+	void setAsyncCommit();
+	/// Waits until the commits handed to the background writer are on disk. With @a _sync,
+	/// a synced write then makes everything committed so far durable.
+	/// @throws std::runtime_error if a write of the background writer failed.
+	void flushCommits(bool _sync = false) const;
+	/// @returns the commits not written yet by the background writer.
+	size_t pendingCommits() const;
+
 	std::string lookup(h256 const& _h) const;
 	bool exists(h256 const& _h) const;
 	void kill(h256 const& _h);
@@ -51,7 +61,10 @@ public:
 private:
 	using MemoryDB::clear;
 
+	struct AsyncCommit;
+
 	std::shared_ptr<ldb::DB> m_db;
+	std::shared_ptr<AsyncCommit> m_async;
 
 	ldb::ReadOptions m_readOptions;
 	ldb::WriteOptions m_writeOptions;
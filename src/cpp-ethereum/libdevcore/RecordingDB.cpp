@@ -0,0 +1,61 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RecordingDB.cpp
+ * @date 2018
+ */
+
+#include "RecordingDB.h"
+#include "TrieDB.h"
+using namespace std;
+using namespace dev;
+
+string RecordingDB::lookup(h256 const& _h) const
+{
+	string ret = m_local.lookup(_h);
+	return ret.empty() ? m_base.lookup(_h) : ret;
+}
+
+bool RecordingDB::exists(h256 const& _h) const
+{
+	return m_local.exists(_h) || m_base.exists(_h);
+}
+
+void RecordingDB::insert(h256 const& _h, bytesConstRef _v)
+{
+	m_local.insert(_h, _v);
+	m_writes.emplace_back(Write::Insert, _h);
+}
+
+void RecordingDB::kill(h256 const& _h)
+{
+	// Same check as OverlayDB::kill(), made here as replay() does not read the disk.
+	if (!m_local.kill(_h) && _h != EmptyTrie && !m_base.exists(_h))
+		cnote << "Decreasing DB node ref count below zero with no DB node. Probably have a corrupt Trie." << _h;
+	m_writes.emplace_back(Write::Kill, _h);
+}
+
+bytes RecordingDB::lookupAux(h256 const& _h) const
+{
+	bytes ret = m_local.lookupAux(_h);
+	return ret.empty() ? m_base.lookupAux(_h) : ret;
+}
+
+void RecordingDB::insertAux(h256 const& _h, bytesConstRef _v)
+{
+	m_local.insertAux(_h, _v);
+	m_writes.emplace_back(Write::InsertAux, _h);
+}
@@ -0,0 +1,89 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RecordingDB.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/MemoryDB.h>
+#include <libdevcore/OverlayDB.h>
+
+namespace dev
+{
+
+/**
+ * @brief Trie database that reads through to an OverlayDB it never writes to, and keeps its own
+ * writes in memory together with the order they were made in.
+ * Tries on different RecordingDBs over the same OverlayDB can be updated concurrently as long as
+ * nothing writes to the OverlayDB meanwhile; replay() then applies the writes of each one in turn,
+ * leaving the OverlayDB as if the tries had been updated on it directly.
+ */
+class RecordingDB
+{
+public:
+	explicit RecordingDB(OverlayDB const& _base): m_base(_base) {}
+
+	std::string lookup(h256 const& _h) const;
+	bool exists(h256 const& _h) const;
+	void insert(h256 const& _h, bytesConstRef _v);
+	void kill(h256 const& _h);
+
+	bytes lookupAux(h256 const& _h) const;
+	void insertAux(h256 const& _h, bytesConstRef _v);
+
+	/// Applies the recorded writes to @a _db in the order they were made.
+	template <class DB> void replay(DB& _db) const
+	{
+		for (auto const& i: m_writes)
+			switch (i.first)
+			{
+			case Write::Insert:
+			{
+				std::string const value = m_local.lookup(i.second);
+				_db.insert(i.second, bytesConstRef(&value));
+				break;
+			}
+			case Write::Kill:
+				// Kills of nodes missing from the database were reported by kill() already.
+				_db.MemoryDB::kill(i.second);
+				break;
+			case Write::InsertAux:
+			{
+				bytes const value = m_local.lookupAux(i.second);
+				_db.insertAux(i.second, bytesConstRef(&value));
+				break;
+			}
+			}
+	}
+
+	size_t writes() const { return m_writes.size(); }
+
+private:
+	enum class Write { Insert, Kill, InsertAux };
+
+	OverlayDB const& m_base;
+	MemoryDB m_local;
+	std::vector<std::pair<Write, h256>> m_writes;
+};
+
+}
@@ -20,12 +20,21 @@
  */
 
 #include "SHA3.h"
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include "RLP.h"
 #include "picosha2.h"
+#if defined(__x86_64__) || defined(__amd64__)
+#if defined(__GNUC__)
+#define KECCAK_AVX2 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#endif
 using namespace std;
 using namespace dev;
 
@@ -91,8 +100,7 @@ static const uint64_t RC[24] = \
   REPEAT5(e; v += s;)
 
 /*** Keccak-f[1600] ***/
-static inline void keccakf(void* state) {
-  uint64_t* a = (uint64_t*)state;
+void keccakfPortable(uint64_t* a) {
   uint64_t b[5] = {0};
   uint64_t t = 0;
   uint8_t x, y;
@@ -125,6 +133,201 @@ static inline void keccakf(void* state) {
   }
 }
 
+/*** Keccak-f[1600], 64-bit lanes with lane complementing ***/
+// Lanes are named after their row (b, g, k, m, s) and column (a, e, i, o, u), rounds alternate
+// between the A and E lanes. Abe, Abi, Ago, Aki, Ami and Asa are kept complemented between the
+// rounds, which turns 20 of the 25 NOTs of chi into ORs.
+void keccakf(uint64_t* a)
+{
+	uint64_t Aba = a[0];
+	uint64_t Abe = ~a[1];
+	uint64_t Abi = ~a[2];
+	uint64_t Abo = a[3];
+	uint64_t Abu = a[4];
+	uint64_t Aga = a[5];
+	uint64_t Age = a[6];
+	uint64_t Agi = a[7];
+	uint64_t Ago = ~a[8];
+	uint64_t Agu = a[9];
+	uint64_t Aka = a[10];
+	uint64_t Ake = a[11];
+	uint64_t Aki = ~a[12];
+	uint64_t Ako = a[13];
+	uint64_t Aku = a[14];
+	uint64_t Ama = a[15];
+	uint64_t Ame = a[16];
+	uint64_t Ami = ~a[17];
+	uint64_t Amo = a[18];
+	uint64_t Amu = a[19];
+	uint64_t Asa = ~a[20];
+	uint64_t Ase = a[21];
+	uint64_t Asi = a[22];
+	uint64_t Aso = a[23];
+	uint64_t Asu = a[24];
+	uint64_t Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu, Eka, Eke, Eki, Eko, Eku, Ema, Eme, Emi, Emo, Emu, Esa, Ese, Esi, Eso, Esu;
+	uint64_t c0, c1, c2, c3, c4, d0, d1, d2, d3, d4, b0, b1, b2, b3, b4, n;
+
+	for (int i = 0; i < 24; i += 2)
+	{
+		c0 = Aba ^ Aga ^ Aka ^ Ama ^ Asa;
+		c1 = Abe ^ Age ^ Ake ^ Ame ^ Ase;
+		c2 = Abi ^ Agi ^ Aki ^ Ami ^ Asi;
+		c3 = Abo ^ Ago ^ Ako ^ Amo ^ Aso;
+		c4 = Abu ^ Agu ^ Aku ^ Amu ^ Asu;
+		d0 = c4 ^ rol(c1, 1);
+		d1 = c0 ^ rol(c2, 1);
+		d2 = c1 ^ rol(c3, 1);
+		d3 = c2 ^ rol(c4, 1);
+		d4 = c3 ^ rol(c0, 1);
+		b0 = Aba ^ d0;
+		b1 = rol(Age ^ d1, 44);
+		b2 = rol(Aki ^ d2, 43);
+		b3 = rol(Amo ^ d3, 21);
+		b4 = rol(Asu ^ d4, 14);
+		n = ~b2;
+		Eba = b0 ^ (b1 | b2) ^ RC[i];
+		Ebe = b1 ^ (n | b3);
+		Ebi = b2 ^ (b3 & b4);
+		Ebo = b3 ^ (b4 | b0);
+		Ebu = b4 ^ (b0 & b1);
+		b0 = rol(Abo ^ d3, 28);
+		b1 = rol(Agu ^ d4, 20);
+		b2 = rol(Aka ^ d0, 3);
+		b3 = rol(Ame ^ d1, 45);
+		b4 = rol(Asi ^ d2, 61);
+		n = ~b4;
+		Ega = b0 ^ (b1 | b2);
+		Ege = b1 ^ (b2 & b3);
+		Egi = b2 ^ (b3 | n);
+		Ego = b3 ^ (b4 | b0);
+		Egu = b4 ^ (b0 & b1);
+		b0 = rol(Abe ^ d1, 1);
+		b1 = rol(Agi ^ d2, 6);
+		b2 = rol(Ako ^ d3, 25);
+		b3 = rol(Amu ^ d4, 8);
+		b4 = rol(Asa ^ d0, 18);
+		n = ~b3;
+		Eka = b0 ^ (b1 | b2);
+		Eke = b1 ^ (b2 & b3);
+		Eki = b2 ^ (n & b4);
+		Eko = n ^ (b4 | b0);
+		Eku = b4 ^ (b0 & b1);
+		b0 = rol(Abu ^ d4, 27);
+		b1 = rol(Aga ^ d0, 36);
+		b2 = rol(Ake ^ d1, 10);
+		b3 = rol(Ami ^ d2, 15);
+		b4 = rol(Aso ^ d3, 56);
+		n = ~b3;
+		Ema = b0 ^ (b1 & b2);
+		Eme = b1 ^ (b2 | b3);
+		Emi = b2 ^ (n | b4);
+		Emo = n ^ (b4 & b0);
+		Emu = b4 ^ (b0 | b1);
+		b0 = rol(Abi ^ d2, 62);
+		b1 = rol(Ago ^ d3, 55);
+		b2 = rol(Aku ^ d4, 39);
+		b3 = rol(Ama ^ d0, 41);
+		b4 = rol(Ase ^ d1, 2);
+		n = ~b1;
+		Esa = b0 ^ (n & b2);
+		Ese = n ^ (b2 | b3);
+		Esi = b2 ^ (b3 & b4);
+		Eso = b3 ^ (b4 | b0);
+		Esu = b4 ^ (b0 & b1);
+		c0 = Eba ^ Ega ^ Eka ^ Ema ^ Esa;
+		c1 = Ebe ^ Ege ^ Eke ^ Eme ^ Ese;
+		c2 = Ebi ^ Egi ^ Eki ^ Emi ^ Esi;
+		c3 = Ebo ^ Ego ^ Eko ^ Emo ^ Eso;
+		c4 = Ebu ^ Egu ^ Eku ^ Emu ^ Esu;
+		d0 = c4 ^ rol(c1, 1);
+		d1 = c0 ^ rol(c2, 1);
+		d2 = c1 ^ rol(c3, 1);
+		d3 = c2 ^ rol(c4, 1);
+		d4 = c3 ^ rol(c0, 1);
+		b0 = Eba ^ d0;
+		b1 = rol(Ege ^ d1, 44);
+		b2 = rol(Eki ^ d2, 43);
+		b3 = rol(Emo ^ d3, 21);
+		b4 = rol(Esu ^ d4, 14);
+		n = ~b2;
+		Aba = b0 ^ (b1 | b2) ^ RC[i + 1];
+		Abe = b1 ^ (n | b3);
+		Abi = b2 ^ (b3 & b4);
+		Abo = b3 ^ (b4 | b0);
+		Abu = b4 ^ (b0 & b1);
+		b0 = rol(Ebo ^ d3, 28);
+		b1 = rol(Egu ^ d4, 20);
+		b2 = rol(Eka ^ d0, 3);
+		b3 = rol(Eme ^ d1, 45);
+		b4 = rol(Esi ^ d2, 61);
+		n = ~b4;
+		Aga = b0 ^ (b1 | b2);
+		Age = b1 ^ (b2 & b3);
+		Agi = b2 ^ (b3 | n);
+		Ago = b3 ^ (b4 | b0);
+		Agu = b4 ^ (b0 & b1);
+		b0 = rol(Ebe ^ d1, 1);
+		b1 = rol(Egi ^ d2, 6);
+		b2 = rol(Eko ^ d3, 25);
+		b3 = rol(Emu ^ d4, 8);
+		b4 = rol(Esa ^ d0, 18);
+		n = ~b3;
+		Aka = b0 ^ (b1 | b2);
+		Ake = b1 ^ (b2 & b3);
+		Aki = b2 ^ (n & b4);
+		Ako = n ^ (b4 | b0);
+		Aku = b4 ^ (b0 & b1);
+		b0 = rol(Ebu ^ d4, 27);
+		b1 = rol(Ega ^ d0, 36);
+		b2 = rol(Eke ^ d1, 10);
+		b3 = rol(Emi ^ d2, 15);
+		b4 = rol(Eso ^ d3, 56);
+		n = ~b3;
+		Ama = b0 ^ (b1 & b2);
+		Ame = b1 ^ (b2 | b3);
+		Ami = b2 ^ (n | b4);
+		Amo = n ^ (b4 & b0);
+		Amu = b4 ^ (b0 | b1);
+		b0 = rol(Ebi ^ d2, 62);
+		b1 = rol(Ego ^ d3, 55);
+		b2 = rol(Eku ^ d4, 39);
+		b3 = rol(Ema ^ d0, 41);
+		b4 = rol(Ese ^ d1, 2);
+		n = ~b1;
+		Asa = b0 ^ (n & b2);
+		Ase = n ^ (b2 | b3);
+		Asi = b2 ^ (b3 & b4);
+		Aso = b3 ^ (b4 | b0);
+		Asu = b4 ^ (b0 & b1);
+	}
+
+	a[0] = Aba;
+	a[1] = ~Abe;
+	a[2] = ~Abi;
+	a[3] = Abo;
+	a[4] = Abu;
+	a[5] = Aga;
+	a[6] = Age;
+	a[7] = Agi;
+	a[8] = ~Ago;
+	a[9] = Agu;
+	a[10] = Aka;
+	a[11] = Ake;
+	a[12] = ~Aki;
+	a[13] = Ako;
+	a[14] = Aku;
+	a[15] = Ama;
+	a[16] = Ame;
+	a[17] = ~Ami;
+	a[18] = Amo;
+	a[19] = Amu;
+	a[20] = ~Asa;
+	a[21] = Ase;
+	a[22] = Asi;
+	a[23] = Aso;
+	a[24] = Asu;
+}
+
 /******** The FIPS202-defined functions. ********/
 
 /*** Some helper macros. ***/
@@ -155,7 +358,7 @@ mkapply_sd(setout, dst[i] = src[i])  // setout
 #define foldP(I, L, F) \
   while (L >= rate) {  \
 	F(a, I, rate);     \
-	P(a);              \
+	P(lanes);          \
 	I += rate;         \
 	L -= rate;         \
   }
@@ -167,7 +370,8 @@ static inline int hash(uint8_t* out, size_t outlen,
   if ((out == NULL) || ((in == NULL) && inlen != 0) || (rate >= Plen)) {
 	return -1;
   }
-  uint8_t a[Plen] = {0};
+  uint64_t lanes[Plen / 8] = {0};
+  uint8_t* a = (uint8_t*)lanes;
   // Absorb input.
   foldP(in, inlen, xorin);
   // Xor in the DS and pad frame.
@@ -176,7 +380,7 @@ static inline int hash(uint8_t* out, size_t outlen,
   // Xor in the last block.
   xorin(a, in, inlen);
   // Apply P
-  P(a);
+  P(lanes);
   // Squeeze output.
   foldP(out, outlen, setout);
   setout(a, out, outlen);
@@ -209,6 +413,270 @@ defsha3(256)
 defsha3(384)
 defsha3(512)
 
+#if KECCAK_AVX2
+/*** Keccak-f[1600] of four states at once with AVX2 ***/
+// s[i] holds lane i of the four states. Same rounds as keccakf(), without lane complementing as
+// ANDNOT does chi in one instruction.
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define XOR5(a, b, c, d, e) XOR(XOR(XOR(a, b), XOR(c, d)), e)
+#define ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define ROL(a, n) _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+
+__attribute__((target("avx2"))) static void keccakfx4(__m256i* s)
+{
+	__m256i Aba = s[0];
+	__m256i Abe = s[1];
+	__m256i Abi = s[2];
+	__m256i Abo = s[3];
+	__m256i Abu = s[4];
+	__m256i Aga = s[5];
+	__m256i Age = s[6];
+	__m256i Agi = s[7];
+	__m256i Ago = s[8];
+	__m256i Agu = s[9];
+	__m256i Aka = s[10];
+	__m256i Ake = s[11];
+	__m256i Aki = s[12];
+	__m256i Ako = s[13];
+	__m256i Aku = s[14];
+	__m256i Ama = s[15];
+	__m256i Ame = s[16];
+	__m256i Ami = s[17];
+	__m256i Amo = s[18];
+	__m256i Amu = s[19];
+	__m256i Asa = s[20];
+	__m256i Ase = s[21];
+	__m256i Asi = s[22];
+	__m256i Aso = s[23];
+	__m256i Asu = s[24];
+	__m256i Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu, Eka, Eke, Eki, Eko, Eku, Ema, Eme, Emi, Emo, Emu, Esa, Ese, Esi, Eso, Esu;
+	__m256i c0, c1, c2, c3, c4, d0, d1, d2, d3, d4, b0, b1, b2, b3, b4;
+
+	for (int i = 0; i < 24; i += 2)
+	{
+		c0 = XOR5(Aba, Aga, Aka, Ama, Asa);
+		c1 = XOR5(Abe, Age, Ake, Ame, Ase);
+		c2 = XOR5(Abi, Agi, Aki, Ami, Asi);
+		c3 = XOR5(Abo, Ago, Ako, Amo, Aso);
+		c4 = XOR5(Abu, Agu, Aku, Amu, Asu);
+		d0 = XOR(c4, ROL(c1, 1));
+		d1 = XOR(c0, ROL(c2, 1));
+		d2 = XOR(c1, ROL(c3, 1));
+		d3 = XOR(c2, ROL(c4, 1));
+		d4 = XOR(c3, ROL(c0, 1));
+		b0 = XOR(Aba, d0);
+		b1 = ROL(XOR(Age, d1), 44);
+		b2 = ROL(XOR(Aki, d2), 43);
+		b3 = ROL(XOR(Amo, d3), 21);
+		b4 = ROL(XOR(Asu, d4), 14);
+		Eba = XOR(XOR(b0, ANDNOT(b1, b2)), _mm256_set1_epi64x(RC[i]));
+		Ebe = XOR(b1, ANDNOT(b2, b3));
+		Ebi = XOR(b2, ANDNOT(b3, b4));
+		Ebo = XOR(b3, ANDNOT(b4, b0));
+		Ebu = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Abo, d3), 28);
+		b1 = ROL(XOR(Agu, d4), 20);
+		b2 = ROL(XOR(Aka, d0), 3);
+		b3 = ROL(XOR(Ame, d1), 45);
+		b4 = ROL(XOR(Asi, d2), 61);
+		Ega = XOR(b0, ANDNOT(b1, b2));
+		Ege = XOR(b1, ANDNOT(b2, b3));
+		Egi = XOR(b2, ANDNOT(b3, b4));
+		Ego = XOR(b3, ANDNOT(b4, b0));
+		Egu = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Abe, d1), 1);
+		b1 = ROL(XOR(Agi, d2), 6);
+		b2 = ROL(XOR(Ako, d3), 25);
+		b3 = ROL(XOR(Amu, d4), 8);
+		b4 = ROL(XOR(Asa, d0), 18);
+		Eka = XOR(b0, ANDNOT(b1, b2));
+		Eke = XOR(b1, ANDNOT(b2, b3));
+		Eki = XOR(b2, ANDNOT(b3, b4));
+		Eko = XOR(b3, ANDNOT(b4, b0));
+		Eku = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Abu, d4), 27);
+		b1 = ROL(XOR(Aga, d0), 36);
+		b2 = ROL(XOR(Ake, d1), 10);
+		b3 = ROL(XOR(Ami, d2), 15);
+		b4 = ROL(XOR(Aso, d3), 56);
+		Ema = XOR(b0, ANDNOT(b1, b2));
+		Eme = XOR(b1, ANDNOT(b2, b3));
+		Emi = XOR(b2, ANDNOT(b3, b4));
+		Emo = XOR(b3, ANDNOT(b4, b0));
+		Emu = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Abi, d2), 62);
+		b1 = ROL(XOR(Ago, d3), 55);
+		b2 = ROL(XOR(Aku, d4), 39);
+		b3 = ROL(XOR(Ama, d0), 41);
+		b4 = ROL(XOR(Ase, d1), 2);
+		Esa = XOR(b0, ANDNOT(b1, b2));
+		Ese = XOR(b1, ANDNOT(b2, b3));
+		Esi = XOR(b2, ANDNOT(b3, b4));
+		Eso = XOR(b3, ANDNOT(b4, b0));
+		Esu = XOR(b4, ANDNOT(b0, b1));
+		c0 = XOR5(Eba, Ega, Eka, Ema, Esa);
+		c1 = XOR5(Ebe, Ege, Eke, Eme, Ese);
+		c2 = XOR5(Ebi, Egi, Eki, Emi, Esi);
+		c3 = XOR5(Ebo, Ego, Eko, Emo, Eso);
+		c4 = XOR5(Ebu, Egu, Eku, Emu, Esu);
+		d0 = XOR(c4, ROL(c1, 1));
+		d1 = XOR(c0, ROL(c2, 1));
+		d2 = XOR(c1, ROL(c3, 1));
+		d3 = XOR(c2, ROL(c4, 1));
+		d4 = XOR(c3, ROL(c0, 1));
+		b0 = XOR(Eba, d0);
+		b1 = ROL(XOR(Ege, d1), 44);
+		b2 = ROL(XOR(Eki, d2), 43);
+		b3 = ROL(XOR(Emo, d3), 21);
+		b4 = ROL(XOR(Esu, d4), 14);
+		Aba = XOR(XOR(b0, ANDNOT(b1, b2)), _mm256_set1_epi64x(RC[i + 1]));
+		Abe = XOR(b1, ANDNOT(b2, b3));
+		Abi = XOR(b2, ANDNOT(b3, b4));
+		Abo = XOR(b3, ANDNOT(b4, b0));
+		Abu = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Ebo, d3), 28);
+		b1 = ROL(XOR(Egu, d4), 20);
+		b2 = ROL(XOR(Eka, d0), 3);
+		b3 = ROL(XOR(Eme, d1), 45);
+		b4 = ROL(XOR(Esi, d2), 61);
+		Aga = XOR(b0, ANDNOT(b1, b2));
+		Age = XOR(b1, ANDNOT(b2, b3));
+		Agi = XOR(b2, ANDNOT(b3, b4));
+		Ago = XOR(b3, ANDNOT(b4, b0));
+		Agu = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Ebe, d1), 1);
+		b1 = ROL(XOR(Egi, d2), 6);
+		b2 = ROL(XOR(Eko, d3), 25);
+		b3 = ROL(XOR(Emu, d4), 8);
+		b4 = ROL(XOR(Esa, d0), 18);
+		Aka = XOR(b0, ANDNOT(b1, b2));
+		Ake = XOR(b1, ANDNOT(b2, b3));
+		Aki = XOR(b2, ANDNOT(b3, b4));
+		Ako = XOR(b3, ANDNOT(b4, b0));
+		Aku = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Ebu, d4), 27);
+		b1 = ROL(XOR(Ega, d0), 36);
+		b2 = ROL(XOR(Eke, d1), 10);
+		b3 = ROL(XOR(Emi, d2), 15);
+		b4 = ROL(XOR(Eso, d3), 56);
+		Ama = XOR(b0, ANDNOT(b1, b2));
+		Ame = XOR(b1, ANDNOT(b2, b3));
+		Ami = XOR(b2, ANDNOT(b3, b4));
+		Amo = XOR(b3, ANDNOT(b4, b0));
+		Amu = XOR(b4, ANDNOT(b0, b1));
+		b0 = ROL(XOR(Ebi, d2), 62);
+		b1 = ROL(XOR(Ego, d3), 55);
+		b2 = ROL(XOR(Eku, d4), 39);
+		b3 = ROL(XOR(Ema, d0), 41);
+		b4 = ROL(XOR(Ese, d1), 2);
+		Asa = XOR(b0, ANDNOT(b1, b2));
+		Ase = XOR(b1, ANDNOT(b2, b3));
+		Asi = XOR(b2, ANDNOT(b3, b4));
+		Aso = XOR(b3, ANDNOT(b4, b0));
+		Asu = XOR(b4, ANDNOT(b0, b1));
+	}
+
+	s[0] = Aba;
+	s[1] = Abe;
+	s[2] = Abi;
+	s[3] = Abo;
+	s[4] = Abu;
+	s[5] = Aga;
+	s[6] = Age;
+	s[7] = Agi;
+	s[8] = Ago;
+	s[9] = Agu;
+	s[10] = Aka;
+	s[11] = Ake;
+	s[12] = Aki;
+	s[13] = Ako;
+	s[14] = Aku;
+	s[15] = Ama;
+	s[16] = Ame;
+	s[17] = Ami;
+	s[18] = Amo;
+	s[19] = Amu;
+	s[20] = Asa;
+	s[21] = Ase;
+	s[22] = Asi;
+	s[23] = Aso;
+	s[24] = Asu;
+}
+
+#undef XOR
+#undef XOR5
+#undef ANDNOT
+#undef ROL
+
+/// SHA3-256 of four inputs, each absorbed in its own lane of keccakfx4().
+__attribute__((target("avx2"))) static void sha3x4(bytesConstRef const* _inputs, h256* o_outputs)
+{
+	size_t const rate = 136;
+	size_t blocks[4];
+	size_t maxBlocks = 0;
+	for (unsigned j = 0; j < 4; ++j)
+	{
+		blocks[j] = _inputs[j].size() / rate + 1;
+		maxBlocks = std::max(maxBlocks, blocks[j]);
+	}
+
+	__m256i s[25];
+	for (unsigned i = 0; i < 25; ++i)
+		s[i] = _mm256_setzero_si256();
+	uint64_t lanes[4][rate / 8];
+	for (size_t k = 0; k < maxBlocks; ++k)
+	{
+		for (unsigned j = 0; j < 4; ++j)
+		{
+			uint8_t* block = (uint8_t*)lanes[j];
+			if (k + 1 < blocks[j])
+				memcpy(block, _inputs[j].data() + k * rate, rate);
+			else
+			{
+				// Last block with the padding, nothing once the input is done.
+				memset(block, 0, rate);
+				if (k + 1 == blocks[j])
+				{
+					size_t const left = _inputs[j].size() - k * rate;
+					if (left)
+						memcpy(block, _inputs[j].data() + k * rate, left);
+					block[left] ^= 0x01;
+					block[rate - 1] ^= 0x80;
+				}
+			}
+		}
+		for (unsigned i = 0; i < rate / 8; ++i)
+			s[i] = _mm256_xor_si256(s[i], _mm256_set_epi64x(lanes[3][i], lanes[2][i], lanes[1][i], lanes[0][i]));
+		keccakfx4(s);
+
+		for (unsigned j = 0; j < 4; ++j)
+			if (k + 1 == blocks[j])
+				for (unsigned i = 0; i < 4; ++i)
+				{
+					alignas(32) uint64_t out[4];
+					_mm256_store_si256((__m256i*)out, s[i]);
+					memcpy(o_outputs[j].data() + 8 * i, &out[j], 8);
+				}
+	}
+}
+
+/// True if the CPU and the OS support AVX2.
+static bool hasAVX2()
+{
+	uint32_t eax, ebx, ecx, edx;
+	if (__get_cpuid_max(0, nullptr) < 7 || !__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !((ecx >> 27) & 1))
+		return false;
+	// The OS saves the YMM registers
+	uint32_t xcr0, xcr0High;
+	__asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+	if ((xcr0 & 6) != 6)
+		return false;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx >> 5) & 1;
+}
+#endif
+
+
 }
 
 bool sha3(bytesConstRef _input, bytesRef o_output)
@@ -221,4 +689,60 @@ bool sha3(bytesConstRef _input, bytesRef o_output)
 	return true;
 }
 
+namespace
+{
+/// Hashes four inputs at once, if the CPU can.
+void (*s_sha3x4)(bytesConstRef const*, h256*) = nullptr;
+}
+
+void sha3(bytesConstRef const* _inputs, size_t _count, h256* o_outputs)
+{
+	size_t i = 0;
+	if (s_sha3x4)
+		for (; i + 4 <= _count; i += 4)
+			s_sha3x4(_inputs + i, o_outputs + i);
+	for (; i < _count; ++i)
+		sha3(_inputs[i], o_outputs[i].ref());
+}
+
+namespace
+{
+bool selfTest()
+{
+	if (sha3(bytesConstRef()) != h256("c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470"))
+		return false;
+	bytes const abc = {'a', 'b', 'c'};
+	if (sha3(abc) != h256("4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45"))
+		return false;
+	// Inputs around the block size of 136 bytes, hashed in one and two batches plus one by one
+	bytes data(300);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = uint8_t(i * 7 + 3);
+	size_t const sizes[9] = {0, 1, 32, 135, 136, 137, 272, 300, 64};
+	bytesConstRef inputs[9];
+	h256 outputs[9];
+	for (unsigned i = 0; i < 9; ++i)
+		inputs[i] = bytesConstRef(data.data(), sizes[i]);
+	sha3(inputs, 9, outputs);
+	for (unsigned i = 0; i < 9; ++i)
+		if (outputs[i] != sha3(inputs[i]))
+			return false;
+	return true;
+}
+}
+
+std::string sha3AutoDetect()
+{
+	std::string ret = "64-bit lanes";
+#if KECCAK_AVX2
+	if (keccak::hasAVX2())
+	{
+		s_sha3x4 = keccak::sha3x4;
+		ret += ", avx2 4-way";
+	}
+#endif
+	assert(selfTest());
+	return ret;
+}
+
 }
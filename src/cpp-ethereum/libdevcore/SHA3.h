@@ -38,6 +38,14 @@ bool sha3(bytesConstRef _input, bytesRef o_output);
 
 /// Calculate SHA3-256 hash of the given input, returning as a 256-bit hash.
 inline h256 sha3(bytesConstRef _input) { h256 ret; sha3(_input, ret.ref()); return ret; }
+
+/// Calculate the SHA3-256 hashes of the @a _count inputs of @a _inputs into @a o_outputs. Faster than
+/// hashing them one by one if sha3AutoDetect() found a way to hash several inputs at once.
+void sha3(bytesConstRef const* _inputs, size_t _count, h256* o_outputs);
+
+/// Select the fastest Keccak implementations the CPU supports and check them.
+/// @returns their description.
+std::string sha3AutoDetect();
 inline SecureFixedHash<32> sha3Secure(bytesConstRef _input) { SecureFixedHash<32> ret; sha3(_input, ret.writable().ref()); return ret; }
 
 /// Calculate SHA3-256 hash of the given input, returning as a 256-bit hash.
@@ -64,6 +72,14 @@ inline std::string sha3(std::string const& _input, bool _isNibbles) { return asS
 /// Calculate SHA3-256 MAC
 inline void sha3mac(bytesConstRef _secret, bytesConstRef _plain, bytesRef _output) { sha3(_secret.toBytes() + _plain.toBytes()).ref().populate(_output); }
 
+namespace keccak
+{
+/// Keccak-f[1600] permutation of the 25 lanes of @a _state, the one sha3() uses.
+void keccakf(uint64_t* _state);
+/// Plain implementation of keccakf() from libkeccak-tiny, slower.
+void keccakfPortable(uint64_t* _state);
+}
+
 extern h256 EmptySHA3;
 
 extern h256 EmptyListSHA3;
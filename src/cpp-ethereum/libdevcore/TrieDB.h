@@ -97,6 +97,8 @@ public:
 	bool isEmpty() const { return m_root == c_shaNull && node(m_root).size(); }
 
 	h256 const& root() const { if (node(m_root).empty()) BOOST_THROW_EXCEPTION(BadRoot(m_root)); /*std::cout << "Returning root as " << ret << " (really " << m_root << ")" << std::endl;*/ return m_root; }	// patch the root in the case of the empty trie. TODO: handle this properly.
+	/// The root without the lookup of its node, for callers that only need to identify the state.
+	h256 const& rootUnchecked() const { return m_root; }
 
 	std::string at(bytes const& _key) const { return at(&_key); }
 	std::string at(bytesConstRef _key) const;
@@ -384,6 +386,7 @@ public:
 	using Super::isEmpty;
 
 	using Super::root;
+	using Super::rootUnchecked;
 	using Super::db;
 
 	using Super::leftOvers;
@@ -395,6 +398,10 @@ public:
 	void insert(bytesConstRef _key, bytesConstRef _value) { Super::insert(sha3(_key), _value); }
 	void remove(bytesConstRef _key) { Super::remove(sha3(_key)); }
 
+	/// insert() and remove() with @a _hash the sha3 of the key, for callers that hash keys in batches.
+	void insertHashed(bytesConstRef, h256 const& _hash, bytesConstRef _value) { Super::insert(_hash, _value); }
+	void removeHashed(h256 const& _hash) { Super::remove(_hash); }
+
 	// empty from the PoV of the iterator interface; still need a basic iterator impl though.
 	class iterator
 	{
@@ -434,6 +441,7 @@ public:
 	using Super::isNull;
 	using Super::isEmpty;
 	using Super::root;
+	using Super::rootUnchecked;
 	using Super::leftOvers;
 	using Super::check;
 	using Super::open;
@@ -443,14 +451,16 @@ public:
 
 	std::string at(bytesConstRef _key) const { return Super::at(sha3(_key)); }
 	bool contains(bytesConstRef _key) { return Super::contains(sha3(_key)); }
-	void insert(bytesConstRef _key, bytesConstRef _value)
+	void insert(bytesConstRef _key, bytesConstRef _value) { insertHashed(_key, sha3(_key), _value); }
+	void remove(bytesConstRef _key) { Super::remove(sha3(_key)); }
+
+	/// insert() and remove() with @a _hash the sha3 of @a _key, for callers that hash keys in batches.
+	void insertHashed(bytesConstRef _key, h256 const& _hash, bytesConstRef _value)
 	{
-		h256 hash = sha3(_key);
-		Super::insert(hash, _value);
-		Super::db()->insertAux(hash, _key);
+		Super::insert(_hash, _value);
+		Super::db()->insertAux(_hash, _key);
 	}
-
-	void remove(bytesConstRef _key) { Super::remove(sha3(_key)); }
+	void removeHashed(h256 const& _hash) { Super::remove(_hash); }
 
 	// iterates over <key, value> pairs
 	class iterator: public GenericTrieDB<_DB>::iterator
@@ -0,0 +1,106 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TrieNodeCache.cpp
+ * @date 2018
+ */
+
+#include "TrieNodeCache.h"
+using namespace std;
+using namespace dev;
+
+bool TrieNodeCache::lookup(h256 const& _h, std::string& _value)
+{
+	Guard l(x_cache);
+	if (!m_maxSize)
+		return false;
+	auto it = m_index.find(_h);
+	if (it == m_index.end())
+	{
+		++m_misses;
+		return false;
+	}
+	++m_hits;
+	m_entries.splice(m_entries.begin(), m_entries, it->second);
+	_value = it->second->second;
+	return true;
+}
+
+void TrieNodeCache::insert(h256 const& _h, std::string const& _value)
+{
+	size_t charge = _value.size() + c_entryOverhead;
+	Guard l(x_cache);
+	if (charge > m_maxSize)
+		return;
+	auto it = m_index.find(_h);
+	if (it != m_index.end())
+	{
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return;
+	}
+	evict(m_maxSize - charge);
+	m_entries.emplace_front(_h, _value);
+	m_index[_h] = m_entries.begin();
+	m_usage += charge;
+}
+
+void TrieNodeCache::erase(h256 const& _h)
+{
+	Guard l(x_cache);
+	auto it = m_index.find(_h);
+	if (it == m_index.end())
+		return;
+	m_usage -= it->second->second.size() + c_entryOverhead;
+	m_entries.erase(it->second);
+	m_index.erase(it);
+}
+
+void TrieNodeCache::setMaxSize(size_t _maxSize)
+{
+	Guard l(x_cache);
+	m_maxSize = _maxSize;
+	evict(m_maxSize);
+}
+
+void TrieNodeCache::clear()
+{
+	Guard l(x_cache);
+	evict(0);
+	m_hits = m_misses = 0;
+}
+
+TrieNodeCache::Stats TrieNodeCache::stats() const
+{
+	Guard l(x_cache);
+	Stats ret;
+	ret.hits = m_hits;
+	ret.misses = m_misses;
+	ret.entries = m_index.size();
+	ret.usage = m_usage;
+	ret.maxSize = m_maxSize;
+	return ret;
+}
+
+void TrieNodeCache::evict(size_t _maxSize)
+{
+	while (m_usage > _maxSize && !m_entries.empty())
+	{
+		Entry const& e = m_entries.back();
+		m_usage -= e.second.size() + c_entryOverhead;
+		m_index.erase(e.first);
+		m_entries.pop_back();
+	}
+}
@@ -0,0 +1,83 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TrieNodeCache.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+
+/**
+ * @brief Thread-safe LRU cache of trie nodes read from or written to disk, keyed by node hash.
+ * Nodes are content-addressed, so an entry never goes stale and the cache is shared by
+ * all the OverlayDBs of the process. The cache is bounded by the memory its entries use;
+ * a size of zero disables it.
+ */
+class TrieNodeCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		size_t entries = 0;
+		size_t usage = 0;
+		size_t maxSize = 0;
+	};
+
+	/// Looks up the node with hash @a _h, moving it to the front on a hit.
+	bool lookup(h256 const& _h, std::string& _value);
+	/// Inserts a node, evicting the least recently used ones to make room.
+	void insert(h256 const& _h, std::string const& _value);
+	/// Drops the node with hash @a _h, used when it is deleted from disk.
+	void erase(h256 const& _h);
+
+	/// Sets the memory bound in bytes, evicting entries if needed.
+	void setMaxSize(size_t _maxSize);
+	void clear();
+
+	Stats stats() const;
+
+	static TrieNodeCache& instance() { static TrieNodeCache cache; return cache; }
+
+private:
+	using Entry = std::pair<h256, std::string>;
+	using EntryList = std::list<Entry>;
+
+	/// Approximate size of an entry besides its value: list node and hash map node.
+	static const size_t c_entryOverhead = sizeof(Entry) + 4 * sizeof(void*) + sizeof(std::pair<h256 const, EntryList::iterator>) + 2 * sizeof(void*);
+
+	void evict(size_t _maxSize);
+
+	mutable Mutex x_cache;
+	EntryList m_entries;	///< Most recently used first.
+	std::unordered_map<h256, EntryList::iterator> m_index;
+	size_t m_usage = 0;
+	size_t m_maxSize = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+};
+
+}
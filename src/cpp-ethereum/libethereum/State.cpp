@@ -21,11 +21,16 @@
 
 #include "State.h"
 
+#include <atomic>
 #include <ctime>
+#include <thread>
 #include <boost/filesystem.hpp>
 #include <boost/timer.hpp>
+#include <leveldb/cache.h>
+#include <leveldb/filter_policy.h>
 #include <libdevcore/CommonIO.h>
 #include <libdevcore/Assertions.h>
+#include <libdevcore/TrieNodeCache.h>
 #ifndef QTUM_BUILD
 #include <libdevcore/TrieHash.h>
 #endif
@@ -46,6 +51,14 @@ using namespace dev::eth;
 using namespace dev::eth::detail;
 namespace fs = boost::filesystem;
 
+namespace
+{
+StateDBOptions s_dbOptions;
+// Shared by all the databases opened by State::openDB(), which must not outlive them
+std::unique_ptr<ldb::Cache> s_dbCache;
+std::unique_ptr<ldb::FilterPolicy const> s_dbFilterPolicy;
+}
+
 const char* StateSafeExceptions::name() { return EthViolet "⚙" EthBlue " ℹ"; }
 const char* StateDetail::name() { return EthViolet "⚙" EthWhite " ◌"; }
 const char* StateTrace::name() { return EthViolet "⚙" EthGray " ◎"; }
@@ -68,6 +81,9 @@ State::State(State const& _s):
 	m_unchangedCacheEntries(_s.m_unchangedCacheEntries),
 	m_nonExistingAccountsCache(_s.m_nonExistingAccountsCache),
 	m_touched(_s.m_touched),
+	m_writeBackCache(_s.m_writeBackCache),
+	m_writeBack(_s.m_writeBack),
+	m_snapshot(_s.m_snapshot),
 	m_accountStartNonce(_s.m_accountStartNonce)
 {}
 
@@ -88,6 +104,12 @@ OverlayDB State::openDB(std::string const& _basePath, h256 const& _genesisHash,
 	ldb::Options o;
 	o.max_open_files = 256;
 	o.create_if_missing = true;
+	if (s_dbCache)
+		o.block_cache = s_dbCache.get();
+	if (s_dbFilterPolicy)
+		o.filter_policy = s_dbFilterPolicy.get();
+	if (s_dbOptions.writeBufferSize)
+		o.write_buffer_size = s_dbOptions.writeBufferSize;
 	ldb::DB* db = nullptr;
 	ldb::Status status = ldb::DB::Open(o, path + "/state", &db);
 	if (!status.ok() || !db)
@@ -109,7 +131,28 @@ OverlayDB State::openDB(std::string const& _basePath, h256 const& _genesisHash,
 	}
 
 	ctrace << "Opened state DB.";
-	return OverlayDB(db);
+	OverlayDB ret(db);
+	if (s_dbOptions.asyncCommit)
+		ret.setAsyncCommit();
+	return ret;
+}
+
+void State::setDBOptions(StateDBOptions const& _options)
+{
+	s_dbOptions = _options;
+	s_dbCache.reset(_options.cacheSize ? ldb::NewLRUCache(_options.cacheSize) : nullptr);
+	s_dbFilterPolicy.reset(_options.bloomBits > 0 ? ldb::NewBloomFilterPolicy(_options.bloomBits) : nullptr);
+	TrieNodeCache::instance().setMaxSize(_options.nodeCacheSize);
+}
+
+StateDBOptions const& State::dbOptions()
+{
+	return s_dbOptions;
+}
+
+size_t State::dbCacheUsage()
+{
+	return s_dbCache ? s_dbCache->TotalCharge() : 0;
 }
 
 void State::populateFrom(AccountMap const& _map)
@@ -151,6 +194,9 @@ State& State::operator=(State const& _s)
 	m_unchangedCacheEntries = _s.m_unchangedCacheEntries;
 	m_nonExistingAccountsCache = _s.m_nonExistingAccountsCache;
 	m_touched = _s.m_touched;
+	m_writeBackCache = _s.m_writeBackCache;
+	m_writeBack = _s.m_writeBack;
+	m_snapshot = _s.m_snapshot;
 	m_accountStartNonce = _s.m_accountStartNonce;
 	return *this;
 }
@@ -166,11 +212,29 @@ Account* State::account(Address const& _addr)
 	if (it != m_cache.end())
 		return &it->second;
 
+	// Accounts committed by earlier transactions of the block take precedence over the trie.
+	// The copy starts out unchanged so that this transaction sees it as freshly loaded.
+	auto wb = m_writeBackCache.find(_addr);
+	if (wb != m_writeBackCache.end())
+	{
+		if (!wb->second.isAlive())
+			return nullptr;
+
+		clearCacheIfTooLarge();
+
+		auto i = m_cache.emplace(_addr, wb->second);
+		i.first->second.untouch();
+		m_unchangedCacheEntries.push_back(_addr);
+		return &i.first->second;
+	}
+
 	if (m_nonExistingAccountsCache.count(_addr))
 		return nullptr;
 
 	// Populate basic info.
-	string stateBack = m_state.at(_addr);
+	string stateBack;
+	if (!m_snapshot || !m_snapshot->account(m_state.rootUnchecked(), _addr, stateBack))
+		stateBack = m_state.at(_addr);
 	if (stateBack.empty())
 	{
 		m_nonExistingAccountsCache.insert(_addr);
@@ -211,12 +275,127 @@ void State::commit(CommitBehaviour _commitBehaviour)
 {
 	if (_commitBehaviour == CommitBehaviour::RemoveEmptyAccounts)
 		removeEmptyAccounts();
-	m_touched += dev::eth::commit(m_cache, m_state);
+	if (m_writeBack)
+	{
+		for (auto& i: m_cache)
+			if (i.second.isDirty())
+				m_writeBackCache[i.first] = std::move(i.second);
+	}
+	else
+		commitAccounts(m_cache);
 	m_changeLog.clear();
 	m_cache.clear();
 	m_unchangedCacheEntries.clear();
 }
 
+void State::setWriteBack(bool _writeBack)
+{
+	if (!_writeBack)
+		flushWriteBack();
+	m_writeBack = _writeBack;
+}
+
+void State::flushWriteBack()
+{
+	if (m_writeBackCache.empty())
+		return;
+	commitAccounts(m_writeBackCache);
+	m_writeBackCache.clear();
+}
+
+void State::commitAccounts(AccountMap const& _accounts)
+{
+	StorageUpdates updates = updateStorageTries(_accounts, m_db, s_dbOptions.commitThreads);
+	if (!m_snapshot)
+	{
+		m_touched += dev::eth::commit(_accounts, m_state, nullptr, &updates);
+		return;
+	}
+	h256 const parent = m_state.rootUnchecked();
+	StateDiff diff;
+	m_touched += dev::eth::commit(_accounts, m_state, &diff, &updates);
+	m_snapshot->update(parent, m_state.rootUnchecked(), move(diff));
+}
+
+StorageUpdates dev::eth::updateStorageTries(AccountMap const& _cache, OverlayDB& _db, unsigned _threads)
+{
+	StorageUpdates ret;
+	if (_threads < 2)
+		return ret;
+
+	vector<AccountMap::value_type const*> accounts;
+	size_t slots = 0;
+	bool emptyRoot = false;
+	for (auto const& i: _cache)
+		if (i.second.isDirty() && i.second.isAlive() && !i.second.storageOverlay().empty())
+		{
+			accounts.push_back(&i);
+			slots += i.second.storageOverlay().size();
+			emptyRoot = emptyRoot || i.second.baseRoot() == EmptyTrie;
+		}
+	if (accounts.size() < 2 || slots < c_minConcurrentStorageSlots)
+		return ret;
+
+	vector<pair<Account const*, StorageUpdate*>> work;
+	for (auto const* i: accounts)
+	{
+		unique_ptr<StorageUpdate>& update = ret[i->first];
+		update.reset(new StorageUpdate(_db));
+		work.emplace_back(&i->second, update.get());
+	}
+	// Largest tries first, so that the threads finish together.
+	sort(work.begin(), work.end(), [](pair<Account const*, StorageUpdate*> const& _a, pair<Account const*, StorageUpdate*> const& _b) {
+		return _a.first->storageOverlay().size() > _b.first->storageOverlay().size();
+	});
+
+	// A serial commit inserts the root node of the empty trie with the first storage trie
+	// opened at it; the threads only read _db, so it has to be there beforehand.
+	if (emptyRoot && !_db.exists(EmptyTrie))
+		_db.insert(EmptyTrie, &RLPNull);
+
+	atomic<size_t> next(0);
+	exception_ptr error;
+	Mutex x_error;
+	auto updateTries = [&]()
+	{
+		try
+		{
+			for (size_t n = next++; n < work.size(); n = next++)
+			{
+				SecureTrieDB<h256, RecordingDB> storageDB(&work[n].second->writes, work[n].first->baseRoot());
+				commitStorage(work[n].first->storageOverlay(), storageDB);
+				assert(storageDB.root());
+				work[n].second->root = storageDB.root();
+			}
+		}
+		catch (...)
+		{
+			next = work.size();
+			Guard l(x_error);
+			if (!error)
+				error = current_exception();
+		}
+	};
+
+	vector<thread> threads;
+	for (unsigned i = 1; i < _threads && i < work.size(); ++i)
+		try
+		{
+			threads.emplace_back(updateTries);
+		}
+		catch (system_error const&)
+		{
+			// Out of threads, the ones running do the rest.
+			break;
+		}
+	updateTries();
+	for (auto& t: threads)
+		t.join();
+	if (error)
+		rethrow_exception(error);
+	return ret;
+}
+
 unordered_map<Address, u256> State::addresses() const
 {
 #if ETH_FATDB
@@ -238,6 +417,8 @@ void State::setRoot(h256 const& _r)
 	m_cache.clear();
 	m_unchangedCacheEntries.clear();
 	m_nonExistingAccountsCache.clear();
+	m_writeBackCache.clear();
+	m_writeBack = false;
 //	m_touched.clear();
 	m_state.setRoot(_r);
 }
@@ -358,10 +539,17 @@ u256 State::storage(Address const& _id, u256 const& _key) const
 		if (mit != a->storageOverlay().end())
 			return mit->second;
 
-		// Not in the storage cache - go to the DB.
-		SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), a->baseRoot());			// promise we won't change the overlay! :)
-		string payload = memdb.at(_key);
-		u256 ret = payload.size() ? RLP(payload).toInt<u256>() : 0;
+		// Not in the storage cache - go to the snapshot, or the DB. The base root of a cached account is
+		// its storage root at the root of the state, except for new accounts whose storage is empty.
+		u256 ret;
+		if (a->baseRoot() == EmptyTrie)
+			ret = 0;
+		else if (!m_snapshot || !m_snapshot->storage(m_state.rootUnchecked(), _id, _key, ret))
+		{
+			SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), a->baseRoot());			// promise we won't change the overlay! :)
+			string payload = memdb.at(_key);
+			ret = payload.size() ? RLP(payload).toInt<u256>() : 0;
+		}
 		a->setStorageCache(_key, ret);
 		return ret;
 	}
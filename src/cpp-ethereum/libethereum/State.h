@@ -22,17 +22,20 @@
 #pragma once
 
 #include <array>
+#include <memory>
 #include <unordered_map>
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
 #include <libdevcore/TrieDB.h>
 #include <libdevcore/OverlayDB.h>
+#include <libdevcore/RecordingDB.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/BlockHeader.h>
 #include <libethereum/CodeSizeCache.h>
 #include <libethereum/GenericMiner.h>
 #include <libevm/ExtVMFace.h>
 #include "Account.h"
+#include "StateSnapshot.h"
 #include "Transaction.h"
 #include "TransactionReceipt.h"
 #include "GasPricer.h"
@@ -85,6 +88,17 @@ enum class Permanence
 	Committed
 };
 
+/// Storage engine options of the databases opened by State::openDB(). Zero leaves the LevelDB default.
+struct StateDBOptions
+{
+	size_t cacheSize = 0;			///< Block cache shared by all the databases, in bytes.
+	int bloomBits = 0;				///< Bits per key of the bloom filter policy, no filter if zero.
+	size_t writeBufferSize = 0;		///< Write buffer of each database, in bytes.
+	size_t nodeCacheSize = 0;		///< Bound of the shared TrieNodeCache, in bytes. Disabled if zero.
+	unsigned commitThreads = 0;		///< Threads updating the storage tries of large commits, see updateStorageTries().
+	bool asyncCommit = false;		///< Write the commits on a background thread, see OverlayDB::setAsyncCommit().
+};
+
 #if ETH_FATDB
 template <class KeyType, class DB> using SecureTrieDB = SpecificTrieDB<FatGenericTrieDB<DB>, KeyType>;
 #else
@@ -192,9 +206,20 @@ public:
 
 	/// Open a DB - useful for passing into the constructor & keeping for other states that are necessary.
 	static OverlayDB openDB(std::string const& _path, h256 const& _genesisHash, WithExisting _we = WithExisting::Trust);
+
+	/// Set the options used by openDB(). Must be called before any database is opened.
+	static void setDBOptions(StateDBOptions const& _options);
+	static StateDBOptions const& dbOptions();
+	/// @returns the memory currently used by the shared block cache, in bytes.
+	static size_t dbCacheUsage();
 	OverlayDB const& db() const { return m_db; }
 	OverlayDB& db() { return m_db; }
 
+	/// Serve account and storage reads from @a _snapshot at the roots it knows, and record
+	/// the accounts written to the trie in it. Copies of the state share the snapshot.
+	void setSnapshot(std::shared_ptr<StateSnapshot> const& _snapshot) { m_snapshot = _snapshot; }
+	std::shared_ptr<StateSnapshot> const& snapshot() const { return m_snapshot; }
+
 	/// Populate the state from the given AccountMap. Just uses dev::eth::commit().
 	void populateFrom(AccountMap const& _map);
 
@@ -289,9 +314,23 @@ public:
 
 	/// Commit all changes waiting in the address cache to the DB.
 	/// @param _commitBehaviour whether or not to remove empty accounts during commit.
+	/// While write-back is enabled the changed accounts are kept in memory instead, see setWriteBack().
 	void commit(CommitBehaviour _commitBehaviour);
 
-	/// Resets any uncommitted changes to the cache.
+	/// Enable or disable write-back of committed accounts. While enabled, commit() moves the changed
+	/// accounts to m_writeBackCache, where later transactions see them, and they are written to the
+	/// trie once by flushWriteBack(). rootHash() does not include them until then.
+	/// Disabling write-back flushes the accounts.
+	void setWriteBack(bool _writeBack);
+
+	/// Write the accounts kept back by commit() to the trie.
+	void flushWriteBack();
+
+	/// @returns true if write-back of committed accounts is enabled.
+	bool writeBack() const { return m_writeBack; }
+
+	/// Resets any uncommitted changes to the cache, including the accounts kept back by commit(),
+	/// and disables write-back.
 	void setRoot(h256 const& _root);
 
 	/// Get the account start nonce. May be required.
@@ -326,12 +365,18 @@ protected: // qtum
 
 	void createAccount(Address const& _address, Account const&& _account);
 
+	/// Writes the dirty accounts of @a _accounts to the trie, and their changes to the snapshot.
+	void commitAccounts(AccountMap const& _accounts);
+
 	OverlayDB m_db;								///< Our overlay for the state tree.
 	SecureTrieDB<Address, OverlayDB> m_state;	///< Our state tree, as an OverlayDB DB.
 	mutable std::unordered_map<Address, Account> m_cache;	///< Our address cache. This stores the states of each address that has (or at least might have) been changed.
 	mutable std::vector<Address> m_unchangedCacheEntries;	///< Tracks entries in m_cache that can potentially be purged if it grows too large.
 	mutable std::set<Address> m_nonExistingAccountsCache;	///< Tracks addresses that are known to not exist.
 	AddressHash m_touched;						///< Tracks all addresses touched so far.
+	AccountMap m_writeBackCache;				///< Accounts committed while write-back is enabled, not yet in m_state. Killed accounts stay as non-alive entries.
+	bool m_writeBack = false;					///< Whether commit() writes to m_writeBackCache instead of m_state.
+	std::shared_ptr<StateSnapshot> m_snapshot;	///< Flat view of the trie for reads, may be null.
 
 	u256 m_accountStartNonce;
 
@@ -341,33 +386,93 @@ protected: // qtum
 
 std::ostream& operator<<(std::ostream& _out, State const& _s);
 
+/// Storage trie of an account updated by updateStorageTries(), with the writes still to be made.
+struct StorageUpdate
+{
+	explicit StorageUpdate(OverlayDB const& _db): writes(_db) {}
+
+	h256 root;
+	RecordingDB writes;
+};
+
+using StorageUpdates = std::unordered_map<Address, std::unique_ptr<StorageUpdate>>;
+
+/// Writes the storage slots of @a _storage to @a _trie, hashing their keys in one batch.
+template <class DB>
+void commitStorage(std::unordered_map<u256, u256> const& _storage, SecureTrieDB<h256, DB>& _trie)
+{
+	std::vector<h256> keys;
+	std::vector<bytesConstRef> refs;
+	keys.reserve(_storage.size());
+	refs.reserve(_storage.size());
+	for (auto const& i: _storage)
+		keys.push_back(h256(i.first));
+	for (auto const& i: keys)
+		refs.push_back(i.ref());
+	std::vector<h256> hashes(keys.size());
+	sha3(refs.data(), refs.size(), hashes.data());
+
+	size_t k = 0;
+	for (auto const& i: _storage)
+	{
+		if (i.second)
+		{
+			bytes const value = rlp(i.second);
+			_trie.insertHashed(refs[k], hashes[k], &value);
+		}
+		else
+			_trie.removeHashed(hashes[k]);
+		++k;
+	}
+}
+
+/// Least number of storage slots changed by a commit for its storage tries to be updated concurrently.
+static const size_t c_minConcurrentStorageSlots = 256;
+
+/// Updates the storage tries of the dirty accounts of @a _cache on up to @a _threads threads, only
+/// reading @a _db. Returns nothing if there are fewer than two such tries or c_minConcurrentStorageSlots
+/// slots to write, in which case commit() is faster on its own.
+StorageUpdates updateStorageTries(AccountMap const& _cache, OverlayDB& _db, unsigned _threads);
+
+/// Writes the dirty accounts of @a _cache to @a _state, and their changes to @a o_diff if given.
+/// The storage tries in @a _updates, from updateStorageTries(), are taken as they are.
 template <class DB>
-AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state)
+AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state, StateDiff* o_diff = nullptr, StorageUpdates const* _updates = nullptr)
 {
 	AddressHash ret;
 	for (auto const& i: _cache)
 		if (i.second.isDirty())
 		{
 			if (!i.second.isAlive())
+			{
 				_state.remove(i.first);
+				if (o_diff)
+				{
+					o_diff->accounts[i.first].clear();
+					o_diff->wiped.insert(i.first);
+					o_diff->storage.erase(i.first);
+				}
+			}
 			else
 			{
 				RLPStream s(4);
 				s << i.second.nonce() << i.second.balance();
 
+				auto update = _updates ? _updates->find(i.first) : StorageUpdates::const_iterator();
 				if (i.second.storageOverlay().empty())
 				{
 					assert(i.second.baseRoot());
 					s.append(i.second.baseRoot());
 				}
+				else if (_updates && update != _updates->end())
+				{
+					update->second->writes.replay(*_state.db());
+					s.append(update->second->root);
+				}
 				else
 				{
 					SecureTrieDB<h256, DB> storageDB(_state.db(), i.second.baseRoot());
-					for (auto const& j: i.second.storageOverlay())
-						if (j.second)
-							storageDB.insert(j.first, rlp(j.second));
-						else
-							storageDB.remove(j.first);
+					commitStorage(i.second.storageOverlay(), storageDB);
 					assert(storageDB.root());
 					s.append(storageDB.root());
 				}
@@ -384,6 +489,22 @@ AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state)
 					s << i.second.codeHash();
 
 				_state.insert(i.first, &s.out());
+
+				if (o_diff)
+				{
+					o_diff->accounts[i.first] = asString(s.out());
+					if (i.second.baseRoot() == EmptyTrie)
+					{
+						o_diff->wiped.insert(i.first);
+						o_diff->storage.erase(i.first);
+					}
+					if (!i.second.storageOverlay().empty())
+					{
+						auto& storage = o_diff->storage[i.first];
+						for (auto const& j: i.second.storageOverlay())
+							storage[j.first] = j.second;
+					}
+				}
 			}
 			ret.insert(i.first);
 		}
@@ -0,0 +1,409 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StateSnapshot.cpp
+ * @date 2018
+ */
+
+#include "StateSnapshot.h"
+
+#include <cstring>
+#include <boost/filesystem.hpp>
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/RLP.h>
+#include <libdevcore/TrieDB.h>
+#include "State.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+// Disk layer keys: the root, 'a' + address for accounts and 's' + address + slot for storage.
+char const c_rootKey[] = "r";
+char const c_accountPrefix = 'a';
+char const c_storagePrefix = 's';
+
+// Bloom filter of the keys changed by a diff layer and the ones below it, three bits per key.
+unsigned const c_bloomBits = 19;
+size_t const c_bloomWords = (size_t(1) << c_bloomBits) / 64;
+size_t const c_batchSize = 10000;
+
+uint64_t mix(uint64_t _x)
+{
+	_x ^= _x >> 33;
+	_x *= 0xff51afd7ed558ccdULL;
+	_x ^= _x >> 33;
+	_x *= 0xc4ceb9fe1a85ec53ULL;
+	return _x ^ (_x >> 33);
+}
+
+template <unsigned N>
+uint64_t hashOf(FixedHash<N> const& _h, uint64_t _seed = 0)
+{
+	uint64_t ret = _seed;
+	for (unsigned i = 0; i < N; i += 8)
+	{
+		uint64_t w = 0;
+		memcpy(&w, _h.data() + i, min(8u, N - i));
+		ret = mix(ret ^ w);
+	}
+	return ret;
+}
+
+uint64_t accountHash(Address const& _addr)
+{
+	return hashOf(_addr);
+}
+
+uint64_t slotHash(Address const& _addr, h256 const& _key)
+{
+	return hashOf(_key, accountHash(_addr));
+}
+
+void bloomAdd(vector<uint64_t>& _bloom, uint64_t _h)
+{
+	uint64_t const mask = (uint64_t(1) << c_bloomBits) - 1;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		uint64_t bit = (_h >> (i * c_bloomBits)) & mask;
+		_bloom[bit / 64] |= uint64_t(1) << (bit % 64);
+	}
+}
+
+bool bloomContains(vector<uint64_t> const& _bloom, uint64_t _h)
+{
+	uint64_t const mask = (uint64_t(1) << c_bloomBits) - 1;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		uint64_t bit = (_h >> (i * c_bloomBits)) & mask;
+		if (!(_bloom[bit / 64] & (uint64_t(1) << (bit % 64))))
+			return false;
+	}
+	return true;
+}
+
+string accountKey(Address const& _addr)
+{
+	string ret(1 + Address::size, c_accountPrefix);
+	memcpy(&ret[1], _addr.data(), Address::size);
+	return ret;
+}
+
+string storagePrefix(Address const& _addr)
+{
+	string ret(1 + Address::size, c_storagePrefix);
+	memcpy(&ret[1], _addr.data(), Address::size);
+	return ret;
+}
+
+string storageKey(Address const& _addr, h256 const& _key)
+{
+	return storagePrefix(_addr) + string((char const*)_key.data(), h256::size);
+}
+
+void writeBatch(ldb::DB* _db, ldb::WriteBatch& _batch)
+{
+	ldb::Status status = _db->Write(ldb::WriteOptions(), &_batch);
+	if (!status.ok())
+		BOOST_THROW_EXCEPTION(FailedInvariant() << errinfo_comment("Error writing the state snapshot: " + status.ToString()));
+	_batch.Clear();
+}
+
+/// Deletes all the keys starting with @a _prefix, the whole database if it is empty.
+void deletePrefix(ldb::DB* _db, ldb::WriteBatch& _batch, string const& _prefix)
+{
+	unique_ptr<ldb::Iterator> it(_db->NewIterator(ldb::ReadOptions()));
+	for (it->Seek(_prefix); it->Valid() && it->key().starts_with(_prefix); it->Next())
+		_batch.Delete(it->key());
+}
+
+}
+
+StateSnapshot::StateSnapshot(string const& _path)
+{
+	boost::filesystem::create_directories(_path);
+	ldb::Options o;
+	o.max_open_files = 64;
+	o.create_if_missing = true;
+	ldb::DB* db = nullptr;
+	ldb::Status status = ldb::DB::Open(o, _path, &db);
+	if (!status.ok() || !db)
+	{
+		cwarn << status.ToString();
+		BOOST_THROW_EXCEPTION(DatabaseAlreadyOpen());
+	}
+	m_db.reset(db);
+
+	string root = readDisk(c_rootKey);
+	if (root.size() == h256::size)
+		m_diskRoot = h256((byte const*)root.data(), h256::ConstructFromPointer);
+	m_head = m_diskRoot;
+}
+
+h256 StateSnapshot::diskRoot() const
+{
+	ReadGuard l(x_snapshot);
+	return m_diskRoot;
+}
+
+bool StateSnapshot::knows(h256 const& _root) const
+{
+	ReadGuard l(x_snapshot);
+	return m_diskRoot && knownRoot(_root);
+}
+
+bool StateSnapshot::account(h256 const& _root, Address const& _addr, string& o_rlp) const
+{
+	ReadGuard l(x_snapshot);
+	auto it = m_layers.find(_root);
+	if (it == m_layers.end() && (!m_diskRoot || _root != m_diskRoot))
+	{
+		++m_misses;
+		return false;
+	}
+	++m_hits;
+
+	// Every layer leads down to the disk layer; the bloom tells whether any of them has the account.
+	if (it != m_layers.end() && bloomContains(it->second.bloom, accountHash(_addr)))
+		for (; it != m_layers.end(); it = m_layers.find(it->second.parent))
+		{
+			auto a = it->second.diff.accounts.find(_addr);
+			if (a != it->second.diff.accounts.end())
+			{
+				o_rlp = a->second;
+				return true;
+			}
+		}
+	o_rlp = readDisk(accountKey(_addr));
+	return true;
+}
+
+bool StateSnapshot::storage(h256 const& _root, Address const& _addr, u256 const& _key, u256& o_value) const
+{
+	ReadGuard l(x_snapshot);
+	auto it = m_layers.find(_root);
+	if (it == m_layers.end() && (!m_diskRoot || _root != m_diskRoot))
+	{
+		++m_misses;
+		return false;
+	}
+	++m_hits;
+
+	h256 const key(_key);
+	// A wipe changes the account too, so its hash covers the wipes.
+	if (it != m_layers.end() && (bloomContains(it->second.bloom, slotHash(_addr, key)) || bloomContains(it->second.bloom, accountHash(_addr))))
+		for (; it != m_layers.end(); it = m_layers.find(it->second.parent))
+		{
+			StateDiff const& diff = it->second.diff;
+			auto s = diff.storage.find(_addr);
+			if (s != diff.storage.end())
+			{
+				auto v = s->second.find(_key);
+				if (v != s->second.end())
+				{
+					o_value = v->second;
+					return true;
+				}
+			}
+			if (diff.wiped.count(_addr))
+			{
+				o_value = 0;
+				return true;
+			}
+		}
+	string payload = readDisk(storageKey(_addr, key));
+	o_value = payload.size() ? RLP(payload).toInt<u256>() : 0;
+	return true;
+}
+
+void StateSnapshot::update(h256 const& _parent, h256 const& _root, StateDiff&& _diff)
+{
+	WriteGuard l(x_snapshot);
+	if (!m_diskRoot || knownRoot(_root) || !knownRoot(_parent))
+		return;
+	if (m_layers.size() >= c_maxLayers)
+	{
+		dropSideLayers();
+		if (m_layers.size() >= c_maxLayers || !knownRoot(_parent))
+			return;
+	}
+
+	Layer layer;
+	layer.parent = _parent;
+	layer.diff = move(_diff);
+	auto p = m_layers.find(_parent);
+	setBloom(layer, p != m_layers.end() ? &p->second : nullptr);
+	m_layers.emplace(_root, move(layer));
+}
+
+bool StateSnapshot::cap(h256 const& _head, unsigned _layers)
+{
+	WriteGuard l(x_snapshot);
+	if (!m_diskRoot || !knownRoot(_head))
+		return false;
+	m_head = _head;
+
+	vector<h256> chain;	// Head first
+	for (h256 r = _head; r != m_diskRoot; r = m_layers.at(r).parent)
+		chain.push_back(r);
+
+	bool flattened = false;
+	while (chain.size() > _layers)
+	{
+		flatten(chain.back());
+		chain.pop_back();
+		flattened = true;
+	}
+	dropSideLayers();
+
+	// The blooms still hold the keys of the flattened layers
+	if (flattened)
+		for (auto r = chain.rbegin(); r != chain.rend(); ++r)
+		{
+			Layer& layer = m_layers.at(*r);
+			auto p = m_layers.find(layer.parent);
+			setBloom(layer, p != m_layers.end() ? &p->second : nullptr);
+		}
+	return true;
+}
+
+void StateSnapshot::generate(OverlayDB const& _db, h256 const& _root)
+{
+#if ETH_FATDB
+	WriteGuard l(x_snapshot);
+	m_layers.clear();
+
+	// Forget the root first, so that an interrupted generation leaves no usable disk layer
+	ldb::WriteBatch batch;
+	batch.Delete(c_rootKey);
+	writeBatch(m_db.get(), batch);
+	m_diskRoot = m_head = h256();
+	deletePrefix(m_db.get(), batch, string());
+	writeBatch(m_db.get(), batch);
+
+	OverlayDB* db = const_cast<OverlayDB*>(&_db);		// promise we won't change the overlay! :)
+	SecureTrieDB<Address, OverlayDB> state(db, _root);
+	size_t entries = 0;
+	for (auto it = state.hashedBegin(); it != state.hashedEnd(); ++it)
+	{
+		bytes const addrBytes = it.key();
+		if (addrBytes.size() != Address::size)
+			BOOST_THROW_EXCEPTION(StateSnapshotGenerationFailed());
+		Address const addr(addrBytes);
+		bytesConstRef const value = (*it).second;
+		batch.Put(accountKey(addr), ldb::Slice((char const*)value.data(), value.size()));
+
+		h256 const storageRoot = RLP(value)[2].toHash<h256>();
+		if (storageRoot != EmptyTrie)
+		{
+			SecureTrieDB<h256, OverlayDB> storageDB(db, storageRoot);
+			for (auto s = storageDB.hashedBegin(); s != storageDB.hashedEnd(); ++s)
+			{
+				bytes const key = s.key();
+				if (key.size() != h256::size)
+					BOOST_THROW_EXCEPTION(StateSnapshotGenerationFailed());
+				bytesConstRef const payload = (*s).second;
+				batch.Put(storageKey(addr, h256(key)), ldb::Slice((char const*)payload.data(), payload.size()));
+				if (++entries % c_batchSize == 0)
+					writeBatch(m_db.get(), batch);
+			}
+		}
+		if (++entries % c_batchSize == 0)
+			writeBatch(m_db.get(), batch);
+	}
+	batch.Put(c_rootKey, ldb::Slice((char const*)_root.data(), h256::size));
+	writeBatch(m_db.get(), batch);
+	m_diskRoot = m_head = _root;
+#else
+	(void)_db;
+	(void)_root;
+	BOOST_THROW_EXCEPTION(InterfaceNotSupported("StateSnapshot::generate()"));
+#endif
+}
+
+StateSnapshot::Stats StateSnapshot::stats() const
+{
+	ReadGuard l(x_snapshot);
+	Stats ret;
+	ret.layers = m_layers.size();
+	ret.diskRoot = m_diskRoot;
+	ret.hits = m_hits;
+	ret.misses = m_misses;
+	return ret;
+}
+
+string StateSnapshot::readDisk(string const& _key) const
+{
+	string ret;
+	ldb::Status status = m_db->Get(ldb::ReadOptions(), _key, &ret);
+	if (!status.ok() && !status.IsNotFound())
+		BOOST_THROW_EXCEPTION(FailedInvariant() << errinfo_comment("Error reading the state snapshot: " + status.ToString()));
+	return ret;
+}
+
+void StateSnapshot::flatten(h256 const& _root)
+{
+	Layer& layer = m_layers.at(_root);
+	assert(layer.parent == m_diskRoot);
+
+	ldb::WriteBatch batch;
+	for (Address const& addr: layer.diff.wiped)
+		deletePrefix(m_db.get(), batch, storagePrefix(addr));
+	for (auto const& a: layer.diff.accounts)
+		if (a.second.empty())
+			batch.Delete(accountKey(a.first));
+		else
+			batch.Put(accountKey(a.first), a.second);
+	for (auto const& s: layer.diff.storage)
+		for (auto const& v: s.second)
+			if (v.second)
+				batch.Put(storageKey(s.first, h256(v.first)), asString(rlp(v.second)));
+			else
+				batch.Delete(storageKey(s.first, h256(v.first)));
+	batch.Put(c_rootKey, ldb::Slice((char const*)_root.data(), h256::size));
+	writeBatch(m_db.get(), batch);
+
+	m_diskRoot = _root;
+	m_layers.erase(_root);
+}
+
+void StateSnapshot::setBloom(Layer& _layer, Layer const* _parent) const
+{
+	if (_parent)
+		_layer.bloom = _parent->bloom;
+	else
+		_layer.bloom.assign(c_bloomWords, 0);
+	for (auto const& a: _layer.diff.accounts)
+		bloomAdd(_layer.bloom, accountHash(a.first));
+	for (auto const& s: _layer.diff.storage)
+		for (auto const& v: s.second)
+			bloomAdd(_layer.bloom, slotHash(s.first, h256(v.first)));
+}
+
+void StateSnapshot::dropSideLayers()
+{
+	unordered_set<h256> keep;
+	for (auto it = m_layers.find(m_head); it != m_layers.end(); it = m_layers.find(it->second.parent))
+		keep.insert(it->first);
+	for (auto it = m_layers.begin(); it != m_layers.end();)
+		if (keep.count(it->first))
+			++it;
+		else
+			it = m_layers.erase(it);
+}
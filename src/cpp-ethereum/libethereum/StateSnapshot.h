@@ -0,0 +1,137 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StateSnapshot.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <libdevcore/Common.h>
+#include <libdevcore/Exceptions.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+#include <libdevcore/db.h>
+#include <libethcore/Common.h>
+
+namespace dev
+{
+
+class OverlayDB;
+
+namespace eth
+{
+
+DEV_SIMPLE_EXCEPTION(StateSnapshotGenerationFailed);
+
+/// Changes written to the state trie by one commit, in the flat form kept by StateSnapshot.
+struct StateDiff
+{
+	std::unordered_map<Address, std::string> accounts;						///< RLP of the changed accounts, empty for deleted ones.
+	std::unordered_map<Address, std::unordered_map<u256, u256>> storage;	///< Changed storage slots, zero for deleted ones.
+	std::unordered_set<Address> wiped;										///< Accounts whose storage was cleared before the changes in storage.
+};
+
+/**
+ * @brief Flat key-value view of the account state, so that reads do not descend the trie.
+ * The disk layer maps addresses to account RLP and (address, slot) pairs to storage values
+ * for a single state root. Every commit on top of a root the snapshot knows adds an in-memory
+ * diff layer for the new root. cap() keeps the layers of the recent blocks below the head,
+ * flattens the older ones into the disk layer and drops the ones off the head's chain.
+ *
+ * The trie stays authoritative: reads at a root the snapshot does not know return false and
+ * are served by the trie.
+ */
+class StateSnapshot
+{
+public:
+	struct Stats
+	{
+		size_t layers = 0;
+		h256 diskRoot;
+		uint64_t hits = 0;		///< Reads served.
+		uint64_t misses = 0;	///< Reads at unknown roots.
+	};
+
+	/// Diff layers kept below the head by default, enough to follow the reorganisations of the recent blocks.
+	static const unsigned c_defaultLayers = 128;
+	/// Bound of the diff layers, side layers are dropped to make room for new ones.
+	static const unsigned c_maxLayers = 512;
+
+	/// Opens or creates the disk layer in @a _path.
+	explicit StateSnapshot(std::string const& _path);
+
+	/// Root of the state held by the disk layer, zero if it has none.
+	h256 diskRoot() const;
+	/// True if reads at @a _root are served by the snapshot.
+	bool knows(h256 const& _root) const;
+
+	/// Reads the RLP of account @a _addr at @a _root, empty if it does not exist.
+	/// @returns false if the snapshot does not know @a _root.
+	bool account(h256 const& _root, Address const& _addr, std::string& o_rlp) const;
+	/// Reads the storage slot @a _key of account @a _addr at @a _root, zero if unset.
+	/// @returns false if the snapshot does not know @a _root.
+	bool storage(h256 const& _root, Address const& _addr, u256 const& _key, u256& o_value) const;
+
+	/// Adds the diff layer of @a _root, committed on top of @a _parent. Ignored if @a _parent
+	/// is unknown or @a _root already known.
+	void update(h256 const& _parent, h256 const& _root, StateDiff&& _diff);
+
+	/// Keeps at most @a _layers diff layers below @a _head, flattening the older ones into the
+	/// disk layer, and drops the layers that are not ancestors of @a _head.
+	/// @returns false if @a _head is unknown, in which case nothing changes.
+	bool cap(h256 const& _head, unsigned _layers = c_defaultLayers);
+
+	/// Rebuilds the disk layer from the state trie at @a _root in @a _db and drops all diff layers.
+	/// Needs the key preimages of a fat trie; throws StateSnapshotGenerationFailed if one is missing.
+	void generate(OverlayDB const& _db, h256 const& _root);
+
+	Stats stats() const;
+
+private:
+	struct Layer
+	{
+		h256 parent;
+		StateDiff diff;
+		std::vector<uint64_t> bloom;	///< Keys changed by this layer and the ones below it.
+	};
+
+	using Layers = std::unordered_map<h256, Layer>;
+
+	bool knownRoot(h256 const& _root) const { return _root == m_diskRoot || m_layers.count(_root); }
+	std::string readDisk(std::string const& _key) const;
+	void flatten(h256 const& _root);
+	void setBloom(Layer& _layer, Layer const* _parent) const;
+	/// Drops the diff layers that are not ancestors of the last head passed to cap().
+	void dropSideLayers();
+
+	mutable SharedMutex x_snapshot;
+	std::unique_ptr<ldb::DB> m_db;
+	h256 m_diskRoot;
+	h256 m_head;
+	Layers m_layers;
+	mutable std::atomic<uint64_t> m_hits{0};
+	mutable std::atomic<uint64_t> m_misses{0};
+};
+
+}
+}
@@ -19,6 +19,26 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 #endif
 #endif
 
+namespace sha256d64_sse41
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256d64_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256d64_shani
+{
+void Transform_2way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256_shani
+{
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+}
+
 // Internal implementation code.
 namespace
 {
@@ -144,6 +164,39 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
 } // namespace sha256
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+
+/** Double-SHA256 of a 64-byte input using a single-block transform. */
+template<TransformType tr>
+void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
+{
+    uint32_t s[8];
+    static const unsigned char padding1[64] = {
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0
+    };
+    unsigned char buffer2[64] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0
+    };
+    sha256::Initialize(s);
+    tr(s, in, 1);
+    tr(s, padding1, 1);
+    for (int i = 0; i < 8; i++) WriteBE32(buffer2 + 4 * i, s[i]);
+    sha256::Initialize(s);
+    tr(s, buffer2, 1);
+    for (int i = 0; i < 8; i++) WriteBE32(out + 4 * i, s[i]);
+}
+
+TransformType Transform = sha256::Transform;
+TransformD64Type TransformD64 = TransformD64Wrapper<sha256::Transform>;
+TransformD64Type TransformD64_2way = nullptr;
+TransformD64Type TransformD64_4way = nullptr;
+TransformD64Type TransformD64_8way = nullptr;
 
 bool SelfTest(TransformType tr) {
     static const unsigned char in1[65] = {0, 0x80};
@@ -172,23 +225,104 @@ bool SelfTest(TransformType tr) {
     return true;
 }
 
-TransformType Transform = sha256::Transform;
+/** Check the selected double-SHA256 transforms against the generic one. */
+bool SelfTestD64() {
+    unsigned char in[8 * 64 + 1];
+    unsigned char expected[8 * 32], out[8 * 32];
+    for (int i = 0; i < 8 * 64; i++) in[i + 1] = i * 7 + 1;
+    // Unaligned input, as the hashes of a vector of uint256 are.
+    for (int i = 0; i < 8; i++) TransformD64Wrapper<sha256::Transform>(expected + 32 * i, in + 1 + 64 * i);
+    for (int i = 0; i < 8; i++) TransformD64(out + 32 * i, in + 1 + 64 * i);
+    if (memcmp(out, expected, sizeof(out))) return false;
+    if (TransformD64_2way) {
+        for (int i = 0; i < 8; i += 2) TransformD64_2way(out + 32 * i, in + 1 + 64 * i);
+        if (memcmp(out, expected, sizeof(out))) return false;
+    }
+    if (TransformD64_4way) {
+        for (int i = 0; i < 8; i += 4) TransformD64_4way(out + 32 * i, in + 1 + 64 * i);
+        if (memcmp(out, expected, sizeof(out))) return false;
+    }
+    if (TransformD64_8way) {
+        TransformD64_8way(out, in + 1);
+        if (memcmp(out, expected, sizeof(out))) return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+/** Check whether the OS has enabled the AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
 
 } // namespace
 
 std::string SHA256AutoDetect()
 {
+    std::string ret = "standard";
 #if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+    bool have_sse4 = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool have_shani = false;
+    bool enabled_avx = false;
+
+    (void)have_avx2;
+    (void)have_shani;
+    (void)enabled_avx;
+
     uint32_t eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 19) & 1) {
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_sse4 = (ecx >> 19) & 1;
+        have_avx = (ecx >> 28) & 1;
+        // AVX state has to be saved by the OS (OSXSAVE) for the registers to be usable
+        if (have_avx && ((ecx >> 27) & 1)) {
+            enabled_avx = AVXEnabled();
+        }
+    }
+    if (have_sse4 && __get_cpuid_max(0, nullptr) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+        have_shani = (ebx >> 29) & 1;
+    }
+
+#if defined(ENABLE_SHANI) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_shani) {
+        Transform = sha256_shani::Transform;
+        TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
+        TransformD64_2way = sha256d64_shani::Transform_2way;
+        ret = "shani(1way,2way)";
+        // The SHA instructions beat the 4 and 8-way kernels
+        have_sse4 = false;
+        have_avx2 = false;
+    }
+#endif
+
+    if (have_sse4) {
         Transform = sha256_sse4::Transform;
-        assert(SelfTest(Transform));
-        return "sse4";
+        TransformD64 = TransformD64Wrapper<sha256_sse4::Transform>;
+        ret = "sse4(1way)";
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+        TransformD64_4way = sha256d64_sse41::Transform_4way;
+        ret += ",sse41(4way)";
+#endif
     }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && enabled_avx) {
+        TransformD64_8way = sha256d64_avx2::Transform_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
 #endif
 
     assert(SelfTest(Transform));
-    return "standard";
+    assert(SelfTestD64());
+    return ret;
 }
 
 ////// SHA-256
@@ -247,3 +381,37 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    if (TransformD64_2way) {
+        while (blocks >= 2) {
+            TransformD64_2way(out, in);
+            out += 64;
+            in += 128;
+            blocks -= 2;
+        }
+    }
+    while (blocks) {
+        TransformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
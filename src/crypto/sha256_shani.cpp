@@ -0,0 +1,174 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Based on https://github.com/noloader/SHA-Intrinsics/blob/master/sha256-x86.c,
+// Written and placed in public domain by Jeffrey Walton.
+// Based on code from Intel, and by Sean Gulley for the miTLS project.
+
+#ifdef ENABLE_SHANI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace {
+
+alignas(__m128i) const uint32_t ROUND_K[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul
+};
+
+/** Round constants plus the expanded message of the padding block of a 64-byte input. */
+alignas(__m128i) const uint32_t PADDING_K[64] = {
+    0xc28a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf374ul,
+    0x649b69c1ul, 0xf0fe4786ul, 0x0fe1edc6ul, 0x240cf254ul, 0x4fe9346ful, 0x6cc984beul, 0x61b9411eul, 0x16f988faul,
+    0xf2c65152ul, 0xa88e5a6dul, 0xb019fc65ul, 0xb9d99ec7ul, 0x9a1231c3ul, 0xe70eeaa0ul, 0xfdb1232bul, 0xc7353eb0ul,
+    0x3069bad5ul, 0xcb976d5ful, 0x5a0f118ful, 0xdc1eeefdul, 0x0a35b689ul, 0xde0b7a04ul, 0x58f4ca9dul, 0xe15d5b16ul,
+    0x007f3e86ul, 0x37088980ul, 0xa507ea32ul, 0x6fab9537ul, 0x17406110ul, 0x0d8cd6f1ul, 0xcdaa3b6dul, 0xc0bbbe37ul,
+    0x83613bdaul, 0xdb48a363ul, 0x0b02e931ul, 0x6fd15ca7ul, 0x521afacaul, 0x31338431ul, 0x6ed41a95ul, 0x6d437890ul,
+    0xc39c91f2ul, 0x9eccabbdul, 0xb5c9a0e6ul, 0x532fb63cul, 0xd2c741c6ul, 0x07237ea3ul, 0xa4954b68ul, 0x4c191d76ul
+};
+
+alignas(__m128i) const uint8_t MASK[16] = {0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04, 0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c};
+alignas(__m128i) const uint32_t INIT[8] = {0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul};
+
+/** Four rounds, msg holds the round constants plus the message words. */
+void inline __attribute__((always_inline)) QuadRound(__m128i& state0, __m128i& state1, __m128i msg)
+{
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+void inline __attribute__((always_inline)) QuadRound(__m128i& state0, __m128i& state1, __m128i m, const uint32_t* k)
+{
+    QuadRound(state0, state1, _mm_add_epi32(m, _mm_load_si128((const __m128i*)k)));
+}
+
+/** Replace m0 by the next four message words, given the previous ones m0..m3. */
+void inline __attribute__((always_inline)) Expand(__m128i& m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3);
+}
+
+/** Convert the a..h state layout to the ABEF/CDGH one used by the SHA instructions. */
+void inline __attribute__((always_inline)) Shuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0xB1);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0x1B);
+    s0 = _mm_alignr_epi8(t1, t2, 0x08);
+    s1 = _mm_blend_epi16(t2, t1, 0xF0);
+}
+
+void inline __attribute__((always_inline)) Unshuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0x1B);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0xB1);
+    s0 = _mm_blend_epi16(t1, t2, 0xF0);
+    s1 = _mm_alignr_epi8(t2, t1, 0x08);
+}
+
+__m128i inline __attribute__((always_inline)) Load(const unsigned char* in)
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), _mm_load_si128((const __m128i*)MASK));
+}
+
+void inline __attribute__((always_inline)) Save(unsigned char* out, __m128i s)
+{
+    _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(s, _mm_load_si128((const __m128i*)MASK)));
+}
+
+/** Compress one block with message words m0..m3 into the shuffled state s0, s1. */
+void inline __attribute__((always_inline)) Compress(__m128i& s0, __m128i& s1, __m128i m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    const __m128i so0 = s0, so1 = s1;
+    QuadRound(s0, s1, m0, ROUND_K);
+    QuadRound(s0, s1, m1, ROUND_K + 4);
+    QuadRound(s0, s1, m2, ROUND_K + 8);
+    QuadRound(s0, s1, m3, ROUND_K + 12);
+    for (int i = 16; i < 64; i += 16) {
+        Expand(m0, m1, m2, m3);
+        QuadRound(s0, s1, m0, ROUND_K + i);
+        Expand(m1, m2, m3, m0);
+        QuadRound(s0, s1, m1, ROUND_K + i + 4);
+        Expand(m2, m3, m0, m1);
+        QuadRound(s0, s1, m2, ROUND_K + i + 8);
+        Expand(m3, m0, m1, m2);
+        QuadRound(s0, s1, m3, ROUND_K + i + 12);
+    }
+    s0 = _mm_add_epi32(s0, so0);
+    s1 = _mm_add_epi32(s1, so1);
+}
+
+/** Compress the padding block of a 64-byte input into the shuffled state s0, s1. */
+void inline __attribute__((always_inline)) CompressPadding(__m128i& s0, __m128i& s1)
+{
+    const __m128i so0 = s0, so1 = s1;
+    for (int i = 0; i < 64; i += 4) {
+        QuadRound(s0, s1, _mm_load_si128((const __m128i*)(PADDING_K + i)));
+    }
+    s0 = _mm_add_epi32(s0, so0);
+    s1 = _mm_add_epi32(s1, so1);
+}
+
+/** Double-SHA256 of one 64-byte input, the two instances of a call are independent. */
+void inline __attribute__((always_inline)) TransformD64(unsigned char* out, const unsigned char* in)
+{
+    __m128i s0 = _mm_load_si128((const __m128i*)INIT);
+    __m128i s1 = _mm_load_si128((const __m128i*)(INIT + 4));
+    Shuffle(s0, s1);
+    const __m128i init0 = s0, init1 = s1;
+
+    // Transform 1: the input block, and its padding
+    Compress(s0, s1, Load(in), Load(in + 16), Load(in + 32), Load(in + 48));
+    CompressPadding(s0, s1);
+
+    // Transform 2: the first hash, padded to one block
+    __m128i m0 = s0, m1 = s1;
+    Unshuffle(m0, m1);
+    s0 = init0;
+    s1 = init1;
+    Compress(s0, s1, m0, m1, _mm_set_epi32(0, 0, 0, 0x80000000ul), _mm_set_epi32(0x100ul, 0, 0, 0));
+
+    Unshuffle(s0, s1);
+    Save(out, s0);
+    Save(out + 16, s1);
+}
+
+}
+
+namespace sha256_shani {
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    __m128i s0 = _mm_loadu_si128((const __m128i*)s);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(s + 4));
+    Shuffle(s0, s1);
+
+    while (blocks--) {
+        Compress(s0, s1, Load(chunk), Load(chunk + 16), Load(chunk + 32), Load(chunk + 48));
+        chunk += 64;
+    }
+
+    Unshuffle(s0, s1);
+    _mm_storeu_si128((__m128i*)s, s0);
+    _mm_storeu_si128((__m128i*)(s + 4), s1);
+}
+}
+
+namespace sha256d64_shani {
+void Transform_2way(unsigned char* out, const unsigned char* in)
+{
+    // The rounds of a single hash depend on each other, interleaving two
+    // hashes keeps the SHA units busy.
+    TransformD64(out, in);
+    TransformD64(out + 32, in + 64);
+}
+}
+
+#endif
@@ -0,0 +1,154 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace sha256d64_sse41 {
+namespace {
+
+const uint32_t ROUND_K[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul
+};
+
+/** Round constants plus the expanded message of the padding block of a 64-byte input. */
+const uint32_t PADDING_K[64] = {
+    0xc28a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf374ul,
+    0x649b69c1ul, 0xf0fe4786ul, 0x0fe1edc6ul, 0x240cf254ul, 0x4fe9346ful, 0x6cc984beul, 0x61b9411eul, 0x16f988faul,
+    0xf2c65152ul, 0xa88e5a6dul, 0xb019fc65ul, 0xb9d99ec7ul, 0x9a1231c3ul, 0xe70eeaa0ul, 0xfdb1232bul, 0xc7353eb0ul,
+    0x3069bad5ul, 0xcb976d5ful, 0x5a0f118ful, 0xdc1eeefdul, 0x0a35b689ul, 0xde0b7a04ul, 0x58f4ca9dul, 0xe15d5b16ul,
+    0x007f3e86ul, 0x37088980ul, 0xa507ea32ul, 0x6fab9537ul, 0x17406110ul, 0x0d8cd6f1ul, 0xcdaa3b6dul, 0xc0bbbe37ul,
+    0x83613bdaul, 0xdb48a363ul, 0x0b02e931ul, 0x6fd15ca7ul, 0x521afacaul, 0x31338431ul, 0x6ed41a95ul, 0x6d437890ul,
+    0xc39c91f2ul, 0x9eccabbdul, 0xb5c9a0e6ul, 0x532fb63cul, 0xd2c741c6ul, 0x07237ea3ul, 0xa4954b68ul, 0x4c191d76ul
+};
+
+const uint32_t INIT[8] = {0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul};
+
+__m128i inline K(uint32_t x) { return _mm_set1_epi32(x); }
+
+__m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+__m128i inline Add(__m128i x, __m128i y, __m128i z) { return Add(Add(x, y), z); }
+__m128i inline Add(__m128i x, __m128i y, __m128i z, __m128i w) { return Add(Add(x, y), Add(z, w)); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__m128i inline Xor(__m128i x, __m128i y, __m128i z) { return Xor(Xor(x, y), z); }
+__m128i inline Or(__m128i x, __m128i y) { return _mm_or_si128(x, y); }
+__m128i inline And(__m128i x, __m128i y) { return _mm_and_si128(x, y); }
+__m128i inline ShR(__m128i x, int n) { return _mm_srli_epi32(x, n); }
+__m128i inline ShL(__m128i x, int n) { return _mm_slli_epi32(x, n); }
+
+__m128i inline Ch(__m128i x, __m128i y, __m128i z) { return Xor(z, And(x, Xor(y, z))); }
+__m128i inline Maj(__m128i x, __m128i y, __m128i z) { return Or(And(x, y), And(z, Or(x, y))); }
+__m128i inline Sigma0(__m128i x) { return Xor(Or(ShR(x, 2), ShL(x, 30)), Or(ShR(x, 13), ShL(x, 19)), Or(ShR(x, 22), ShL(x, 10))); }
+__m128i inline Sigma1(__m128i x) { return Xor(Or(ShR(x, 6), ShL(x, 26)), Or(ShR(x, 11), ShL(x, 21)), Or(ShR(x, 25), ShL(x, 7))); }
+__m128i inline sigma0(__m128i x) { return Xor(Or(ShR(x, 7), ShL(x, 25)), Or(ShR(x, 18), ShL(x, 14)), ShR(x, 3)); }
+__m128i inline sigma1(__m128i x) { return Xor(Or(ShR(x, 17), ShL(x, 15)), Or(ShR(x, 19), ShL(x, 13)), ShR(x, 10)); }
+
+/** One round of SHA-256, kw is the round constant plus the message word. */
+void inline __attribute__((always_inline)) Round(__m128i a, __m128i b, __m128i c, __m128i& d, __m128i e, __m128i f, __m128i g, __m128i& h, __m128i kw)
+{
+    __m128i t1 = Add(h, Sigma1(e), Ch(e, f, g), kw);
+    __m128i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+/** Eight rounds of SHA-256, rotating the arguments instead of moving the state around. */
+void inline __attribute__((always_inline)) Rounds8(__m128i* s, const __m128i* kw)
+{
+    Round(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], kw[0]);
+    Round(s[7], s[0], s[1], s[2], s[3], s[4], s[5], s[6], kw[1]);
+    Round(s[6], s[7], s[0], s[1], s[2], s[3], s[4], s[5], kw[2]);
+    Round(s[5], s[6], s[7], s[0], s[1], s[2], s[3], s[4], kw[3]);
+    Round(s[4], s[5], s[6], s[7], s[0], s[1], s[2], s[3], kw[4]);
+    Round(s[3], s[4], s[5], s[6], s[7], s[0], s[1], s[2], kw[5]);
+    Round(s[2], s[3], s[4], s[5], s[6], s[7], s[0], s[1], kw[6]);
+    Round(s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[0], kw[7]);
+}
+
+/** Compress one block per lane into s, w holds the 16 message words and is overwritten. */
+void inline __attribute__((always_inline)) Compress(__m128i* s, __m128i* w)
+{
+    __m128i t[8] = {s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]};
+    __m128i kw[8];
+    for (int i = 0; i < 64; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            int n = (i + j) & 15;
+            if (i >= 16) w[n] = Add(w[n], sigma1(w[(n + 14) & 15]), w[(n + 9) & 15], sigma0(w[(n + 1) & 15]));
+            kw[j] = Add(K(ROUND_K[i + j]), w[n]);
+        }
+        Rounds8(t, kw);
+    }
+    for (int i = 0; i < 8; i++) s[i] = Add(s[i], t[i]);
+}
+
+/** Compress the padding block of a 64-byte input into s. */
+void inline __attribute__((always_inline)) CompressPadding(__m128i* s)
+{
+    __m128i t[8] = {s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]};
+    __m128i kw[8];
+    for (int i = 0; i < 64; i += 8) {
+        for (int j = 0; j < 8; j++) kw[j] = K(PADDING_K[i + j]);
+        Rounds8(t, kw);
+    }
+    for (int i = 0; i < 8; i++) s[i] = Add(s[i], t[i]);
+}
+
+__m128i inline Read4(const unsigned char* chunk, int offset) {
+    __m128i ret = _mm_set_epi32(
+        ReadLE32(chunk + 0 + offset),
+        ReadLE32(chunk + 64 + offset),
+        ReadLE32(chunk + 128 + offset),
+        ReadLE32(chunk + 192 + offset)
+    );
+    return _mm_shuffle_epi8(ret, _mm_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+}
+
+void inline Write4(unsigned char* out, int offset, __m128i v) {
+    v = _mm_shuffle_epi8(v, _mm_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+    WriteLE32(out + 0 + offset, _mm_extract_epi32(v, 3));
+    WriteLE32(out + 32 + offset, _mm_extract_epi32(v, 2));
+    WriteLE32(out + 64 + offset, _mm_extract_epi32(v, 1));
+    WriteLE32(out + 96 + offset, _mm_extract_epi32(v, 0));
+}
+
+}
+
+void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    __m128i s[8], w[16];
+
+    // Transform 1: the input block
+    for (int i = 0; i < 8; i++) s[i] = K(INIT[i]);
+    for (int i = 0; i < 16; i++) w[i] = Read4(in, 4 * i);
+    Compress(s, w);
+
+    // Transform 2: its padding
+    CompressPadding(s);
+
+    // Transform 3: the first hash, padded to one block
+    for (int i = 0; i < 8; i++) w[i] = s[i];
+    w[8] = K(0x80000000ul);
+    for (int i = 9; i < 15; i++) w[i] = K(0);
+    w[15] = K(0x100ul);
+    for (int i = 0; i < 8; i++) s[i] = K(INIT[i]);
+    Compress(s, w);
+
+    for (int i = 0; i < 8; i++) Write4(out, 4 * i, s[i]);
+}
+
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <httpserver.h>
 #include <httprpc.h>
 #include <key.h>
+#include <libdevcore/SHA3.h>
 #include <validation.h>
 #include <miner.h>
 #include <netbase.h>
@@ -28,6 +29,7 @@
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
+#include <qtum/statepruner.h>
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <rpc/safemode.h>
@@ -198,6 +200,7 @@ void Shutdown()
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    if (peerLogic) peerLogic->StopWorkers();
     if (g_connman) g_connman->Stop();
     peerLogic.reset();
     g_connman.reset();
@@ -254,6 +257,10 @@ void Shutdown()
         prevokedticketview.reset();
         pblocktree.reset();
         pstorageresult.reset();
+        if (globalState && globalState->snapshot()) {
+            // Keep the snapshot for the next start
+            globalState->snapshot()->cap(globalState->rootHash(), 0);
+        }
         globalState.reset();
         globalSealEngine.reset();
     }
@@ -356,6 +363,14 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
     }
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-statedbcache=<n>", strprintf(_("Set contract state database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultStateDbCache));
+    strUsage += HelpMessageOpt("-asyncstatecommit", strprintf(_("Write the contract state and receipts of connected blocks on background threads (default: %u)"), DEFAULT_ASYNC_STATE_COMMIT));
+    strUsage += HelpMessageOpt("-statetriecache=<n>", strprintf(_("Set the size of the cache of contract state trie nodes in megabytes, 0 to disable it (0 to %d, default: %d)"), nMaxDbCache, nDefaultStateTrieCache));
+    strUsage += HelpMessageOpt("-statesnapshot", strprintf(_("Read the contract state from a flat snapshot kept at the recent blocks instead of the state trie (default: %u)"), DEFAULT_STATE_SNAPSHOT));
+    if (showDebug) {
+        strUsage += HelpMessageOpt("-statedbbloombits=<n>", strprintf("Bits per key of the contract state database bloom filters, 0 to disable them (0 to %d, default: %d)", nMaxStateDbBloomBits, nDefaultStateDbBloomBits));
+        strUsage += HelpMessageOpt("-statedbwritebuffer=<n>", strprintf("Write buffer size of each contract state database in megabytes (default: %d)", nDefaultStateDbWriteBuffer));
+    }
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
@@ -368,14 +383,25 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
-    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification and contract storage commit threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Set the number of threads reading block inputs from the coins database before connecting a block (0 to %d, 0 = disabled, default: %d)"),
+        MAX_COINPREFETCH_THREADS, DEFAULT_COINPREFETCH_THREADS));
+    strUsage += HelpMessageOpt("-txprecheckthreads=<n>", strprintf(_("Set the number of threads verifying the scripts of relayed transactions as they are received, ahead of mempool acceptance (0 to %d, 0 = disabled, default: %d)"),
+        MAX_TXPRECHECK_THREADS, DEFAULT_TXPRECHECK_THREADS));
+    if (showDebug)
+        strUsage += HelpMessageOpt("-txprecheckwindow=<n>", strprintf("Time in milliseconds to collect relayed transactions before verifying them together (default: %d)", DEFAULT_TXPRECHECK_WINDOW));
+    strUsage += HelpMessageOpt("-headercheckthreads=<n>", strprintf(_("Set the number of threads checking received headers before they are added to the block index (0 to %d, 0 = disabled, default: %d)"),
+        MAX_HEADERCHECK_THREADS, DEFAULT_HEADERCHECK_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
+    strUsage += HelpMessageOpt("-prunestate=<n>", strprintf(_("Reduce storage requirements by deleting the contract state of old blocks in the background, keeping the state of the last <n> blocks. "
+            "Warning: Reverting this setting requires rebuilding the chain state with -reindex-chainstate. "
+            "(default: 0 = keep the state of all blocks, >=%u = number of blocks to keep)"), MIN_STATE_BLOCKS_TO_KEEP));
     strUsage += HelpMessageOpt("-record-log-opcodes", strprintf(_("Logs all EVM LOG opcode operations to the file vmExecLogs.json")));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
@@ -390,6 +416,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-banscore=<n>", strprintf(_("Threshold for disconnecting misbehaving peers (default: %u)"), DEFAULT_BANSCORE_THRESHOLD));
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), DEFAULT_MISBEHAVING_BANTIME));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
+    strUsage += HelpMessageOpt("-blockservecache=<n>", strprintf(_("Maximum size in MiB of the cache of blocks recently served to peers (default: %u)"), DEFAULT_BLOCK_SERVE_CACHE));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s); -connect=0 disables automatic connections (the rules for this peer are the same as for -addnode)"));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)"));
     strUsage += HelpMessageOpt("-dns", _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + strprintf(_("(default: %u)"), DEFAULT_NAME_LOOKUP));
@@ -402,6 +429,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msgworkerthreads=<n>", strprintf(_("Set the number of threads serving block requests, checking received blocks and decoding relayed transactions off the message handler thread (0 to %d, 0 = disabled, default: %d)"),
+        MAX_MSG_WORKER_THREADS, DEFAULT_MSG_WORKER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -437,6 +466,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubmsgstats=<address>", _("Enable publish received message time statistics on each new tip in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -945,7 +975,12 @@ bool AppInitParameterInteraction()
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
+#ifdef USE_EPOLL
+    // epoll and poll() are not bound by FD_SETSIZE, only by the descriptor limit below
+    (void)nBind;
+#else
     nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+#endif
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1053,6 +1088,15 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // Lookups are I/O bound, so this does not depend on the number of cores
+    nCoinPrefetchThreads = std::max(0, std::min((int)gArgs.GetArg("-prefetchthreads", DEFAULT_COINPREFETCH_THREADS), MAX_COINPREFETCH_THREADS));
+
+    nTxPreCheckThreads = std::max(0, std::min((int)gArgs.GetArg("-txprecheckthreads", DEFAULT_TXPRECHECK_THREADS), MAX_TXPRECHECK_THREADS));
+    nTxPreCheckWindow = std::max((int64_t)0, gArgs.GetArg("-txprecheckwindow", DEFAULT_TXPRECHECK_WINDOW));
+
+    // The master thread takes part in the checks as well
+    nHeaderCheckThreads = std::max(0, std::min((int)gArgs.GetArg("-headercheckthreads", DEFAULT_HEADERCHECK_THREADS), MAX_HEADERCHECK_THREADS));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1071,6 +1115,19 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    // contract state pruning; get the number of blocks whose state is kept
+    int64_t nPruneStateArg = gArgs.GetArg("-prunestate", 0);
+    if (nPruneStateArg < 0) {
+        return InitError(_("Prunestate cannot be configured with a negative value."));
+    }
+    if (nPruneStateArg > 0 && nPruneStateArg < MIN_STATE_BLOCKS_TO_KEEP) {
+        return InitError(strprintf(_("Prunestate configured below the minimum of %d blocks.  Please use a higher number."), MIN_STATE_BLOCKS_TO_KEEP));
+    }
+    nStatePruneDepth = (unsigned int)std::min(nPruneStateArg, (int64_t)std::numeric_limits<int>::max());
+    if (nStatePruneDepth) {
+        LogPrintf("Contract state pruning enabled, keeping the state of the last %u blocks.\n", nStatePruneDepth);
+    }
+
     nConnectTimeout = gArgs.GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0)
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
@@ -1197,6 +1254,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string keccak_algo = dev::sha3AutoDetect();
+    LogPrintf("Using the '%s' Keccak implementation\n", keccak_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1272,6 +1331,22 @@ bool AppInitMain()
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    LogPrintf("Using %u threads for coin prefetch\n", nCoinPrefetchThreads);
+    for (int i=0; i<nCoinPrefetchThreads; i++)
+        threadGroup.create_thread(&ThreadCoinPrefetch);
+
+    LogPrintf("Using %u threads for relayed transaction pre-verification\n", nTxPreCheckThreads);
+    if (nTxPreCheckThreads) {
+        // The collector takes part in the verification of its batches
+        threadGroup.create_thread(&ThreadTxPreCheckCollector);
+        for (int i=0; i<nTxPreCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadTxPreCheck);
+    }
+
+    LogPrintf("Using %u threads for header checks\n", nHeaderCheckThreads);
+    for (int i=0; i<nHeaderCheckThreads; i++)
+        threadGroup.create_thread(&ThreadHeaderCheck);
+
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
@@ -1316,7 +1391,10 @@ bool AppInitMain()
     g_connman = std::unique_ptr<CConnman>(new CConnman(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max())));
     CConnman& connman = *g_connman;
 
-    peerLogic.reset(new PeerLogicValidation(&connman, scheduler));
+    int nMsgWorkerThreads = std::max(0, std::min((int)gArgs.GetArg("-msgworkerthreads", DEFAULT_MSG_WORKER_THREADS), MAX_MSG_WORKER_THREADS));
+    LogPrintf("Using %u message worker threads\n", nMsgWorkerThreads);
+    peerLogic.reset(new PeerLogicValidation(&connman, scheduler, nMsgWorkerThreads));
+    SetBlockServeCacheSize(std::max((int64_t)0, gArgs.GetArg("-blockservecache", DEFAULT_BLOCK_SERVE_CACHE)) << 20);
     RegisterValidationInterface(peerLogic.get());
 
     // sanitize comments per BIP-0014, format user agent and check total size
@@ -1447,6 +1525,17 @@ bool AppInitMain()
     nTotalCache -= nCoinDBCache;
     int64_t ndbinfoCache = (1 << 25); // 32MiB
     int64_t nticketCache = (1 << 22); // 4MiB
+    dev::eth::StateDBOptions stateDBOptions;
+    int64_t nStateDBCache = gArgs.GetArg("-statedbcache", nDefaultStateDbCache);
+    nStateDBCache = std::min(std::max(nStateDBCache, nMinDbCache), nMaxDbCache);
+    stateDBOptions.cacheSize = nStateDBCache << 20;
+    stateDBOptions.bloomBits = std::min(std::max((int)gArgs.GetArg("-statedbbloombits", nDefaultStateDbBloomBits), 0), nMaxStateDbBloomBits);
+    stateDBOptions.writeBufferSize = std::max(gArgs.GetArg("-statedbwritebuffer", nDefaultStateDbWriteBuffer), (int64_t)1) << 20;
+    stateDBOptions.nodeCacheSize = std::min(std::max(gArgs.GetArg("-statetriecache", nDefaultStateTrieCache), (int64_t)0), nMaxDbCache) << 20;
+    // The script check threads are idle while a connected block writes its contract state
+    stateDBOptions.commitThreads = nScriptCheckThreads;
+    stateDBOptions.asyncCommit = gArgs.GetBoolArg("-asyncstatecommit", DEFAULT_ASYNC_STATE_COMMIT);
+    dev::eth::State::setDBOptions(stateDBOptions);
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
@@ -1454,6 +1543,10 @@ bool AppInitMain()
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for database info DB\n", ndbinfoCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for ticket state database DB\n", nticketCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for contract state database (bloom filter %d bits per key, %.1fMiB write buffers)\n", stateDBOptions.cacheSize * (1.0 / 1024 / 1024), stateDBOptions.bloomBits, stateDBOptions.writeBufferSize * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for contract state trie node cache\n", stateDBOptions.nodeCacheSize * (1.0 / 1024 / 1024));
+    if (stateDBOptions.asyncCommit)
+        LogPrintf("* Writing the contract state on background threads\n");
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
@@ -1519,6 +1612,16 @@ bool AppInitMain()
                     break;
                 }
 
+                // Replaying the blocks writes the state of all of them again
+                if (fHavePrunedState && fReindexChainState) {
+                    fHavePrunedState = false;
+                    pblocktree->WriteFlag("prunedstate", false);
+                }
+                if (fHavePrunedState && !nStatePruneDepth) {
+                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to go back to keeping the contract state of all blocks");
+                    break;
+                }
+
                 // At this point we're either in reindex or we've loaded a useful
                 // block tree into mapBlockIndex!
 
@@ -1593,6 +1696,8 @@ bool AppInitMain()
                 globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
 
                 pstorageresult.reset(new StorageResults(qtumStateDir.string()));
+                if (dev::eth::State::dbOptions().asyncCommit)
+                    pstorageresult->enableAsyncCommit();
                 if (fReset) {
                     pstorageresult->wipeResults();
                 }
@@ -1608,6 +1713,12 @@ bool AppInitMain()
                 globalState->db().commit();
                 globalState->dbUtxo().commit();
 
+                if (gArgs.GetBoolArg("-statesnapshot", DEFAULT_STATE_SNAPSHOT)) {
+                    uiInterface.InitMessage(_("Loading contract state snapshot..."));
+                    globalState->setSnapshot(std::make_shared<dev::eth::StateSnapshot>((qtumStateDir / "snapshot").string()));
+                    UpdateStateSnapshot();
+                }
+
                 fRecordLogOpcodes = gArgs.IsArgSet("-record-log-opcodes");
                 fIsVMlogFile = fs::exists(GetDataDir() / "vmExecLogs.json");
                 ///////////////////////////////////////////////////////////
@@ -1656,8 +1767,15 @@ bool AppInitMain()
                         }
                     }
 
+                    // Disconnecting blocks needs the contract state of their parents
+                    int nCheckBlocks = gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS);
+                    if (fHavePrunedState && (nCheckBlocks <= 0 || nCheckBlocks >= (int)nStatePruneDepth)) {
+                        LogPrintf("Prune: the contract state is only kept for the last %u blocks; only checking those\n", nStatePruneDepth);
+                        nCheckBlocks = nStatePruneDepth - 1;
+                    }
+
                     if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                                  nCheckBlocks)) {
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
@@ -1763,6 +1881,10 @@ bool AppInitMain()
 
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
+    if (nStatePruneDepth) {
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "stateprune", &ThreadStatePrune));
+    }
+
     // Wait for genesis block to be processed
     {
         WaitableLock lock(cs_GenesisWait);
@@ -26,6 +26,11 @@
 #include <fcntl.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -70,7 +75,7 @@ enum BindFlags {
     BF_WHITELIST    = (1U << 2),
 };
 
-const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
+const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
 static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // SHA256("localhostnonce")[0:8]
@@ -708,6 +713,7 @@ void CNode::copyStats(CNodeStats &stats)
     {
         LOCK(cs_vRecv);
         X(mapRecvBytesPerMsgCmd);
+        X(mapRecvTimePerMsgCmd);
         X(nRecvBytes);
     }
     X(fWhitelisted);
@@ -746,7 +752,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -786,6 +792,20 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+void CNode::RecordMessageTime(const std::string& command, int64_t nWait, int64_t nProcess, int64_t nCsMain)
+{
+    LOCK(cs_vRecv);
+    // Like the received bytes, only valid commands have their own entry
+    mapMsgCmdTime::iterator i = mapRecvTimePerMsgCmd.find(command);
+    if (i == mapRecvTimePerMsgCmd.end())
+        i = mapRecvTimePerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(i != mapRecvTimePerMsgCmd.end());
+    i->second.nCount++;
+    i->second.nWait += nWait;
+    i->second.nProcess += nProcess;
+    i->second.nCsMain += nCsMain;
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -844,14 +864,65 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
     return nCopy;
 }
 
+CRecvBufferPool g_recv_buffer_pool;
+
+CSerializeData CRecvBufferPool::Get(size_t nMessageSize)
+{
+    LOCK(cs);
+    if (mapBuffers.empty())
+        return CSerializeData();
+    auto it = mapBuffers.lower_bound(nMessageSize);
+    if (it == mapBuffers.end())
+        --it;
+    CSerializeData buf;
+    buf.swap(it->second);
+    nSize -= it->first;
+    mapBuffers.erase(it);
+    return buf;
+}
+
+void CRecvBufferPool::Put(CSerializeData&& buf)
+{
+    const size_t nCapacity = buf.capacity();
+    if (nCapacity <= RECV_BUFFER_STEP || nCapacity > nMaxSize)
+        return;
+    buf.clear();
+    LOCK(cs);
+    auto it = mapBuffers.emplace(nCapacity, CSerializeData());
+    it->second.swap(buf);
+    nSize += nCapacity;
+    while (nSize > nMaxSize) {
+        nSize -= mapBuffers.begin()->first;
+        mapBuffers.erase(mapBuffers.begin());
+    }
+}
+
+size_t CRecvBufferPool::Size() const
+{
+    LOCK(cs);
+    return mapBuffers.size();
+}
+
+CNetMessage::~CNetMessage()
+{
+    CSerializeData buf;
+    vRecv.swap(buf);
+    g_recv_buffer_pool.Put(std::move(buf));
+}
+
 int CNetMessage::readData(const char *pch, unsigned int nBytes)
 {
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
+    if (nDataPos == 0 && hdr.nMessageSize > RECV_BUFFER_STEP) {
+        // Receive into the buffer of a processed message, which does not need to grow if it was as large
+        CSerializeData buf = g_recv_buffer_pool.Get(hdr.nMessageSize);
+        vRecv.swap(buf);
+    }
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + RECV_BUFFER_STEP));
     }
 
     hasher.Write((const unsigned char*)pch, nCopy);
@@ -884,7 +955,7 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
+        const auto &data = **it;
         assert(data.size() > pnode->nSendOffset);
         int nBytes = 0;
         {
@@ -1145,302 +1216,493 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+#ifdef USE_EPOLL
+        AddSocketEvents(pnode);
+#endif
     }
 }
 
-void CConnman::ThreadSocketHandler()
+void CConnman::DisconnectNodes()
 {
-    unsigned int nPrevNodeCount = 0;
-    while (!interruptNet)
     {
-        //
-        // Disconnect nodes
-        //
+        LOCK(cs_vNodes);
+        // Disconnect unused nodes
+        std::vector<CNode*> vNodesCopy = vNodes;
+        for (CNode* pnode : vNodesCopy)
         {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            std::vector<CNode*> vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy)
+            if (pnode->fDisconnect)
             {
-                if (pnode->fDisconnect)
-                {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+                // remove from vNodes
+                vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+#ifdef USE_EPOLL
+                // closing the socket removes it from the epoll set
+                m_epoll_nodes.erase(pnode->GetId());
+#endif
 
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
+                // release outbound grant (if any)
+                pnode->grantOutbound.Release();
 
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+                // close socket and cleanup
+                pnode->CloseSocketDisconnect();
 
-                    // hold in disconnected pool until all refs are released
-                    pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
-                }
+                // hold in disconnected pool until all refs are released
+                pnode->Release();
+                vNodesDisconnected.push_back(pnode);
             }
         }
+    }
+    {
+        // Delete disconnected nodes
+        std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+        for (CNode* pnode : vNodesDisconnectedCopy)
         {
-            // Delete disconnected nodes
-            std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            for (CNode* pnode : vNodesDisconnectedCopy)
-            {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK(pnode->cs_inventory, lockInv);
-                        if (lockInv) {
-                            TRY_LOCK(pnode->cs_vSend, lockSend);
-                            if (lockSend) {
-                                fDelete = true;
-                            }
+            // wait until threads are done using it
+            if (pnode->GetRefCount() <= 0) {
+                bool fDelete = false;
+                {
+                    TRY_LOCK(pnode->cs_inventory, lockInv);
+                    if (lockInv) {
+                        TRY_LOCK(pnode->cs_vSend, lockSend);
+                        if (lockSend) {
+                            fDelete = true;
                         }
                     }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        DeleteNode(pnode);
-                    }
+                }
+                if (fDelete) {
+                    vNodesDisconnected.remove(pnode);
+                    DeleteNode(pnode);
                 }
             }
         }
-        size_t vNodesSize;
+    }
+}
+
+void CConnman::InactivityCheck(CNode* pnode)
+{
+    int64_t nTime = GetSystemTimeInSeconds();
+    if (nTime - pnode->nTimeConnected > 60)
+    {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
         {
-            LOCK(cs_vNodes);
-            vNodesSize = vNodes.size();
+            LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->GetId());
+            pnode->fDisconnect = true;
         }
-        if(vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            if(clientInterface)
-                clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
+        else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
+        {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
+        {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
         }
+        else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+        {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
+        }
+        else if (!pnode->fSuccessfullyConnected)
+        {
+            LogPrintf("version handshake timeout from %d\n", pnode->GetId());
+            pnode->fDisconnect = true;
+        }
+    }
+}
 
-        //
-        // Find which sockets have data to receive
-        //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+bool CConnman::SocketHandlerNode(CNode* pnode, bool recvSet, bool sendSet, bool errorSet)
+{
+    bool fMoreRecv = false;
 
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
+    //
+    // Receive
+    //
+    if (recvSet || errorSet)
+    {
+        // typical socket buffer is 8K-64K
+        char pchBuf[0x10000];
+        int nBytes = 0;
+        {
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                return false;
+            nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
         }
-
+        if (nBytes > 0)
         {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
+            // A short read drained the socket
+            fMoreRecv = nBytes == (int)sizeof(pchBuf);
+            bool notify = false;
+            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+                pnode->CloseSocketDisconnect();
+            RecordBytesRecv(nBytes);
+            if (notify) {
+                size_t nSizeAdded = 0;
+                auto it(pnode->vRecvMsg.begin());
+                for (; it != pnode->vRecvMsg.end(); ++it) {
+                    if (!it->complete())
+                        break;
+                    m_msgproc->ReceivedMessage(pnode, *it);
+                    nSizeAdded += it->hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+                }
                 {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
+                    LOCK(pnode->cs_vProcessMsg);
+                    pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                    pnode->nProcessQueueSize += nSizeAdded;
+                    pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
                 }
+                WakeMessageHandler();
+            }
+        }
+        else if (nBytes == 0)
+        {
+            // socket closed gracefully
+            if (!pnode->fDisconnect) {
+                LogPrint(BCLog::NET, "socket closed\n");
+            }
+            pnode->CloseSocketDisconnect();
+        }
+        else if (nBytes < 0)
+        {
+            // error
+            int nErr = WSAGetLastError();
+            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+            {
+                if (!pnode->fDisconnect)
+                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+                pnode->CloseSocketDisconnect();
+            }
+        }
+    }
 
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
+    //
+    // Send
+    //
+    if (sendSet)
+    {
+        LOCK(pnode->cs_vSend);
+        size_t nBytes = SocketSendData(pnode);
+        if (nBytes) {
+            RecordBytesSent(nBytes);
+        }
+    }
 
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
+    return fMoreRecv;
+}
 
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
+void CConnman::SocketHandlerSelect()
+{
+    //
+    // Find which sockets have data to receive
+    //
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = 50000; // frequency to poll pnode->vSend
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-        if (interruptNet)
-            return;
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
 
-        if (nSelect == SOCKET_ERROR)
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        FD_SET(hListenSocket.socket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hListenSocket.socket);
+        have_fds = true;
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
         {
-            if (have_fds)
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
             {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+#ifdef USE_POLL
+            // Only reached when epoll is not available, sockets are not checked against FD_SETSIZE then
+            if (pnode->hSocket >= FD_SETSIZE) {
+                pnode->fDisconnect = true;
+                continue;
+            }
+#endif
+
+            FD_SET(pnode->hSocket, &fdsetError);
+            hSocketMax = std::max(hSocketMax, pnode->hSocket);
+            have_fds = true;
+
+            if (select_send) {
+                FD_SET(pnode->hSocket, &fdsetSend);
+                continue;
+            }
+            if (select_recv) {
+                FD_SET(pnode->hSocket, &fdsetRecv);
             }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
         }
+    }
 
-        //
-        // Accept new connections
-        //
-        for (const ListenSocket& hListenSocket : vhListenSocket)
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
-            {
-                AcceptConnection(hListenSocket);
-            }
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            for (unsigned int i = 0; i <= hSocketMax; i++)
+                FD_SET(i, &fdsetRecv);
         }
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
+            return;
+    }
 
-        //
-        // Service each socket
-        //
-        std::vector<CNode*> vNodesCopy;
+    //
+    // Accept new connections
+    //
+    for (const ListenSocket& hListenSocket : vhListenSocket)
+    {
+        if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
         {
-            LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy)
-                pnode->AddRef();
+            AcceptConnection(hListenSocket);
         }
+    }
+
+    //
+    // Service each socket
+    //
+    std::vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        vNodesCopy = vNodes;
         for (CNode* pnode : vNodesCopy)
+            pnode->AddRef();
+    }
+    for (CNode* pnode : vNodesCopy)
+    {
+        if (interruptNet)
+            return;
+
+        bool recvSet = false;
+        bool sendSet = false;
+        bool errorSet = false;
         {
-            if (interruptNet)
-                return;
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
+            sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
+            errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+        }
+        SocketHandlerNode(pnode, recvSet, sendSet, errorSet);
 
-            //
-            // Receive
-            //
-            bool recvSet = false;
-            bool sendSet = false;
-            bool errorSet = false;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
-            }
-            if (recvSet || errorSet)
-            {
-                // typical socket buffer is 8K-64K
-                char pchBuf[0x10000];
-                int nBytes = 0;
-                {
-                    LOCK(pnode->cs_hSocket);
-                    if (pnode->hSocket == INVALID_SOCKET)
-                        continue;
-                    nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                }
-                if (nBytes > 0)
-                {
-                    bool notify = false;
-                    if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                        pnode->CloseSocketDisconnect();
-                    RecordBytesRecv(nBytes);
-                    if (notify) {
-                        size_t nSizeAdded = 0;
-                        auto it(pnode->vRecvMsg.begin());
-                        for (; it != pnode->vRecvMsg.end(); ++it) {
-                            if (!it->complete())
-                                break;
-                            nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                        }
-                        {
-                            LOCK(pnode->cs_vProcessMsg);
-                            pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                            pnode->nProcessQueueSize += nSizeAdded;
-                            pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                        }
-                        WakeMessageHandler();
-                    }
-                }
-                else if (nBytes == 0)
-                {
-                    // socket closed gracefully
-                    if (!pnode->fDisconnect) {
-                        LogPrint(BCLog::NET, "socket closed\n");
-                    }
-                    pnode->CloseSocketDisconnect();
-                }
-                else if (nBytes < 0)
-                {
-                    // error
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                    {
-                        if (!pnode->fDisconnect)
-                            LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                        pnode->CloseSocketDisconnect();
-                    }
-                }
-            }
+        //
+        // Inactivity checking
+        //
+        InactivityCheck(pnode);
+    }
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodesCopy)
+            pnode->Release();
+    }
+}
 
-            //
-            // Send
-            //
-            if (sendSet)
-            {
-                LOCK(pnode->cs_vSend);
-                size_t nBytes = SocketSendData(pnode);
-                if (nBytes) {
-                    RecordBytesSent(nBytes);
-                }
+#ifdef USE_EPOLL
+namespace {
+/** Tag of the epoll data of listening sockets, the other entries hold node ids */
+const uint64_t EPOLL_LISTEN_SOCKET = 1ULL << 63;
+/** Events handled per epoll_wait() */
+const int MAX_EPOLL_EVENTS = 256;
+}
+
+bool CConnman::StartSocketEvents()
+{
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        LogPrintf("epoll_create1() failed, using select(): %s\n", NetworkErrorString(errno));
+        return false;
+    }
+    m_last_inactivity_check = 0;
+    for (size_t i = 0; i < vhListenSocket.size(); i++) {
+        // Level-triggered, one connection is accepted per wakeup
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = EPOLL_LISTEN_SOCKET | i;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, vhListenSocket[i].socket, &event) != 0) {
+            LogPrintf("epoll_ctl() failed for a listening socket, using select(): %s\n", NetworkErrorString(errno));
+            close(m_epoll_fd);
+            m_epoll_fd = -1;
+            return false;
+        }
+    }
+    return true;
+}
+
+void CConnman::AddSocketEvents(CNode* pnode)
+{
+    if (m_epoll_fd == -1)
+        return;
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET)
+        return;
+    // Edge-triggered: an event is only reported when the socket becomes ready,
+    // m_recv_ready remembers the sockets with data left to receive.
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = pnode->GetId();
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+        LogPrintf("epoll_ctl() failed for peer=%d: %s\n", pnode->GetId(), NetworkErrorString(errno));
+        pnode->fDisconnect = true;
+        return;
+    }
+    m_epoll_nodes[pnode->GetId()] = pnode;
+}
+
+void CConnman::SocketHandlerEpoll()
+{
+    // Sleep only if no node has data left to receive, paused nodes wait for the message handler
+    int nTimeout = 50;
+    {
+        LOCK(cs_vNodes);
+        for (auto it = m_recv_ready.begin(); it != m_recv_ready.end();) {
+            auto mi = m_epoll_nodes.find(*it);
+            if (mi == m_epoll_nodes.end()) {
+                it = m_recv_ready.erase(it);
+                continue;
             }
+            if (!mi->second->fPauseRecv)
+                nTimeout = 0;
+            ++it;
+        }
+    }
 
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetSystemTimeInSeconds();
-            if (nTime - pnode->nTimeConnected > 60)
-            {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
-                {
-                    LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->GetId());
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
-                {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
-                {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                }
-                else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
-                {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-                else if (!pnode->fSuccessfullyConnected)
-                {
-                    LogPrintf("version handshake timeout from %d\n", pnode->GetId());
-                    pnode->fDisconnect = true;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(m_epoll_fd, events, MAX_EPOLL_EVENTS, nTimeout);
+    if (interruptNet)
+        return;
+    if (nEvents < 0) {
+        int nErr = errno;
+        if (nErr != EINTR)
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+        nEvents = 0;
+    }
+
+    std::set<NodeId> setSendReady;
+    for (int i = 0; i < nEvents; i++) {
+        const uint64_t data = events[i].data.u64;
+        if (data & EPOLL_LISTEN_SOCKET) {
+            size_t nListen = data & ~EPOLL_LISTEN_SOCKET;
+            if (nListen < vhListenSocket.size())
+                AcceptConnection(vhListenSocket[nListen]);
+            continue;
+        }
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            m_recv_ready.insert((NodeId)data);
+        if (events[i].events & EPOLLOUT)
+            setSendReady.insert((NodeId)data);
+    }
+
+    // The timeouts are in seconds, once a second all nodes are checked and
+    // their pending sends retried, everything else only visits ready nodes.
+    const int64_t nNow = GetSystemTimeInSeconds();
+    const bool fCheckAll = nNow != m_last_inactivity_check;
+    std::vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        if (fCheckAll) {
+            m_last_inactivity_check = nNow;
+            vNodesCopy = vNodes;
+        } else {
+            vNodesCopy.reserve(m_recv_ready.size() + setSendReady.size());
+            for (const std::set<NodeId>* pset : {&m_recv_ready, &setSendReady}) {
+                for (NodeId id : *pset) {
+                    auto mi = m_epoll_nodes.find(id);
+                    if (mi != m_epoll_nodes.end())
+                        vNodesCopy.push_back(mi->second);
                 }
             }
+            std::sort(vNodesCopy.begin(), vNodesCopy.end());
+            vNodesCopy.erase(std::unique(vNodesCopy.begin(), vNodesCopy.end()), vNodesCopy.end());
+        }
+        for (CNode* pnode : vNodesCopy)
+            pnode->AddRef();
+    }
+    for (CNode* pnode : vNodesCopy)
+    {
+        if (interruptNet)
+            break;
+
+        const NodeId id = pnode->GetId();
+        const bool recvSet = !pnode->fPauseRecv && m_recv_ready.count(id);
+        const bool sendSet = fCheckAll || setSendReady.count(id);
+        if (recvSet || sendSet) {
+            if (!SocketHandlerNode(pnode, recvSet, sendSet, false) && recvSet)
+                m_recv_ready.erase(id);
         }
+        if (fCheckAll)
+            InactivityCheck(pnode);
+    }
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodesCopy)
+            pnode->Release();
+    }
+}
+#endif
+
+void CConnman::ThreadSocketHandler()
+{
+    unsigned int nPrevNodeCount = 0;
+    while (!interruptNet)
+    {
+        //
+        // Disconnect nodes
+        //
+        DisconnectNodes();
+
+        size_t vNodesSize;
         {
             LOCK(cs_vNodes);
-            for (CNode* pnode : vNodesCopy)
-                pnode->Release();
+            vNodesSize = vNodes.size();
+        }
+        if(vNodesSize != nPrevNodeCount) {
+            nPrevNodeCount = vNodesSize;
+            if(clientInterface)
+                clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
         }
+
+#ifdef USE_EPOLL
+        if (m_epoll_fd != -1) {
+            SocketHandlerEpoll();
+            continue;
+        }
+#endif
+        SocketHandlerSelect();
     }
 }
 
@@ -1988,6 +2250,9 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+#ifdef USE_EPOLL
+        AddSocketEvents(pnode);
+#endif
     }
 }
 
@@ -2203,6 +2468,10 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nReceiveFloodSize = 0;
     flagInterruptMsgProc = false;
     SetTryNewOutboundPeer(false);
+#ifdef USE_EPOLL
+    m_epoll_fd = -1;
+    m_last_inactivity_check = 0;
+#endif
 
     Options connOptions;
     Init(connOptions);
@@ -2332,6 +2601,11 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         fMsgProcWake = false;
     }
 
+#ifdef USE_EPOLL
+    if (StartSocketEvents())
+        LogPrintf("Using epoll for the network sockets\n");
+#endif
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2439,6 +2713,14 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#ifdef USE_EPOLL
+    if (m_epoll_fd != -1) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    m_epoll_nodes.clear();
+    m_recv_ready.clear();
+#endif
     semOutbound.reset();
     semAddnode.reset();
 }
@@ -2740,11 +3022,15 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nextSendTimeFeeFilter = 0;
     fPauseRecv = false;
     fPauseSend = false;
+    fGetDataPending = false;
     nProcessQueueSize = 0;
 
-    for (const std::string &msg : getAllNetMessageTypes())
+    for (const std::string &msg : getAllNetMessageTypes()) {
         mapRecvBytesPerMsgCmd[msg] = 0;
+        mapRecvTimePerMsgCmd[msg];
+    }
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    mapRecvTimePerMsgCmd[NET_MESSAGE_COMMAND_OTHER];
 
     if (fLogIPs) {
         LogPrint(BCLog::NET, "Added connection to %s peer=%d\n", addrName, id);
@@ -2797,19 +3083,44 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+static CSharedNetMsg::Buffer MakeMessageHeader(const std::string& command, const std::vector<unsigned char>& data)
 {
-    size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
-
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
-    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
+    uint256 hash = Hash(data.data(), data.data() + data.size());
+    CMessageHeader hdr(Params().MessageStart(), command.c_str(), data.size());
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
+    return std::make_shared<const std::vector<unsigned char>>(std::move(serializedHeader));
+}
+
+CSharedNetMsg::CSharedNetMsg(CSerializedNetMsg&& msg) : command(std::move(msg.command))
+{
+    header = MakeMessageHeader(command, msg.data);
+    if (!msg.data.empty())
+        data = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
+}
+
+CSharedNetMsg::CSharedNetMsg(const std::string& commandIn, Buffer dataIn) : command(commandIn)
+{
+    static const std::vector<unsigned char> vEmpty;
+    header = MakeMessageHeader(command, dataIn ? *dataIn : vEmpty);
+    if (dataIn && !dataIn->empty())
+        data = std::move(dataIn);
+}
+
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+{
+    PushMessage(pnode, CSharedNetMsg(std::move(msg)));
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsg& msg)
+{
+    assert(!msg.IsNull());
+    size_t nMessageSize = msg.DataSize();
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
+    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
 
     size_t nBytesSent = 0;
     {
@@ -2822,9 +3133,9 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
+        pnode->vSendMsg.push_back(msg.header);
         if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+            pnode->vSendMsg.push_back(msg.data);
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
@@ -28,6 +28,8 @@
 #include <thread>
 #include <memory>
 #include <condition_variable>
+#include <set>
+#include <unordered_map>
 
 #ifndef WIN32
 #include <arpa/inet.h>
@@ -36,6 +38,7 @@
 
 class CScheduler;
 class CNode;
+class CNetMessage;
 
 namespace boost {
     class thread_group;
@@ -113,6 +116,27 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/**
+ * A message with its header and checksum built once. The buffers are shared,
+ * so the same message is queued to any number of peers without being copied
+ * or hashed again.
+ */
+struct CSharedNetMsg
+{
+    typedef std::shared_ptr<const std::vector<unsigned char>> Buffer;
+
+    CSharedNetMsg() = default;
+    explicit CSharedNetMsg(CSerializedNetMsg&& msg);
+    CSharedNetMsg(const std::string& commandIn, Buffer dataIn);
+
+    bool IsNull() const { return !header; }
+    size_t DataSize() const { return data ? data->size() : 0; }
+
+    Buffer header;
+    Buffer data;
+    std::string command;
+};
+
 class NetEventsInterface;
 class CConnman
 {
@@ -183,6 +207,7 @@ public:
     bool ForNode(NodeId id, std::function<bool(CNode* pnode)> func);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
+    void PushMessage(CNode* pnode, const CSharedNetMsg& msg);
 
     template<typename Callable>
     void ForEachNode(Callable&& func)
@@ -331,6 +356,17 @@ private:
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
+    void DisconnectNodes();
+    void InactivityCheck(CNode* pnode);
+    /** Receive from and send to the socket of pnode. @returns whether data may be left to receive */
+    bool SocketHandlerNode(CNode* pnode, bool recvSet, bool sendSet, bool errorSet);
+    void SocketHandlerSelect();
+#ifdef USE_EPOLL
+    bool StartSocketEvents();
+    /** Watch the socket of pnode for readiness, cs_vNodes must be held */
+    void AddSocketEvents(CNode* pnode);
+    void SocketHandlerEpoll();
+#endif
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -400,6 +436,15 @@ private:
     std::vector<CNode*> vNodes;
     std::list<CNode*> vNodesDisconnected;
     mutable CCriticalSection cs_vNodes;
+#ifdef USE_EPOLL
+    /** Edge-triggered epoll instance of the socket handler, -1 if it uses select() */
+    int m_epoll_fd;
+    /** Nodes whose sockets are watched by m_epoll_fd, protected by cs_vNodes */
+    std::unordered_map<NodeId, CNode*> m_epoll_nodes;
+    /** Nodes that may have data left to receive, only used by the socket handler thread */
+    std::set<NodeId> m_recv_ready;
+    int64_t m_last_inactivity_check;
+#endif
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
@@ -471,6 +516,8 @@ public:
     virtual bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
     virtual void FinalizeNode(NodeId id, bool& update_connection_time) = 0;
+    /** Called from the socket thread for every complete message, before it is queued for processing. The work started on msg may take its payload. */
+    virtual void ReceivedMessage(CNode* pnode, CNetMessage& msg) = 0;
 };
 
 enum
@@ -517,6 +564,18 @@ struct LocalServiceInfo {
 extern CCriticalSection cs_mapLocalHost;
 extern std::map<CNetAddr, LocalServiceInfo> mapLocalHost;
 typedef std::map<std::string, uint64_t> mapMsgCmdSize; //command, total bytes
+/** Key of the per command statistics under which messages of unknown commands are counted */
+extern const std::string NET_MESSAGE_COMMAND_OTHER;
+
+/** Time spent on the received messages of one command, in microseconds */
+struct CMsgCmdTime
+{
+    uint64_t nCount = 0;
+    int64_t nWait = 0;    //!< from their receipt to the start of their processing
+    int64_t nProcess = 0; //!< processing them
+    int64_t nCsMain = 0;  //!< holding cs_main while processing them
+};
+typedef std::map<std::string, CMsgCmdTime> mapMsgCmdTime; //command, total time
 
 class CNodeStats
 {
@@ -538,6 +597,7 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdTime mapRecvTimePerMsgCmd;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -553,6 +613,52 @@ public:
 
 
 
+/** Size by which the data buffer of a received message grows as the data arrives */
+static const unsigned int RECV_BUFFER_STEP = 256 * 1024;
+/** Maximum total capacity of the receive buffers kept for reuse */
+static const size_t RECV_BUFFER_POOL_SIZE = 32 * 1024 * 1024;
+
+/**
+ * Data buffers of processed messages larger than RECV_BUFFER_STEP, reused for
+ * the next large messages of all peers so that their data is not reallocated
+ * and copied as it arrives.
+ */
+class CRecvBufferPool
+{
+public:
+    explicit CRecvBufferPool(size_t nMaxSizeIn = RECV_BUFFER_POOL_SIZE) : nMaxSize(nMaxSizeIn), nSize(0) {}
+
+    /** The smallest buffer with room for nMessageSize bytes, else the largest one, empty if there is none */
+    CSerializeData Get(size_t nMessageSize);
+    /** Keep buf for reuse, the smallest buffers are dropped when the pool is full */
+    void Put(CSerializeData&& buf);
+
+    size_t Size() const;
+
+private:
+    mutable CCriticalSection cs;
+    std::multimap<size_t, CSerializeData> mapBuffers; // by capacity
+    size_t nMaxSize;
+    size_t nSize;
+};
+
+extern CRecvBufferPool g_recv_buffer_pool;
+
+/** Work started on a received message by NetEventsInterface::ReceivedMessage(), the message is processed once it is done */
+class CNetMessageTask
+{
+public:
+    virtual ~CNetMessageTask() {}
+
+    bool IsDone() const { return fDone; }
+
+protected:
+    void SetDone() { fDone = true; }
+
+private:
+    std::atomic_bool fDone{false};
+};
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
@@ -569,6 +675,8 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    std::shared_ptr<CNetMessageTask> task; // work started on the message before processing, if any
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
@@ -577,6 +685,8 @@ public:
         nTime = 0;
     }
 
+    ~CNetMessage();
+
     bool complete() const
     {
         if (!in_data)
@@ -608,7 +718,7 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CSharedNetMsg::Buffer> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -660,10 +770,13 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // A block requested by the peer is being sent off the message handler thread, its later requests wait for it
+    std::atomic_bool fGetDataPending;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdTime mapRecvTimePerMsgCmd;
 
 public:
     uint256 hashContinue;
@@ -695,6 +808,8 @@ public:
     std::vector<uint256> vBlockHashesToAnnounce;
     // Used for BIP35 mempool sending, also protected by cs_inventory
     bool fSendMempool;
+    // Votes to push as transactions ahead of the trickled inventory, also protected by cs_inventory
+    std::vector<uint256> vInventoryVoteToSend;
 
     // Last time a "MEMPOOL" request was serviced.
     std::atomic<int64_t> timeLastMempoolReq;
@@ -762,6 +877,9 @@ public:
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
 
+    /** Account the time spent on a received message, in microseconds, to its command */
+    void RecordMessageTime(const std::string& command, int64_t nWait, int64_t nProcess, int64_t nCsMain);
+
     void SetRecvVersion(int nVersionIn)
     {
         nRecvVersion = nVersionIn;
@@ -830,6 +948,14 @@ public:
         }
     }
 
+    void PushVoteInventory(const uint256& hash)
+    {
+        LOCK(cs_inventory);
+        if (!filterInventoryKnown.contains(hash)) {
+            vInventoryVoteToSend.push_back(hash);
+        }
+    }
+
     void PushBlockHash(const uint256 &hash)
     {
         LOCK(cs_inventory);
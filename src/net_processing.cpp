@@ -32,6 +32,9 @@
 #include <checkpoints.h>
 #include <clientversion.h>
 #include <consensus/merkle.h>
+#include <consensus/tx_verify.h>
+#include <stake/staketx.h>
+#include <qtum/rawblockcache.h>
 
 #include <wallet/test/wallet_stx_def.h>
 
@@ -155,6 +158,114 @@ namespace {
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
 } // namespace
 
+namespace {
+    /** Blocks recently served to peers, as stored in the block files, see -blockservecache */
+    CRawBlockCache rawBlockCache(DEFAULT_BLOCK_SERVE_CACHE << 20);
+
+    CCriticalSection cs_msg_time_stats;
+    /** Time spent on the received messages of each valid command, and of the others together */
+    std::map<std::string, CMsgTimeStats> mapMsgTimeStats;
+
+/** Transaction of a TX message, decoded and checked on the message workers before it reaches ProcessMessage */
+class CTxPreValidation : public CNetMessageTask
+{
+public:
+    CTxPreValidation(const CDataStream& vRecvIn, int nVersionIn) : nVersion(nVersionIn), vRecv(vRecvIn)
+    {
+        vRecv.SetVersion(nVersion);
+    }
+
+    /** Decode the transaction and run the checks of AcceptToMemoryPool that do not depend on the chain */
+    void Run();
+
+    /** Receive version of the peer the message was decoded with */
+    const int nVersion;
+    /** Null if the message could not be decoded, ProcessMessage decodes it again and reports the error */
+    CTransactionRef tx;
+    /** Result of the context-free checks of tx */
+    CValidationState state;
+    bool fVote = false;
+
+private:
+    CDataStream vRecv;
+};
+
+void CTxPreValidation::Run()
+{
+    try {
+        vRecv >> tx;
+    } catch (const std::exception&) {
+        tx.reset();
+    }
+    vRecv.clear();
+
+    if (tx) {
+        // Same checks and order as AcceptToMemoryPool, which checks the size against
+        // the block weight of the DGP under cs_main
+        std::string reason;
+        if (!CheckTransaction(*tx, state, true, false)) {
+            // state filled in by CheckTransaction
+        } else if (tx->IsCoinBase()) {
+            state.DoS(100, false, REJECT_INVALID, "coinbase");
+        } else if (tx->IsCoinStake()) {
+            state.DoS(100, false, REJECT_INVALID, "coinstake");
+        } else if (fRequireStandard && !tx->HasWitness() && !IsStandardTx(*tx, reason, true)) {
+            // Non-standard whatever the state of the witness deployment, which
+            // AcceptToMemoryPool looks at first for transactions with witness
+            state.DoS(0, false, REJECT_NONSTANDARD, reason);
+        }
+        CValidationStakeState stakestate;
+        fVote = IsSSGen(*tx, stakestate);
+        if (state.IsValid())
+            QueueTxPreCheck(tx);
+    }
+    SetDone();
+}
+
+/** Block of a BLOCK message, decoded and checked on the message workers before it reaches ProcessMessage */
+class CBlockPreValidation : public CNetMessageTask
+{
+public:
+    /** Takes the payload of the message, ProcessMessage uses the result of Run() instead */
+    CBlockPreValidation(CDataStream&& vRecvIn, int nVersion) : vRecv(std::move(vRecvIn))
+    {
+        vRecv.SetVersion(nVersion);
+    }
+
+    /** Decode the block and run the checks of CheckBlock that only depend on the block, which are marked as done if it passes */
+    void Run();
+
+    /** Null if the message could not be decoded */
+    std::shared_ptr<CBlock> pblock;
+    /** Why the message could not be decoded, ProcessMessage reports it */
+    std::exception_ptr decodeError;
+
+private:
+    CDataStream vRecv;
+};
+
+void CBlockPreValidation::Run()
+{
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    try {
+        vRecv >> *pblockRead;
+        pblock = pblockRead;
+    } catch (...) {
+        decodeError = std::current_exception();
+    }
+    // Free the payload
+    vRecv = CDataStream(vRecv.GetType(), vRecv.GetVersion());
+
+    if (pblock) {
+        // A block that fails is not marked as checked, ProcessNewBlock checks it
+        // again and reports the failure
+        CValidationState state;
+        CheckBlockContextFree(*pblock, state, Params().GetConsensus());
+    }
+    SetDone();
+}
+} // namespace
+
 namespace {
 
 struct CBlockReject {
@@ -344,6 +455,13 @@ struct CNodeState {
     //! Time of last new block announcement
     int64_t m_last_block_announcement;
 
+    //! The tip nVotesSent is for.
+    uint256 hashVoteTip;
+    //! Votes on hashVoteTip pushed to this peer.
+    unsigned int nVotesSent;
+    //! Height and number of the votes we did not have received from this peer, per block voted on.
+    std::map<uint256, std::pair<uint32_t, unsigned int>> mapVotesReceived;
+
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
         nMisbehavior = 0;
@@ -368,6 +486,8 @@ struct CNodeState {
         fSupportsDesiredCmpctVersion = false;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
+        hashVoteTip.SetNull();
+        nVotesSent = 0;
     }
 };
 
@@ -916,7 +1036,7 @@ static bool BlockRequestAllowed(const CBlockIndex* pindex, const Consensus::Para
         (GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, consensusParams) < STALE_RELAY_AGE_LIMIT);
 }
 
-PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &scheduler) : connman(connmanIn), m_stale_tip_check_time(0) {
+PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &scheduler, int nWorkerThreads) : connman(connmanIn), m_stale_tip_check_time(0), fMsgWorkers(false) {
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
 
@@ -927,6 +1047,34 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
     scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+
+    if (nWorkerThreads > 0) {
+        CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &msgWorkers);
+        for (int i = 0; i < nWorkerThreads; i++)
+            msgWorkerThreads.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "msgworker", serviceLoop));
+        fMsgWorkers = true;
+    }
+}
+
+PeerLogicValidation::~PeerLogicValidation()
+{
+    StopWorkers();
+}
+
+void SetBlockServeCacheSize(size_t nBytes)
+{
+    rawBlockCache.SetMaxBytes(nBytes);
+}
+
+void PeerLogicValidation::StopWorkers()
+{
+    if (!fMsgWorkers)
+        return;
+    // Tasks use the connection manager and its nodes
+    fMsgWorkers = false;
+    msgWorkers.stop();
+    msgWorkerThreads.interrupt_all();
+    msgWorkerThreads.join_all();
 }
 
 void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) {
@@ -965,9 +1113,18 @@ void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pb
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block;
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block;
+// most_recent_compact_block serialized with witnesses and PROTOCOL_VERSION, shared by the peers
+// it is sent to that take the stake short ids, see CanShareCompactBlock
+static CSharedNetMsg most_recent_compact_block_msg;
 static uint256 most_recent_block_hash;
 static bool fWitnessesPresentInMostRecentCompactBlock;
 
+/** Whether pnode takes the compact blocks as serialized with PROTOCOL_VERSION, older peers get no stake short ids */
+static bool CanShareCompactBlock(const CNode* pnode)
+{
+    return pnode->GetSendVersion() >= STAKE_SHORT_IDS_BLOCKS_VERSION;
+}
+
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
@@ -981,17 +1138,19 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
     bool fWitnessEnabled = IsWitnessEnabled(pindex->pprev, Params().GetConsensus());
     uint256 hashBlock(pblock->GetHash());
+    // Serialized and hashed once for all the peers
+    const CSharedNetMsg cmpctBlockMsg(msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
 
     {
         LOCK(cs_most_recent_block);
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
         most_recent_compact_block = pcmpctblock;
+        most_recent_compact_block_msg = cmpctBlockMsg;
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
-        // TODO: Avoid the repeated-serialization here
+    connman->ForEachNode([this, &cmpctBlockMsg, &pcmpctblock, pindex, fWitnessEnabled, &hashBlock](CNode* pnode) {
         if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -1003,7 +1162,10 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            if (CanShareCompactBlock(pnode))
+                connman->PushMessage(pnode, cmpctBlockMsg);
+            else
+                connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1115,12 +1277,79 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
+/** The tickets that can vote on the tip, requires cs_main */
+static std::vector<uint256> GetTipWinners()
+{
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if (!pindexTip || !pindexTip->stakeNode)
+        return std::vector<uint256>();
+    return pindexTip->stakeNode->Winners();
+}
+
+/** Whether tx is the vote of one of the winners, so that the next block needs it */
+bool IsWinnerVote(const CTransaction& tx, const std::vector<uint256>& winners)
+{
+    CValidationStakeState stakestate;
+    if (winners.empty() || !IsSSGen(tx, stakestate))
+        return false;
+    return std::find(winners.begin(), winners.end(), tx.vin[1].prevout.hash) != winners.end();
+}
+
+/** Reset the votes sent to a peer once the tip moved, requires cs_main */
+static void UpdateVoteTip(CNodeState* state)
+{
+    const uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    if (state->hashVoteTip != hashTip) {
+        state->hashVoteTip = hashTip;
+        state->nVotesSent = 0;
+    }
+}
+
+/**
+ * Count a vote we did not have received from a peer against the votes it may send on the
+ * block voted on, false if it sent too many. Requires cs_main, tx must have passed IsSSGen.
+ */
+bool CountReceivedVote(NodeId nodeid, const CTransaction& tx)
+{
+    CNodeState* state = State(nodeid);
+    uint256 hashVoted;
+    uint32_t nHeightVoted;
+    SSGenBlockVotedOn(tx, hashVoted, nHeightVoted);
+
+    size_t nWinners = Params().GetConsensus().TicketsPerBlock;
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashVoted);
+    if (mi != mapBlockIndex.end() && mi->second->stakeNode)
+        nWinners = mi->second->stakeNode->Winners().size();
+    // Nobody can vote on the block, leave the vote to AcceptToMemoryPool
+    if (nWinners == 0)
+        return true;
+
+    auto it = state->mapVotesReceived.find(hashVoted);
+    if (it == state->mapVotesReceived.end()) {
+        // Forget the blocks the tip moved past
+        for (auto itOld = state->mapVotesReceived.begin(); itOld != state->mapVotesReceived.end(); ) {
+            if ((int64_t)itOld->second.first < chainActive.Height())
+                itOld = state->mapVotesReceived.erase(itOld);
+            else
+                ++itOld;
+        }
+        if (state->mapVotesReceived.size() >= MAX_VOTED_BLOCKS_PER_PEER)
+            return false;
+        it = state->mapVotesReceived.emplace(hashVoted, std::make_pair(nHeightVoted, 0u)).first;
+    }
+    return ++it->second.second <= MAX_VOTES_PER_WINNER * nWinners;
+}
+
 static void RelayTransaction(const CTransaction& tx, CConnman* connman)
 {
     CInv inv(MSG_TX, tx.GetHash());
-    connman->ForEachNode([&inv](CNode* pnode)
+    const bool fVote = IsWinnerVote(tx, GetTipWinners());
+    connman->ForEachNode([&inv, fVote](CNode* pnode)
     {
-        pnode->PushInventory(inv);
+        if (fVote)
+            pnode->PushVoteInventory(inv.hash);
+        else
+            pnode->PushInventory(inv);
     });
 }
 
@@ -1160,16 +1389,35 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
-void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensusParams, const CInv& inv, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
+/** Make the BLOCK message of a block with witness from the block files, which store that serialization, without deserializing it */
+static bool MakeRawBlockMessage(const CBlockIndex* pindex, CSharedNetMsg& msg)
+{
+    CRawBlockCache::RawBlock block = rawBlockCache.Get(pindex->GetBlockHash());
+    if (!block) {
+        std::shared_ptr<std::vector<unsigned char>> blockRead = std::make_shared<std::vector<unsigned char>>();
+        if (!ReadRawBlockFromDisk(*blockRead, pindex, Params().MessageStart()))
+            return false;
+        block = blockRead;
+        rawBlockCache.Insert(pindex->GetBlockHash(), block);
+    }
+    // The message shares the cached bytes
+    msg = CSharedNetMsg(NetMsgType::BLOCK, std::move(block));
+    return true;
+}
+
+/** pworkers are the running message workers of the peer logic, if any */
+void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensusParams, const CInv& inv, CConnman* connman, const std::atomic<bool>& interruptMsgProc, CScheduler* pworkers)
 {
     bool send = false;
     std::shared_ptr<const CBlock> a_recent_block;
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block;
+    CSharedNetMsg a_recent_compact_block_msg;
     bool fWitnessesPresentInARecentCompactBlock;
     {
         LOCK(cs_most_recent_block);
         a_recent_block = most_recent_block;
         a_recent_compact_block = most_recent_compact_block;
+        a_recent_compact_block_msg = most_recent_compact_block_msg;
         fWitnessesPresentInARecentCompactBlock = fWitnessesPresentInMostRecentCompactBlock;
     }
 
@@ -1229,8 +1477,56 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
     if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
     {
         std::shared_ptr<const CBlock> pblock;
+        CSharedNetMsg rawBlockMsg;
         if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (pworkers && (inv.type == MSG_BLOCK || inv.type == MSG_WITNESS_BLOCK)) {
+            // Read and send the block on the message workers, the peer's later
+            // messages wait for it while the other peers are served
+            const CBlockIndex* pindex = mi->second;
+            const NodeId id = pfrom->GetId();
+            const int nSendVersion = pfrom->GetSendVersion();
+            const int nSendFlags = inv.type == MSG_BLOCK ? SERIALIZE_TRANSACTION_NO_WITNESS : 0;
+            // Trigger the peer node to send a getblocks request for the next batch of inventory
+            uint256 hashContinueTip;
+            if (inv.hash == pfrom->hashContinue) {
+                hashContinueTip = chainActive.Tip()->GetBlockHash();
+                pfrom->hashContinue.SetNull();
+            }
+            pfrom->fGetDataPending = true;
+            pworkers->schedule([pindex, id, nSendVersion, nSendFlags, hashContinueTip, connman, &consensusParams] {
+                const bool fWitness = nSendFlags == 0;
+                CSharedNetMsg rawBlockMsg;
+                CBlock block;
+                // Pruning may have deleted the block since it was requested
+                bool fRead = fWitness ? MakeRawBlockMessage(pindex, rawBlockMsg) : ReadBlockFromDisk(block, pindex, consensusParams);
+                connman->ForNode(id, [&](CNode* pnode) {
+                    if (!fRead) {
+                        LogPrintf("cannot load block %s from disk, disconnect peer=%d\n", pindex->GetBlockHash().ToString(), id);
+                        pnode->fDisconnect = true;
+                    } else {
+                        const CNetMsgMaker msgMaker(nSendVersion);
+                        if (fWitness)
+                            connman->PushMessage(pnode, rawBlockMsg);
+                        else
+                            connman->PushMessage(pnode, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, block));
+                        if (!hashContinueTip.IsNull()) {
+                            // Bypass PushInventory, see below
+                            std::vector<CInv> vInv;
+                            vInv.push_back(CInv(MSG_BLOCK, hashContinueTip));
+                            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::INV, vInv));
+                        }
+                    }
+                    pnode->fGetDataPending = false;
+                    return true;
+                });
+                connman->WakeMessageHandler();
+            });
+            return;
+        } else if (inv.type == MSG_WITNESS_BLOCK) {
+            // Send block from disk as it is stored
+            if (!MakeRawBlockMessage((*mi).second, rawBlockMsg))
+                assert(!"cannot load block from disk");
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1240,6 +1536,8 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
         }
         if (inv.type == MSG_BLOCK)
             connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
+        else if (inv.type == MSG_WITNESS_BLOCK && !pblock)
+            connman->PushMessage(pfrom, rawBlockMsg);
         else if (inv.type == MSG_WITNESS_BLOCK)
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
         else if (inv.type == MSG_FILTERED_BLOCK)
@@ -1278,7 +1576,10 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
             int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
             if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
                 if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == mi->second->GetBlockHash()) {
-                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+                    if (CanShareCompactBlock(pfrom))
+                        connman->PushMessage(pfrom, a_recent_compact_block_msg);
+                    else
+                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                 } else {
                     CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
                     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
@@ -1302,7 +1603,7 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
     }
 }
 
-void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
+void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, CScheduler* pworkers)
 {
     AssertLockNotHeld(cs_main);
 
@@ -1351,7 +1652,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
         const CInv &inv = *it;
         if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK || inv.type == MSG_WITNESS_BLOCK) {
             it++;
-            ProcessGetBlockData(pfrom, consensusParams, inv, connman, interruptMsgProc);
+            ProcessGetBlockData(pfrom, consensusParams, inv, connman, interruptMsgProc, pworkers);
         }
     }
 
@@ -1380,13 +1681,14 @@ uint32_t GetFetchFlags(CNode* pfrom) {
 inline void static SendBlockTransactions(const CBlock& block, const BlockTransactionsRequest& req, CNode* pfrom, CConnman* connman) {
     BlockTransactions resp(req);
     for (size_t i = 0; i < req.indexes.size(); i++) {
-        if (req.indexes[i] >= block.vtx.size()) {
+        // The indexes of the stake transactions follow the ones of vtx
+        if (req.indexes[i] >= block.vtx.size() + block.svtx.size()) {
             LOCK(cs_main);
             Misbehaving(pfrom->GetId(), 100);
             LogPrintf("Peer %d sent us a getblocktxn with out-of-bounds tx indices", pfrom->GetId());
             return;
         }
-        resp.txn[i] = block.vtx[req.indexes[i]];
+        resp.txn[i] = req.indexes[i] < block.vtx.size() ? block.vtx[req.indexes[i]] : block.svtx[req.indexes[i] - block.vtx.size()];
     }
     LOCK(cs_main);
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1613,7 +1915,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
-bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
+bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, const CNetMessageTask* task, CScheduler* pworkers)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
     if (gArgs.IsArgSet("-dropmessagestest") && GetRand(gArgs.GetArg("-dropmessagestest", 0)) == 0)
@@ -2053,7 +2355,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
 
         pfrom->vRecvGetData.insert(pfrom->vRecvGetData.end(), vInv.begin(), vInv.end());
-        ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
+        ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc, pworkers);
     }
 
 
@@ -2243,7 +2545,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         std::deque<COutPoint> vWorkQueue;
         std::vector<uint256> vEraseQueue;
         CTransactionRef ptx;
-        vRecv >> ptx;
+        // Decoded and checked by the message workers, unless the peer's version changed since
+        const CTxPreValidation* prevalid = static_cast<const CTxPreValidation*>(task);
+        if (prevalid && prevalid->tx && prevalid->nVersion == vRecv.GetVersion()) {
+            ptx = prevalid->tx;
+        } else {
+            prevalid = nullptr;
+            vRecv >> ptx;
+        }
         const CTransaction& tx = *ptx;
 
         CInv inv(MSG_TX, tx.GetHash());
@@ -2259,8 +2568,18 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         std::list<CTransactionRef> lRemovedTxn;
 
-        if (!AlreadyHave(inv) &&
-            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+        bool fAlreadyHave = AlreadyHave(inv);
+
+        // Votes are pushed without inventory, but an honest peer sends each vote about once
+        CValidationStakeState stakestate;
+        if (!fAlreadyHave && (prevalid ? prevalid->fVote : IsSSGen(tx, stakestate)) && !CountReceivedVote(pfrom->GetId(), tx)) {
+            LogPrint(BCLog::NET, "ignoring vote %s, too many votes on its block from peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
+            return true;
+        }
+        if (!fAlreadyHave && prevalid)
+            state = prevalid->state;
+        if (!fAlreadyHave && state.IsValid() &&
+            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */, false /* rawTx */, prevalid != nullptr)) {
             mempool.check(pcoinsTip.get());
             RelayTransaction(tx, connman);
             for (unsigned int i = 0; i < tx.vout.size(); i++) {
@@ -2593,7 +2912,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         } // cs_main
 
         if (fProcessBLOCKTXN)
-            return ProcessMessage(pfrom, NetMsgType::BLOCKTXN, blockTxnMsg, nTimeReceived, chainparams, connman, interruptMsgProc);
+            return ProcessMessage(pfrom, NetMsgType::BLOCKTXN, blockTxnMsg, nTimeReceived, chainparams, connman, interruptMsgProc, nullptr, pworkers);
 
         if (fRevertToHeaderProcessing) {
             // Headers received from HB compact block peers are permitted to be
@@ -2743,8 +3062,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
-        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> *pblock;
+        std::shared_ptr<CBlock> pblock;
+        // Decoded and checked by the message workers, which took the payload of the message
+        const CBlockPreValidation* prevalid = static_cast<const CBlockPreValidation*>(task);
+        if (prevalid) {
+            if (prevalid->decodeError)
+                std::rethrow_exception(prevalid->decodeError);
+            pblock = prevalid->pblock;
+        } else {
+            pblock = std::make_shared<CBlock>();
+            vRecv >> *pblock;
+        }
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
@@ -3010,6 +3338,94 @@ static bool SendRejectsAndCheckIfBanned(CNode* pnode, CConnman* connman)
     return false;
 }
 
+void PeerLogicValidation::ReceivedMessage(CNode* pnode, CNetMessage& msg)
+{
+    if (fMsgWorkers && msg.hdr.GetCommand() == NetMsgType::BLOCK && !fImporting && !fReindex && pnode->fSuccessfullyConnected) {
+        // Blocks from all peers are checked as they arrive, in any order, and
+        // ProcessNewBlock only does the contextual checks. The receive version of
+        // the peer does not change once it is connected.
+        std::shared_ptr<CBlockPreValidation> task = std::make_shared<CBlockPreValidation>(std::move(msg.vRecv), pnode->GetRecvVersion());
+        msg.vRecv.clear();
+        msg.task = task;
+        CConnman* connmanIn = connman;
+        msgWorkers.schedule([task, connmanIn] {
+            task->Run();
+            connmanIn->WakeMessageHandler();
+        });
+        return;
+    }
+
+    if ((!fMsgWorkers && !nTxPreCheckThreads) || msg.hdr.GetCommand() != NetMsgType::TX)
+        return;
+    // Same condition as ProcessMessage, the transactions we would drop are not worth checking
+    if (!fRelayTxes && (!pnode->fWhitelisted || !gArgs.GetBoolArg("-whitelistrelay", DEFAULT_WHITELISTRELAY)))
+        return;
+
+    if (fMsgWorkers) {
+        // The message is processed once the workers are done, which also queue the pre-verification
+        std::shared_ptr<CTxPreValidation> task = std::make_shared<CTxPreValidation>(msg.vRecv, pnode->GetRecvVersion());
+        msg.task = task;
+        CConnman* connmanIn = connman;
+        msgWorkers.schedule([task, connmanIn] {
+            task->Run();
+            connmanIn->WakeMessageHandler();
+        });
+        return;
+    }
+
+    CDataStream vRecv(msg.vRecv);
+    CTransactionRef ptx;
+    try {
+        vRecv >> ptx;
+    } catch (const std::exception&) {
+        // Reported by ProcessMessage
+        return;
+    }
+    QueueTxPreCheck(ptx);
+}
+
+void CTimeHistogram::Add(int64_t nMicros)
+{
+    // The wait is measured with the system clock, which may go back
+    nMicros = std::max<int64_t>(nMicros, 0);
+    int i = 0;
+    while (i < BUCKETS - 1 && nMicros >= ((int64_t)1 << i))
+        i++;
+    vBuckets[i]++;
+    nCount++;
+    nTotal += nMicros;
+    nMax = std::max(nMax, nMicros);
+}
+
+static void RecordMsgTime(CNode* pfrom, const std::string& strCommand, int64_t nWait, int64_t nProcess, int64_t nCsMain)
+{
+    pfrom->RecordMessageTime(strCommand, nWait, nProcess, nCsMain);
+
+    LOCK(cs_msg_time_stats);
+    if (mapMsgTimeStats.empty()) {
+        for (const std::string& msg : getAllNetMessageTypes())
+            mapMsgTimeStats[msg];
+        mapMsgTimeStats[NET_MESSAGE_COMMAND_OTHER];
+    }
+    auto it = mapMsgTimeStats.find(strCommand);
+    if (it == mapMsgTimeStats.end())
+        it = mapMsgTimeStats.find(NET_MESSAGE_COMMAND_OTHER);
+    it->second.wait.Add(nWait);
+    it->second.process.Add(nProcess);
+    it->second.csMain.Add(nCsMain);
+}
+
+std::map<std::string, CMsgTimeStats> GetMsgTimeStats()
+{
+    std::map<std::string, CMsgTimeStats> mapStats;
+    LOCK(cs_msg_time_stats);
+    for (const auto& entry : mapMsgTimeStats) {
+        if (entry.second.process.nCount)
+            mapStats.insert(entry);
+    }
+    return mapStats;
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -3023,8 +3439,13 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     //
     bool fMoreWork = false;
 
+    // A block is being sent by the message workers, which wake us up once done
+    if (pfrom->fGetDataPending)
+        return false;
+
+    CScheduler* pworkers = fMsgWorkers ? &msgWorkers : nullptr;
     if (!pfrom->vRecvGetData.empty())
-        ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
+        ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc, pworkers);
 
     if (pfrom->fDisconnect)
         return false;
@@ -3041,9 +3462,13 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // Wait for the work started on the message by ReceivedMessage(), the other peers are served meanwhile
+        const std::shared_ptr<CNetMessageTask>& task = pfrom->vProcessMsg.front().task;
+        if (task && !task->IsDone())
+            return false;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
-        pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+        pfrom->nProcessQueueSize -= msgs.front().hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
         pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
@@ -3083,9 +3508,11 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
 
     // Process message
     bool fRet = false;
+    const int64_t nTimeStart = GetTimeMicros();
+    const int64_t nCsMainStart = GetTimedLocksHeldMicros();
     try
     {
-        fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc);
+        fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, msg.task.get(), pworkers);
         if (interruptMsgProc)
             return false;
         if (!pfrom->vRecvGetData.empty())
@@ -3120,6 +3547,8 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         PrintExceptionContinue(nullptr, "ProcessMessages()");
     }
 
+    RecordMsgTime(pfrom, strCommand, nTimeStart - msg.nTime, GetTimeMicros() - nTimeStart, GetTimedLocksHeldMicros() - nCsMainStart);
+
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
     }
@@ -3474,9 +3903,12 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
                     {
                         LOCK(cs_most_recent_block);
                         if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
-                            if (state.fWantsCmpctWitness || !fWitnessesPresentInMostRecentCompactBlock)
-                                connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *most_recent_compact_block));
-                            else {
+                            if (state.fWantsCmpctWitness || !fWitnessesPresentInMostRecentCompactBlock) {
+                                if (CanShareCompactBlock(pto))
+                                    connman->PushMessage(pto, most_recent_compact_block_msg);
+                                else
+                                    connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *most_recent_compact_block));
+                            } else {
                                 CBlockHeaderAndShortTxIDs cmpctblock(*most_recent_block, state.fWantsCmpctWitness);
                                 connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                             }
@@ -3553,6 +3985,30 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
             }
             pto->vInventoryBlockToSend.clear();
 
+            // Push the votes on the tip as transactions right away, the producer of the next block needs them
+            if (!pto->vInventoryVoteToSend.empty()) {
+                UpdateVoteTip(&state);
+                const std::vector<uint256> winners = GetTipWinners();
+                int nSendFlags = state.fHaveWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
+                LOCK(pto->cs_filter);
+                for (const uint256& hash : pto->vInventoryVoteToSend) {
+                    if (pto->filterInventoryKnown.contains(hash))
+                        continue;
+                    CTransactionRef tx = mempool.get(hash);
+                    if (!tx)
+                        continue;
+                    // Other transactions, extra votes and filtering peers go through the trickled inventory
+                    if (!pto->fRelayTxes || pto->pfilter || state.nVotesSent >= winners.size() || !IsWinnerVote(*tx, winners)) {
+                        pto->setInventoryTxToSend.insert(hash);
+                        continue;
+                    }
+                    pto->filterInventoryKnown.insert(hash);
+                    connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::TX, *tx));
+                    state.nVotesSent++;
+                }
+                pto->vInventoryVoteToSend.clear();
+            }
+
             // Check whether periodic sends should happen
             bool fSendTrickle = pto->fWhitelisted;
             if (pto->nNextInvSend < nNow) {
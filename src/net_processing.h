@@ -7,6 +7,7 @@
 #define BITCOIN_NET_PROCESSING_H
 
 #include <net.h>
+#include <scheduler.h>
 #include <validationinterface.h>
 #include <consensus/params.h>
 #include <consensus/consensus.h>
@@ -21,6 +22,16 @@ static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
 /** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
+/** Votes on a block a peer may send us, per winner of the block */
+static const unsigned int MAX_VOTES_PER_WINNER = 2;
+/** Blocks voted on at a time whose votes from a peer are counted */
+static const unsigned int MAX_VOTED_BLOCKS_PER_PEER = 8;
+/** Maximum number of message worker threads allowed */
+static const int MAX_MSG_WORKER_THREADS = 16;
+/** -msgworkerthreads default (number of threads serving block requests, checking received blocks and decoding relayed transactions, 0 = disabled) */
+static const int DEFAULT_MSG_WORKER_THREADS = 2;
+/** -blockservecache default, size in MiB of the cache of blocks recently served to peers */
+static const int64_t DEFAULT_BLOCK_SERVE_CACHE = 64;
 /** Default maximum orphan blocks */
 static const unsigned int DEFAULT_MAX_ORPHAN_BLOCKS = 40;
 /** Headers download timeout expressed in microseconds
@@ -53,7 +64,9 @@ private:
     CConnman* const connman;
 
 public:
-    explicit PeerLogicValidation(CConnman* connman, CScheduler &scheduler);
+    /** nWorkerThreads threads serve block requests and decode relayed transactions off the message handler thread */
+    PeerLogicValidation(CConnman* connman, CScheduler &scheduler, int nWorkerThreads = 0);
+    ~PeerLogicValidation();
 
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
@@ -73,6 +86,10 @@ public:
     * @return                      True if there is more work to be done
     */
     bool SendMessages(CNode* pto, std::atomic<bool>& interrupt) override;
+    /** Hand received blocks and relayed transactions to the message workers and the script pre-verification as soon as they are received */
+    void ReceivedMessage(CNode* pnode, CNetMessage& msg) override;
+    /** Stop the message worker threads, the work still queued is dropped. Must be called before the connection manager is stopped. */
+    void StopWorkers();
 
     void ConsiderEviction(CNode *pto, int64_t time_in_seconds);
     void CheckForStaleTipAndEvictPeers(const Consensus::Params &consensusParams);
@@ -80,6 +97,36 @@ public:
 
 private:
     int64_t m_stale_tip_check_time; //! Next time to check for stale tip
+
+    /** Serves block requests and decodes relayed transactions off the message handler thread, see -msgworkerthreads */
+    CScheduler msgWorkers;
+    boost::thread_group msgWorkerThreads;
+    /** Whether the message worker threads are running */
+    std::atomic_bool fMsgWorkers;
+};
+
+/** Distribution of durations in microseconds, in power of two buckets */
+class CTimeHistogram
+{
+public:
+    /** Bucket 0 counts durations under 1us, bucket i > 0 those from 2^(i-1)us to under 2^i, the last one all longer ones */
+    static const int BUCKETS = 24;
+
+    CTimeHistogram() : nCount(0), nTotal(0), nMax(0), vBuckets() {}
+
+    void Add(int64_t nMicros);
+
+    uint64_t nCount;
+    int64_t nTotal;
+    int64_t nMax;
+    uint64_t vBuckets[BUCKETS];
+};
+
+/** Time spent on the received messages of one command, see CMsgCmdTime */
+struct CMsgTimeStats {
+    CTimeHistogram wait;
+    CTimeHistogram process;
+    CTimeHistogram csMain;
 };
 
 struct CNodeStateStats {
@@ -93,6 +140,10 @@ struct CNodeStateStats {
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
+/** Time spent on the received messages of each command since startup, commands without messages are left out */
+std::map<std::string, CMsgTimeStats> GetMsgTimeStats();
+/** Set the size of the cache of blocks recently served to peers, in bytes */
+void SetBlockServeCacheSize(size_t nBytes);
 /** Process network block received from a given node */
 bool ProcessNetBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock, CNode* pfrom, CConnman& connman);
 
@@ -194,6 +194,7 @@ public:
 
     // memory only
     mutable bool fChecked;
+    mutable bool fCheckedContextFree;
 
     CBlock()
     {
@@ -223,6 +224,7 @@ public:
         vtx.clear();
         svtx.clear();
         fChecked = false;
+        fCheckedContextFree = false;
     }
 
     std::pair<COutPoint, unsigned int> GetProofOfStake() const //qtum
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sstream>
 #include <util.h>
 #include <validation.h>
@@ -73,8 +74,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
                     e.revert();
                     throw Exception();
                 }
-                std::unordered_map<dev::Address, Vin> vins = ctx.createVin(*tx);
-                updateUTXO(vins);
+                updateUTXO(ctx.createVin(*tx));
             } else {
                 printfErrorLog(res.excepted);
             }
@@ -254,7 +254,7 @@ void QtumState::deleteAccounts(std::set<dev::Address>& addrs){
     }
 }
 
-void QtumState::updateUTXO(const std::unordered_map<dev::Address, Vin>& vins){
+void QtumState::updateUTXO(const std::vector<std::pair<dev::Address, Vin>>& vins){
     for(auto& v : vins){
         Vin* vi = const_cast<Vin*>(vin(v.first));
 
@@ -277,6 +277,7 @@ void QtumState::printfErrorLog(const dev::eth::TransactionException er){
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 CTransaction CondensingTX::createCondensingTX(){
+    collectAddresses();
     selectionVin();
     calculatePlusAndMinus();
     if(!createNewBalances())
@@ -287,74 +288,101 @@ CTransaction CondensingTX::createCondensingTX(){
     return !tx.vin.size() || !tx.vout.size() ? CTransaction() : CTransaction(tx);
 }
 
-std::unordered_map<dev::Address, Vin> CondensingTX::createVin(const CTransaction& tx){
-    std::unordered_map<dev::Address, Vin> vins;
-    for(auto& b : balances){
-        if(b.first == transaction.sender())
+std::vector<std::pair<dev::Address, Vin>> CondensingTX::createVin(const CTransaction& tx){
+    std::vector<std::pair<dev::Address, Vin>> vins;
+    vins.reserve(nBalances);
+    dev::h256 hashTx = uintToh256(tx.GetHash());
+    for(size_t i = 0; i < nBalances; i++){
+        const CondensingInfo& in = infos[i];
+        if(in.address == transaction.sender())
             continue;
 
-        if(b.second > 0){
-            vins[b.first] = Vin{uintToh256(tx.GetHash()), nVouts[b.first], b.second, 1};
+        if(in.balance > 0){
+            vins.emplace_back(in.address, Vin{hashTx, in.nVout, in.balance, 1});
         } else {
-            vins[b.first] = Vin{uintToh256(tx.GetHash()), 0, 0, 0};
+            vins.emplace_back(in.address, Vin{hashTx, 0, 0, 0});
         }
     }
     return vins;
 }
 
+void CondensingTX::collectAddresses(){
+    infos.clear();
+    infos.reserve(transfers.size() * 2);
+    for(const TransferInfo& ti : transfers){
+        infos.push_back(CondensingInfo{ti.from, Vin{}, false, false, false, 0, 0, 0, 0});
+        infos.push_back(CondensingInfo{ti.to, Vin{}, false, false, false, 0, 0, 0, 0});
+    }
+    std::sort(infos.begin(), infos.end(), [](const CondensingInfo& a, const CondensingInfo& b){ return a.address < b.address; });
+    infos.erase(std::unique(infos.begin(), infos.end(), [](const CondensingInfo& a, const CondensingInfo& b){ return a.address == b.address; }), infos.end());
+    for(CondensingInfo& in : infos)
+        in.deleted = deleteAddresses.count(in.address) != 0;
+    nBalances = 0;
+}
+
+CondensingInfo& CondensingTX::info(const dev::Address& addr){
+    auto it = std::lower_bound(infos.begin(), infos.end(), addr, [](const CondensingInfo& in, const dev::Address& a){ return in.address < a; });
+    assert(it != infos.end() && it->address == addr);
+    return *it;
+}
+
+void CondensingTX::lookupVin(CondensingInfo& in){
+    if(in.lookedUp)
+        return;
+    in.lookedUp = true;
+    if(auto a = state->vin(in.address)){
+        in.vin = *a;
+        in.hasVin = true;
+    }
+}
+
 void CondensingTX::selectionVin(){
     for(const TransferInfo& ti : transfers){
-        if(!vins.count(ti.from)){
-            if(auto a = state->vin(ti.from))
-                vins[ti.from] = *a;
+        CondensingInfo& from = info(ti.from);
+        if(!from.hasVin){
+            lookupVin(from);
             if(ti.from == transaction.sender() && transaction.value() > 0){
-                vins[ti.from] = Vin{transaction.getHashWith(), transaction.getNVout(), transaction.value(), 1};
+                from.vin = Vin{transaction.getHashWith(), transaction.getNVout(), transaction.value(), 1};
+                from.hasVin = true;
             }
         }
 
-        if(!vins.count(ti.to)){
-            if(auto a = state->vin(ti.to))
-                vins[ti.to] = *a;
+        CondensingInfo& to = info(ti.to);
+        if(!to.hasVin){
+            lookupVin(to);
         }
     }
 }
 
 void CondensingTX::calculatePlusAndMinus(){
     for(const TransferInfo& ti : transfers){
-        if(!plusMinusInfo.count(ti.from)){
-            plusMinusInfo[ti.from] = std::make_pair(0, ti.value);
-        } else {
-            plusMinusInfo[ti.from] = std::make_pair(plusMinusInfo[ti.from].first, plusMinusInfo[ti.from].second + ti.value);
-        }
-
-        if(!plusMinusInfo.count(ti.to)){
-            plusMinusInfo[ti.to] = std::make_pair(ti.value, 0);
-        } else {
-            plusMinusInfo[ti.to] = std::make_pair(plusMinusInfo[ti.to].first + ti.value, plusMinusInfo[ti.to].second);
-        }
+        info(ti.from).minus += ti.value;
+        info(ti.to).plus += ti.value;
     }
 }
 
 bool CondensingTX::createNewBalances(){
-    for(auto& p : plusMinusInfo){
+    for(CondensingInfo& in : infos){
         dev::u256 balance = 0;
-        if((vins.count(p.first) && vins[p.first].alive) || (!vins[p.first].alive && !checkDeleteAddress(p.first))){
-            balance = vins[p.first].value;
+        if(in.vin.alive || !in.deleted){
+            balance = in.vin.value;
         }
-        balance += p.second.first;
-        if(balance < p.second.second)
+        balance += in.plus;
+        if(balance < in.minus)
             return false;
-        balance -= p.second.second;
-        balances[p.first] = balance;
+        balance -= in.minus;
+        in.balance = balance;
+        nBalances++;
     }
     return true;
 }
 
 std::vector<CTxIn> CondensingTX::createVins(){
     std::vector<CTxIn> ins;
-    for(auto& v : vins){
-        if((v.second.value > 0 && v.second.alive) || (v.second.value > 0 && !vins[v.first].alive && !checkDeleteAddress(v.first)))
-            ins.push_back(CTxIn(h256Touint(v.second.hash), v.second.nVout, CScript() << OP_SPEND));
+    ins.reserve(infos.size());
+    for(const CondensingInfo& in : infos){
+        if(in.vin.value > 0 && (in.vin.alive || !in.deleted))
+            ins.push_back(CTxIn(h256Touint(in.vin.hash), in.vin.nVout, CScript() << OP_SPEND));
     }
     return ins;
 }
@@ -362,18 +390,19 @@ std::vector<CTxIn> CondensingTX::createVins(){
 std::vector<CTxOut> CondensingTX::createVout(){
     size_t count = 0;
     std::vector<CTxOut> outs;
-    for(auto& b : balances){
-        if(b.second > 0){
+    outs.reserve(std::min(infos.size(), MAX_CONTRACT_VOUTS + 1));
+    for(CondensingInfo& in : infos){
+        if(in.balance > 0){
             CScript script;
-            auto* a = state->account(b.first);
+            auto* a = state->account(in.address);
             if(a && a->isAlive()){
                 //create a no-exec contract output
-                script = CScript() << valtype{0} << valtype{0} << valtype{0} << valtype{0} << b.first.asBytes() << OP_CALL;
+                script = CScript() << valtype{0} << valtype{0} << valtype{0} << valtype{0} << in.address.asBytes() << OP_CALL;
             } else {
-                script = CScript() << OP_DUP << OP_HASH160 << b.first.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG;
+                script = CScript() << OP_DUP << OP_HASH160 << in.address.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG;
             }
-            outs.push_back(CTxOut(CAmount(b.second), script));
-            nVouts[b.first] = count;
+            outs.push_back(CTxOut(CAmount(in.balance), script));
+            in.nVout = count;
             count++;
         }
         if(count > MAX_CONTRACT_VOUTS){
@@ -383,8 +412,4 @@ std::vector<CTxOut> CondensingTX::createVout(){
     }
     return outs;
 }
-
-bool CondensingTX::checkDeleteAddress(dev::Address addr){
-    return deleteAddresses.count(addr) != 0;
-}
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -29,6 +29,19 @@ struct Vin{
     uint8_t alive;
 };
 
+// Per address state of a CondensingTX, kept sorted by address
+struct CondensingInfo{
+    dev::Address address;
+    Vin vin;
+    bool hasVin;
+    bool lookedUp;
+    bool deleted;
+    dev::u256 plus;
+    dev::u256 minus;
+    dev::u256 balance;
+    uint32_t nVout;
+};
+
 struct ResultExecute{
     dev::eth::ExecutionResult execRes;
     dev::eth::TransactionReceipt txRec;
@@ -100,7 +113,7 @@ private:
 
     void deleteAccounts(std::set<dev::Address>& addrs);
 
-    void updateUTXO(const std::unordered_map<dev::Address, Vin>& vins);
+    void updateUTXO(const std::vector<std::pair<dev::Address, Vin>>& vins);
 
     void printfErrorLog(const dev::eth::TransactionException er);
 
@@ -113,6 +126,9 @@ private:
 	dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> stateUTXO;
 
 	std::unordered_map<dev::Address, Vin> cacheUTXO;
+
+    // Scratch space of CondensingTX, reused by all executions
+    std::vector<CondensingInfo> condensingInfo;
 };
 
 
@@ -143,22 +159,62 @@ struct TemporaryState{
     TemporaryState& operator=(TemporaryState&&) = delete;
 };
 
+// Keeps the accounts changed by contract executions in memory while in scope and
+// writes them to the state trie once when leaving it or on flush(). Nested scopes
+// leave the writing to the outermost one.
+struct AccountWriteBack{
+    std::unique_ptr<QtumState>& globalStateRef;
+    bool fOwner;
+
+    AccountWriteBack(std::unique_ptr<QtumState>& _globalStateRef) :
+        globalStateRef(_globalStateRef),
+        fOwner(!globalStateRef->writeBack())
+    {
+        if(fOwner)
+            globalStateRef->setWriteBack(true);
+    }
+
+    void flush()
+    {
+        if(fOwner){
+            globalStateRef->setWriteBack(false);
+            fOwner = false;
+        }
+    }
+
+    ~AccountWriteBack(){
+        if(fOwner)
+            globalStateRef->setWriteBack(false);
+    }
+    AccountWriteBack() = delete;
+    AccountWriteBack(const AccountWriteBack&) = delete;
+    AccountWriteBack& operator=(const AccountWriteBack&) = delete;
+    AccountWriteBack(AccountWriteBack&&) = delete;
+    AccountWriteBack& operator=(AccountWriteBack&&) = delete;
+};
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 class CondensingTX{
 
 public:
 
-    CondensingTX(QtumState* _state, const std::vector<TransferInfo>& _transfers, const QtumTransaction& _transaction, std::set<dev::Address> _deleteAddresses = std::set<dev::Address>()) : transfers(_transfers), deleteAddresses(_deleteAddresses), transaction(_transaction), state(_state){}
+    CondensingTX(QtumState* _state, const std::vector<TransferInfo>& _transfers, const QtumTransaction& _transaction, const std::set<dev::Address>& _deleteAddresses) : transfers(_transfers), deleteAddresses(_deleteAddresses), transaction(_transaction), state(_state), infos(_state->condensingInfo){}
 
     CTransaction createCondensingTX();
 
-    std::unordered_map<dev::Address, Vin> createVin(const CTransaction& tx);
+    std::vector<std::pair<dev::Address, Vin>> createVin(const CTransaction& tx);
 
     bool reachedVoutLimit(){ return voutOverflow; }
 
 private:
 
+    void collectAddresses();
+
+    CondensingInfo& info(const dev::Address& addr);
+
+    void lookupVin(CondensingInfo& in);
+
     void selectionVin();
 
     void calculatePlusAndMinus();
@@ -169,26 +225,22 @@ private:
 
     std::vector<CTxOut> createVout();
 
-    bool checkDeleteAddress(dev::Address addr);
-
-    std::map<dev::Address, plusAndMinus> plusMinusInfo;
-
-    std::map<dev::Address, dev::u256> balances;
-
-    std::map<dev::Address, uint32_t> nVouts;
-
-    std::map<dev::Address, Vin> vins;
-
     const std::vector<TransferInfo>& transfers;
 
     //We don't need the ordered nature of "set" here, but unordered_set's theoretical worst complexity is O(n), whereas set is O(log n)
     //So, making this unordered_set could be an attack vector
-    const std::set<dev::Address> deleteAddresses;
+    const std::set<dev::Address>& deleteAddresses;
 
     const QtumTransaction& transaction;
 
     QtumState* state;
 
+    //Every address taking part in a transfer, sorted once so that inputs and outputs come out in address order
+    std::vector<CondensingInfo>& infos;
+
+    //Number of leading infos that got a balance in createNewBalances
+    size_t nBalances = 0;
+
     bool voutOverflow = false;
 
 };
@@ -0,0 +1,87 @@
+#ifndef QTUM_RAWBLOCKCACHE_H
+#define QTUM_RAWBLOCKCACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * Least recently used cache of serialized blocks, bounded by the total size of
+ * the blocks. Peers in initial download request the same blocks at about the
+ * same time, so the blocks served to them are read from disk once.
+ */
+class CRawBlockCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<unsigned char>> RawBlock;
+
+    explicit CRawBlockCache(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn), nBytes(0) {}
+
+    /** The block with hash @a hash, null if it is not cached */
+    RawBlock Get(const uint256& hash)
+    {
+        LOCK(cs);
+        auto it = index.find(hash);
+        if (it == index.end())
+            return nullptr;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    /** Add a block, evicting the least recently used ones. Blocks larger than the cache are not added. */
+    void Insert(const uint256& hash, RawBlock block)
+    {
+        LOCK(cs);
+        if (!block || block->size() > nMaxBytes || index.count(hash))
+            return;
+        entries.emplace_front(hash, std::move(block));
+        index.emplace(hash, entries.begin());
+        nBytes += entries.front().second->size();
+        Trim();
+    }
+
+    void SetMaxBytes(size_t nMaxBytesIn)
+    {
+        LOCK(cs);
+        nMaxBytes = nMaxBytesIn;
+        Trim();
+    }
+
+    size_t Size() const
+    {
+        LOCK(cs);
+        return entries.size();
+    }
+
+    size_t Bytes() const
+    {
+        LOCK(cs);
+        return nBytes;
+    }
+
+private:
+    typedef std::list<std::pair<uint256, RawBlock>> EntryList;
+
+    void Trim()
+    {
+        AssertLockHeld(cs);
+        while (nBytes > nMaxBytes) {
+            nBytes -= entries.back().second->size();
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    mutable CCriticalSection cs;
+    /** Most recently used first */
+    EntryList entries;
+    std::map<uint256, EntryList::iterator> index;
+    size_t nMaxBytes;
+    size_t nBytes;
+};
+
+#endif // QTUM_RAWBLOCKCACHE_H
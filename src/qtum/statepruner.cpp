@@ -0,0 +1,262 @@
+#include <qtum/statepruner.h>
+
+#include <chain.h>
+#include <qtum/qtumstate.h>
+#include <txdb.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <libdevcore/RLP.h>
+#include <libdevcore/TrieCommon.h>
+#include <libdevcore/TrieDB.h>
+#include <libdevcore/TrieNodeCache.h>
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include <boost/thread.hpp>
+
+namespace {
+
+/**
+ * Prunes one of the contract state databases: marks the nodes reachable from
+ * the kept roots, collects the other nodes found on a snapshot of the database,
+ * and deletes the ones that are still unreachable.
+ */
+class StateDBPruner
+{
+public:
+    /** With fAccounts the leaves of the tries are accounts, whose storage trie and code are kept too */
+    StateDBPruner(const dev::OverlayDB& _db, bool _fAccounts) : db(_db), fAccounts(_fAccounts), nNext(0)
+    {
+        readOptions.fill_cache = false;
+        readOptions.snapshot = db.db()->GetSnapshot();
+        // Root of every new trie and of the storage of most accounts
+        setLive.insert(dev::EmptyTrie);
+    }
+
+    ~StateDBPruner()
+    {
+        ReleaseSnapshot();
+    }
+
+    /** Mark the trie at root and everything below it */
+    void Mark(const dev::h256& root)
+    {
+        MarkKey(root, fAccounts);
+    }
+
+    /** Collect the nodes of the snapshot that were not marked, then read the database itself */
+    void Sweep()
+    {
+        std::unique_ptr<leveldb::Iterator> pcursor(db.db()->NewIterator(readOptions));
+        for (pcursor->SeekToFirst(); pcursor->Valid() && vUnreachable.size() < STATE_PRUNE_MAX_NODES; pcursor->Next()) {
+            // Aux entries have a 33 byte key
+            leveldb::Slice key = pcursor->key();
+            if (key.size() != dev::h256::size)
+                continue;
+            dev::h256 hash((const uint8_t*)key.data(), dev::h256::ConstructFromPointer);
+            if (!setLive.count(hash))
+                vUnreachable.push_back(hash);
+            if (vUnreachable.size() % 10000 == 0)
+                boost::this_thread::interruption_point();
+        }
+        ReleaseSnapshot();
+    }
+
+    /** Delete up to nMax collected nodes that are still unreachable, cs_main must be held */
+    size_t DeleteBatch(size_t nMax)
+    {
+        AssertLockHeld(cs_main);
+        // Pending commits may still write nodes collected here
+        db.flushCommits();
+        leveldb::WriteBatch batch;
+        size_t nDeleted = 0;
+        for (; nNext < vUnreachable.size() && nDeleted < nMax; nNext++) {
+            const dev::h256& hash = vUnreachable[nNext];
+            if (setLive.count(hash))
+                continue;
+            batch.Delete(leveldb::Slice((const char*)hash.data(), hash.size));
+            dev::TrieNodeCache::instance().erase(hash);
+            nDeleted++;
+        }
+        leveldb::Status status = db.db()->Write(leveldb::WriteOptions(), &batch);
+        if (!status.ok())
+            throw std::runtime_error("Error pruning the contract state database: " + status.ToString());
+        return nDeleted;
+    }
+
+    bool Done() const { return nNext == vUnreachable.size(); }
+    size_t Live() const { return setLive.size(); }
+    size_t Unreachable() const { return vUnreachable.size(); }
+
+private:
+    void ReleaseSnapshot()
+    {
+        if (readOptions.snapshot) {
+            db.db()->ReleaseSnapshot(readOptions.snapshot);
+            readOptions.snapshot = nullptr;
+        }
+    }
+
+    /** Read a node from the snapshot, or from the database and its overlay once swept */
+    bool ReadNode(const dev::h256& hash, std::string& value) const
+    {
+        if (readOptions.snapshot)
+            db.db()->Get(readOptions, leveldb::Slice((const char*)hash.data(), hash.size), &value);
+        else
+            value = db.lookup(hash);
+        return !value.empty();
+    }
+
+    void MarkKey(const dev::h256& hash, bool fAccountTrie)
+    {
+        // Everything below a marked node is marked as well
+        if (!setLive.insert(hash).second)
+            return;
+        if (setLive.size() % 10000 == 0)
+            boost::this_thread::interruption_point();
+
+        std::string value;
+        if (!ReadNode(hash, value)) {
+            // Not written yet, the next mark will go down from it
+            setLive.erase(hash);
+            return;
+        }
+        MarkList(dev::RLP(value), fAccountTrie);
+    }
+
+    void MarkEntry(const dev::RLP& entry, bool fAccountTrie)
+    {
+        // Nodes shorter than 32 bytes are stored in their parent
+        if (entry.isData() && entry.size() == dev::h256::size)
+            MarkKey(entry.toHash<dev::h256>(), fAccountTrie);
+        else if (entry.isList())
+            MarkList(entry, fAccountTrie);
+    }
+
+    void MarkList(const dev::RLP& node, bool fAccountTrie)
+    {
+        if (node.isList() && node.itemCount() == 2) {
+            if (!dev::isLeaf(node))
+                MarkEntry(node[1], fAccountTrie);
+            else if (fAccountTrie)
+                MarkAccount(dev::RLP(node[1].payload()));
+        } else if (node.isList() && node.itemCount() == 17) {
+            for (unsigned i = 0; i < 16; i++)
+                if (!node[i].isEmpty())
+                    MarkEntry(node[i], fAccountTrie);
+            if (fAccountTrie && !node[16].isEmpty())
+                MarkAccount(dev::RLP(node[16].payload()));
+        }
+    }
+
+    /** Accounts are [nonce, balance, storage root, code hash] */
+    void MarkAccount(const dev::RLP& account)
+    {
+        if (!account.isList() || account.itemCount() < 4)
+            return;
+        MarkKey(account[2].toHash<dev::h256>(), false);
+        setLive.insert(account[3].toHash<dev::h256>());
+    }
+
+    const dev::OverlayDB& db;
+    const bool fAccounts;
+    leveldb::ReadOptions readOptions;
+    std::unordered_set<dev::h256> setLive;
+    std::vector<dev::h256> vUnreachable;
+    size_t nNext;
+};
+
+/** State and UTXO roots of the blocks whose contract state is kept */
+std::vector<std::pair<dev::h256, dev::h256>> GetKeptRoots()
+{
+    AssertLockHeld(cs_main);
+    std::vector<std::pair<dev::h256, dev::h256>> vRoots;
+    // The contract state is written every block but the coins only on a full flush,
+    // so after a crash the node starts again from the block of the flushed coins
+    const CBlockIndex* pindexFlushed = nullptr;
+    BlockMap::const_iterator mi = mapBlockIndex.find(pcoinsdbview->GetBestBlock());
+    if (mi != mapBlockIndex.end())
+        pindexFlushed = mi->second;
+    int nMinHeight = chainActive.Height();
+    if (pindexFlushed)
+        nMinHeight = std::min(nMinHeight, pindexFlushed->nHeight);
+    nMinHeight -= (int)nStatePruneDepth;
+    for (const CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->nHeight > nMinHeight; pindex = pindex->pprev)
+        vRoots.emplace_back(uintToh256(pindex->hashStateRoot), uintToh256(pindex->hashUTXORoot));
+    // and disconnects the blocks of the flushed coins that left the active chain since
+    for (const CBlockIndex* pindex = pindexFlushed; pindex && pindex->nHeight > nMinHeight && !chainActive.Contains(pindex); pindex = pindex->pprev)
+        vRoots.emplace_back(uintToh256(pindex->hashStateRoot), uintToh256(pindex->hashUTXORoot));
+    vRoots.emplace_back(globalState->rootHash(), globalState->rootHashUTXO());
+    return vRoots;
+}
+
+} // namespace
+
+size_t PruneState()
+{
+    std::vector<std::pair<dev::h256, dev::h256>> vRoots;
+    std::unique_ptr<StateDBPruner> pstate;
+    std::unique_ptr<StateDBPruner> putxo;
+    {
+        LOCK(cs_main);
+        if (!globalState || !nStatePruneDepth)
+            return 0;
+        vRoots = GetKeptRoots();
+        pstate.reset(new StateDBPruner(globalState->db(), true));
+        putxo.reset(new StateDBPruner(globalState->dbUtxo(), false));
+    }
+
+    int64_t nTimeStart = GetTimeMillis();
+    for (const auto& roots : vRoots) {
+        pstate->Mark(roots.first);
+        putxo->Mark(roots.second);
+    }
+    pstate->Sweep();
+    putxo->Sweep();
+    LogPrint(BCLog::PRUNE, "Prune: %u live and %u unreachable contract state nodes, %u live and %u unreachable UTXO state nodes (%dms)\n",
+        pstate->Live(), pstate->Unreachable(), putxo->Live(), putxo->Unreachable(), GetTimeMillis() - nTimeStart);
+
+    size_t nDeleted = 0;
+    while (!pstate->Done() || !putxo->Done()) {
+        boost::this_thread::interruption_point();
+        LOCK(cs_main);
+        if (!fHavePrunedState) {
+            fHavePrunedState = true;
+            pblocktree->WriteFlag("prunedstate", true);
+        }
+        // Blocks connected since the snapshot may have written unreachable nodes again
+        for (const auto& roots : GetKeptRoots()) {
+            pstate->Mark(roots.first);
+            putxo->Mark(roots.second);
+        }
+        nDeleted += pstate->DeleteBatch(STATE_PRUNE_BATCH_SIZE);
+        nDeleted += putxo->DeleteBatch(STATE_PRUNE_BATCH_SIZE);
+    }
+
+    LogPrintf("Prune: deleted %u contract state nodes not used by the last %u blocks (%dms)\n", nDeleted, nStatePruneDepth, GetTimeMillis() - nTimeStart);
+    return nDeleted;
+}
+
+void ThreadStatePrune()
+{
+    int nLastHeight = -1;
+    while (true) {
+        MilliSleep(10000);
+
+        int nHeight;
+        {
+            LOCK(cs_main);
+            nHeight = chainActive.Height();
+        }
+        if (nHeight <= (int)nStatePruneDepth || (nLastHeight >= 0 && nHeight < nLastHeight + STATE_PRUNE_INTERVAL))
+            continue;
+
+        PruneState();
+        nLastHeight = nHeight;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef QTUM_STATEPRUNER_H
+#define QTUM_STATEPRUNER_H
+
+#include <stddef.h>
+
+/** Blocks the tip has to move before the next pruning pass of the contract state */
+static const int STATE_PRUNE_INTERVAL = 1000;
+/** Maximum number of unreachable nodes collected per database and pass, the rest waits for the next pass */
+static const size_t STATE_PRUNE_MAX_NODES = 1000000;
+/** Number of nodes deleted per database while holding cs_main */
+static const size_t STATE_PRUNE_BATCH_SIZE = 10000;
+
+/**
+ * Delete the trie nodes of the contract state and UTXO state databases that
+ * cannot be reached from the roots of the last nStatePruneDepth blocks. The
+ * blocks are counted from the tip or from the best block of the coins database,
+ * whichever is lower, so the node can restart from the coins last flushed.
+ *
+ * The reachable nodes are marked and the databases swept on a snapshot without
+ * holding cs_main. The unreachable nodes are then deleted in batches under
+ * cs_main, after marking the roots of the blocks connected in the meantime, so
+ * nodes that were written again by them are kept.
+ *
+ * @return the number of nodes deleted
+ */
+size_t PruneState();
+
+/** Run PruneState() every STATE_PRUNE_INTERVAL blocks, started when -prunestate is set */
+void ThreadStatePrune();
+
+#endif // QTUM_STATEPRUNER_H
@@ -1,5 +1,7 @@
 #include <qtum/storageresults.h>
 
+#include <leveldb/write_batch.h>
+
 StorageResults::StorageResults(std::string const& _path){
 	path = _path + "/resultsDB";
     options.create_if_missing = true;
@@ -10,6 +12,8 @@ StorageResults::StorageResults(std::string const& _path){
 
 StorageResults::~StorageResults()
 {
+    // Drains the pending writes before the database goes away
+    writer.reset();
     delete db;
     db = NULL;
 }
@@ -22,12 +26,32 @@ void StorageResults::clearCacheResult(){
     m_cache_result.clear();
 }
 
+void StorageResults::enableAsyncCommit(){
+    if(!writer)
+        writer.reset(new dev::AsyncWriteQueue("results-writer"));
+}
+
+void StorageResults::flushResults(bool fSync){
+    if(writer)
+        writer->wait();
+    if(fSync){
+        leveldb::WriteOptions syncOptions;
+        syncOptions.sync = true;
+        leveldb::WriteBatch batch;
+        leveldb::Status status = db->Write(syncOptions, &batch);
+        assert(status.ok());
+    }
+}
+
 void StorageResults::wipeResults(){
+    flushResults();
     LogPrintf("Wiping LevelDB in %s\n", path);
     leveldb::Status result = leveldb::DestroyDB(path, leveldb::Options());
 }
 
 void StorageResults::deleteResults(std::vector<CTransactionRef> const& txs){
+    // A pending write would bring the results back after the delete
+    flushResults();
 
     for(CTransactionRef tx : txs){
         dev::h256 hashTx = uintToh256(tx->GetHash());
@@ -44,7 +68,7 @@ std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const& h
     std::vector<TransactionReceiptInfo> result;
 	auto it = m_cache_result.find(hashTx);
 	if (it == m_cache_result.end()){
-		if(readResult(hashTx, result))
+		if(findPending(hashTx, result) || readResult(hashTx, result))
 			m_cache_result.insert(std::make_pair(hashTx, result));
     } else {
 		result = it->second;
@@ -54,46 +78,74 @@ std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const& h
 
 void StorageResults::commitResults(){
     if(m_cache_result.size()){
-
-        for (auto const& i: m_cache_result){
-            std::string valueTemp;
-            std::string keyTemp = i.first.hex();
-            leveldb::Slice key(keyTemp);
-            leveldb::Status status = db->Get(leveldb::ReadOptions(), key, &valueTemp);
-
-            if(status.IsNotFound()){
-
-                TransactionReceiptInfoSerialized tris;
-
-                for(size_t j = 0; j < i.second.size(); j++){
-                    tris.blockHashes.push_back(uintToh256(i.second[j].blockHash));
-                    tris.blockNumbers.push_back(i.second[j].blockNumber);
-                    tris.transactionHashes.push_back(uintToh256(i.second[j].transactionHash));
-                    tris.transactionIndexes.push_back(i.second[j].transactionIndex);
-                    tris.senders.push_back(i.second[j].from);
-                    tris.receivers.push_back(i.second[j].to);
-                    tris.cumulativeGasUsed.push_back(dev::u256(i.second[j].cumulativeGasUsed));
-                    tris.gasUsed.push_back(dev::u256(i.second[j].gasUsed));
-                    tris.contractAddresses.push_back(i.second[j].contractAddress);
-                    tris.logs.push_back(logEntriesSerialization(i.second[j].logs));
-                    tris.excepted.push_back(uint32_t(static_cast<int>(i.second[j].excepted)));
-                }
-
-                dev::RLPStream streamRLP(11);
-                streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes << tris.senders;
-                streamRLP << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses << tris.logs << tris.excepted;
-
-                dev::bytes data = streamRLP.out();
-                std::string stringData(data.begin(), data.end());
-                leveldb::Slice value(stringData);
-                status = db->Put(leveldb::WriteOptions(), key, value);
-                assert(status.ok());
+        if(writer){
+            std::shared_ptr<const ResultsMap> results = std::make_shared<const ResultsMap>(std::move(m_cache_result));
+            {
+                LOCK(cs_pending);
+                m_pending_results.push_back(results);
             }
+            writer->enqueue([this, results](){
+                writeResults(*results);
+                LOCK(cs_pending);
+                m_pending_results.pop_front();
+            });
+        } else {
+            writeResults(m_cache_result);
         }
         m_cache_result.clear();
     }
 }
 
+void StorageResults::writeResults(ResultsMap const& results){
+    leveldb::WriteBatch batch;
+    for (auto const& i: results){
+        std::string valueTemp;
+        std::string keyTemp = i.first.hex();
+        leveldb::Slice key(keyTemp);
+        leveldb::Status status = db->Get(leveldb::ReadOptions(), key, &valueTemp);
+
+        if(status.IsNotFound()){
+
+            TransactionReceiptInfoSerialized tris;
+
+            for(size_t j = 0; j < i.second.size(); j++){
+                tris.blockHashes.push_back(uintToh256(i.second[j].blockHash));
+                tris.blockNumbers.push_back(i.second[j].blockNumber);
+                tris.transactionHashes.push_back(uintToh256(i.second[j].transactionHash));
+                tris.transactionIndexes.push_back(i.second[j].transactionIndex);
+                tris.senders.push_back(i.second[j].from);
+                tris.receivers.push_back(i.second[j].to);
+                tris.cumulativeGasUsed.push_back(dev::u256(i.second[j].cumulativeGasUsed));
+                tris.gasUsed.push_back(dev::u256(i.second[j].gasUsed));
+                tris.contractAddresses.push_back(i.second[j].contractAddress);
+                tris.logs.push_back(logEntriesSerialization(i.second[j].logs));
+                tris.excepted.push_back(uint32_t(static_cast<int>(i.second[j].excepted)));
+            }
+
+            dev::RLPStream streamRLP(11);
+            streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes << tris.senders;
+            streamRLP << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses << tris.logs << tris.excepted;
+
+            dev::bytes data = streamRLP.out();
+            batch.Put(key, leveldb::Slice((const char*)data.data(), data.size()));
+        }
+    }
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+    assert(status.ok());
+}
+
+bool StorageResults::findPending(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result){
+    LOCK(cs_pending);
+    for(auto it = m_pending_results.rbegin(); it != m_pending_results.rend(); ++it){
+        auto found = (*it)->find(_key);
+        if(found != (*it)->end()){
+            _result = found->second;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool StorageResults::readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result){
 
     std::string value;
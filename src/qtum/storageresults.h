@@ -3,6 +3,11 @@
 #include <libethereum/State.h>
 #include <libethereum/Transaction.h>
 #include <util.h>
+#include <sync.h>
+#include <libdevcore/AsyncWriteQueue.h>
+
+#include <deque>
+#include <memory>
 
 using logEntriesSerializ = std::vector<std::pair<dev::Address, std::pair<dev::h256s, dev::bytes>>>;
 
@@ -53,8 +58,20 @@ public:
 
     void wipeResults();
 
+    /** Hand the commits to a background writer, the committed results stay readable until written */
+    void enableAsyncCommit();
+
+    /** Wait until the committed results are written, with fSync make them durable. Throws std::runtime_error if a write failed */
+    void flushResults(bool fSync = false);
+
 private:
 
+    typedef std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> ResultsMap;
+
+    void writeResults(ResultsMap const& results);
+
+    bool findPending(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result);
+
 	bool readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result);
 
 	logEntriesSerializ logEntriesSerialization(dev::eth::LogEntries const& _logs);
@@ -67,5 +84,11 @@ private:
 
     leveldb::Options options;
 
-	std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_cache_result;
+	ResultsMap m_cache_result;
+
+    CCriticalSection cs_pending;
+
+    std::deque<std::shared_ptr<const ResultsMap>> m_pending_results;
+
+    std::unique_ptr<dev::AsyncWriteQueue> writer;
 };
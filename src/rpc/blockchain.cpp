@@ -850,6 +850,9 @@ UniValue getstorage(const JSONRPCRequest& request)
             if((blockNum < 0 && blockNum != -1) || blockNum > chainActive.Height())
                 throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
 
+            if(fHavePrunedState && blockNum != -1 && blockNum <= chainActive.Height() - (int)nStatePruneDepth)
+                throw JSONRPCError(RPC_MISC_ERROR, "State not available (pruned data)");
+
             if(blockNum != -1)
                 ts.SetRoot(uintToh256(chainActive[blockNum]->hashStateRoot), uintToh256(chainActive[blockNum]->hashUTXORoot));
                 
@@ -33,6 +33,8 @@
 
 #include <univalue.h>
 
+#include <libdevcore/TrieNodeCache.h>
+
 #ifdef ENABLE_WALLET
 class DescribeAddressVisitor : public boost::static_visitor<UniValue>
 {
@@ -445,6 +447,41 @@ UniValue setmocktime(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue RPCStateDBMemoryInfo()
+{
+    const dev::eth::StateDBOptions& options = dev::eth::State::dbOptions();
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("cache_used", uint64_t(dev::eth::State::dbCacheUsage())));
+    obj.push_back(Pair("cache_size", uint64_t(options.cacheSize)));
+    obj.push_back(Pair("bloom_bits", options.bloomBits));
+    obj.push_back(Pair("write_buffer_size", uint64_t(options.writeBufferSize)));
+    obj.push_back(Pair("commit_threads", (int)options.commitThreads));
+    dev::TrieNodeCache::Stats nodeStats = dev::TrieNodeCache::instance().stats();
+    UniValue nodes(UniValue::VOBJ);
+    nodes.push_back(Pair("hits", nodeStats.hits));
+    nodes.push_back(Pair("misses", nodeStats.misses));
+    nodes.push_back(Pair("entries", uint64_t(nodeStats.entries)));
+    nodes.push_back(Pair("used", uint64_t(nodeStats.usage)));
+    nodes.push_back(Pair("size", uint64_t(nodeStats.maxSize)));
+    obj.push_back(Pair("trie_node_cache", nodes));
+    std::shared_ptr<dev::eth::StateSnapshot> snapshot;
+    {
+        LOCK(cs_main);
+        if (globalState)
+            snapshot = globalState->snapshot();
+    }
+    if (snapshot) {
+        dev::eth::StateSnapshot::Stats snapshotStats = snapshot->stats();
+        UniValue snap(UniValue::VOBJ);
+        snap.push_back(Pair("root", snapshotStats.diskRoot.hex()));
+        snap.push_back(Pair("layers", uint64_t(snapshotStats.layers)));
+        snap.push_back(Pair("hits", snapshotStats.hits));
+        snap.push_back(Pair("misses", snapshotStats.misses));
+        obj.push_back(Pair("snapshot", snap));
+    }
+    return obj;
+}
+
 static UniValue RPCLockedMemoryInfo()
 {
     LockedPool::Stats stats = LockedPoolManager::Instance().stats();
@@ -499,6 +536,26 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"statedb\": {              (json object) Information about the contract state databases\n"
+            "    \"cache_used\": xxxxx,    (numeric) Number of bytes used by the shared block cache\n"
+            "    \"cache_size\": xxxxx,    (numeric) Capacity of the shared block cache in bytes\n"
+            "    \"bloom_bits\": xx,       (numeric) Bits per key of the bloom filters, 0 if disabled\n"
+            "    \"write_buffer_size\": xxxxx, (numeric) Write buffer size of each database in bytes\n"
+            "    \"commit_threads\": n,    (numeric) Threads updating the storage tries of large commits\n"
+            "    \"trie_node_cache\": {     (json object) Cache of trie nodes shared by the databases\n"
+            "      \"hits\": xxxxx,        (numeric) Number of nodes found in the cache\n"
+            "      \"misses\": xxxxx,      (numeric) Number of nodes read from disk\n"
+            "      \"entries\": xxxxx,     (numeric) Number of nodes in the cache\n"
+            "      \"used\": xxxxx,        (numeric) Number of bytes used by the cache\n"
+            "      \"size\": xxxxx         (numeric) Capacity of the cache in bytes\n"
+            "    },\n"
+            "    \"snapshot\": {          (json object) Flat snapshot of the contract state, if -statesnapshot is set\n"
+            "      \"root\": \"hex\",        (string) State root of the snapshot on disk\n"
+            "      \"layers\": xxxxx,      (numeric) Number of diff layers kept in memory for the recent blocks\n"
+            "      \"hits\": xxxxx,        (numeric) Number of reads served by the snapshot\n"
+            "      \"misses\": xxxxx       (numeric) Number of reads at state roots the snapshot does not know\n"
+            "    }\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -512,6 +569,7 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.push_back(Pair("locked", RPCLockedMemoryInfo()));
+        obj.push_back(Pair("statedb", RPCStateDBMemoryInfo()));
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -12,6 +12,7 @@
 #include <net_processing.h>
 #include <netbase.h>
 #include <policy/policy.h>
+#include <rpc/net.h>
 #include <rpc/protocol.h>
 #include <sync.h>
 #include <timedata.h>
@@ -109,6 +110,15 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
+            "    },\n"
+            "    \"time_per_msg\": {         (json object) The time spent on the received messages, aggregated by message type\n"
+            "       \"addr\": {\n"
+            "         \"count\": n,           (numeric) The number of messages processed\n"
+            "         \"wait_us\": n,         (numeric) The total microseconds from their receipt to the start of their processing\n"
+            "         \"process_us\": n,      (numeric) The total microseconds spent processing them\n"
+            "         \"cs_main_us\": n       (numeric) The total microseconds cs_main was held for while processing them\n"
+            "       },\n"
+            "       ...\n"
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -184,6 +194,19 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.push_back(Pair("bytesrecv_per_msg", recvPerMsgCmd));
 
+        UniValue timePerMsgCmd(UniValue::VOBJ);
+        for (const mapMsgCmdTime::value_type &i : stats.mapRecvTimePerMsgCmd) {
+            if (i.second.nCount > 0) {
+                UniValue cmdTime(UniValue::VOBJ);
+                cmdTime.push_back(Pair("count", i.second.nCount));
+                cmdTime.push_back(Pair("wait_us", i.second.nWait));
+                cmdTime.push_back(Pair("process_us", i.second.nProcess));
+                cmdTime.push_back(Pair("cs_main_us", i.second.nCsMain));
+                timePerMsgCmd.push_back(Pair(i.first, cmdTime));
+            }
+        }
+        obj.push_back(Pair("time_per_msg", timePerMsgCmd));
+
         ret.push_back(obj);
     }
 
@@ -392,6 +415,63 @@ UniValue getnettotals(const JSONRPCRequest& request)
     return obj;
 }
 
+static UniValue timeHistogramToJSON(const CTimeHistogram& histogram)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("total_us", histogram.nTotal));
+    obj.push_back(Pair("max_us", histogram.nMax));
+    UniValue buckets(UniValue::VARR);
+    for (int i = 0; i < CTimeHistogram::BUCKETS; i++)
+        buckets.push_back(histogram.vBuckets[i]);
+    obj.push_back(Pair("histogram", buckets));
+    return obj;
+}
+
+UniValue msgTimeStatsToJSON()
+{
+    UniValue ret(UniValue::VOBJ);
+    for (const auto& entry : GetMsgTimeStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("count", entry.second.process.nCount));
+        obj.push_back(Pair("wait", timeHistogramToJSON(entry.second.wait)));
+        obj.push_back(Pair("process", timeHistogramToJSON(entry.second.process)));
+        obj.push_back(Pair("cs_main", timeHistogramToJSON(entry.second.csMain)));
+        ret.push_back(Pair(entry.first, obj));
+    }
+    return ret;
+}
+
+UniValue getmsgtimestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getmsgtimestats\n"
+            "\nReturns the distribution of the time spent on the messages received from all peers since startup,\n"
+            "by message type. Messages of unknown types are counted together under \"*other*\".\n"
+            "Bucket 0 of a histogram counts durations under 1 microsecond, bucket i > 0 those from 2^(i-1)\n"
+            "to under 2^i microseconds, and the last bucket all the longer ones.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"addr\": {\n"
+            "    \"count\": n,            (numeric) The number of messages processed\n"
+            "    \"wait\": {              (json object) Time from the receipt of the messages to the start of their processing\n"
+            "      \"total_us\": n,       (numeric) The total time in microseconds\n"
+            "      \"max_us\": n,         (numeric) The longest time in microseconds\n"
+            "      \"histogram\": [n,...] (array) The number of messages in each bucket\n"
+            "    },\n"
+            "    \"process\": {...},      (json object) Time spent processing the messages, same fields as wait\n"
+            "    \"cs_main\": {...}       (json object) Time cs_main was held for while processing them, same fields as wait\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmsgtimestats", "")
+            + HelpExampleRpc("getmsgtimestats", "")
+        );
+
+    return msgTimeStatsToJSON();
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -634,6 +714,7 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
     { "network",            "getnettotals",           &getnettotals,           {} },
+    { "network",            "getmsgtimestats",        &getmsgtimestats,        {} },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         {} },
     { "network",            "setban",                 &setban,                 {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             {} },
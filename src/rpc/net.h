@@ -0,0 +1,9 @@
+#ifndef BITCOIN_RPC_NET_H
+#define BITCOIN_RPC_NET_H
+
+class UniValue;
+
+/** Time spent on the received messages of each command to JSON, see getmsgtimestats */
+UniValue msgTimeStatsToJSON();
+
+#endif // BITCOIN_RPC_NET_H
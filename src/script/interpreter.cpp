@@ -1160,15 +1160,19 @@ public:
             ::Serialize(s, txTo.vout[nOutput]);
     }
 
-    /** Serialize txTo */
+    /** Serialize nVersion and the number of inputs of txTo */
     template<typename S>
-    void Serialize(S &s) const {
-        // Serialize nVersion
+    void SerializeHeader(S &s) const {
         ::Serialize(s, txTo.nVersion);
+        ::WriteCompactSize(s, fAnyoneCanPay ? 1 : txTo.vin.size());
+    }
+
+    /** Serialize txTo from the input nFirstInput on, after SerializeHeader and the inputs before it */
+    template<typename S>
+    void SerializeFrom(S &s, unsigned int nFirstInput) const {
         // Serialize vin
         unsigned int nInputs = fAnyoneCanPay ? 1 : txTo.vin.size();
-        ::WriteCompactSize(s, nInputs);
-        for (unsigned int nInput = 0; nInput < nInputs; nInput++)
+        for (unsigned int nInput = nFirstInput; nInput < nInputs; nInput++)
              SerializeInput(s, nInput);
         // Serialize vout
         unsigned int nOutputs = fHashNone ? 0 : (fHashSingle ? nIn+1 : txTo.vout.size());
@@ -1178,6 +1182,48 @@ public:
         // Serialize nLockTime
         ::Serialize(s, txTo.nLockTime);
     }
+
+    /** Serialize txTo */
+    template<typename S>
+    void Serialize(S &s) const {
+        SerializeHeader(s);
+        SerializeFrom(s, 0);
+    }
+};
+
+/** Double-SHA256 hasher like CHashWriter, that exposes its SHA256 state so that it can be resumed */
+class CMidstateHashWriter
+{
+private:
+    CSHA256 sha;
+
+public:
+    CMidstateHashWriter() {}
+    explicit CMidstateHashWriter(const CSHA256& shaIn) : sha(shaIn) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char *pch, size_t size) {
+        sha.Write((const unsigned char*)pch, size);
+    }
+
+    const CSHA256& GetState() const { return sha; }
+
+    // invalidates the object
+    uint256 GetHash() {
+        unsigned char buf[CSHA256::OUTPUT_SIZE];
+        uint256 result;
+        sha.Finalize(buf);
+        CSHA256().Write(buf, sizeof(buf)).Finalize(result.begin());
+        return result;
+    }
+
+    template<typename T>
+    CMidstateHashWriter& operator<<(const T& obj) {
+        ::Serialize(*this, obj);
+        return (*this);
+    }
 };
 
 uint256 GetPrevoutHash(const CTransaction& txTo) {
@@ -1215,6 +1261,23 @@ PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
         hashOutputs = GetOutputsHash(txTo);
         ready = true;
     }
+
+    // Signing one input of a legacy SIGHASH_ALL transaction hashes all the
+    // others blanked out, and the ones before it are the same for every input
+    if (txTo.vin.size() > 1) {
+        nLegacyStride = (txTo.vin.size() + MAX_LEGACY_SIGHASH_MIDSTATES - 1) / MAX_LEGACY_SIGHASH_MIDSTATES;
+        legacyMidstates.reserve((txTo.vin.size() + nLegacyStride - 1) / nLegacyStride);
+        // No input is signed, so all of them are blank
+        const CScript scriptCode;
+        CTransactionSignatureSerializer txTmp(txTo, scriptCode, txTo.vin.size(), SIGHASH_ALL);
+        CMidstateHashWriter ss;
+        txTmp.SerializeHeader(ss);
+        for (unsigned int nInput = 0; nInput < txTo.vin.size(); nInput++) {
+            if (nInput % nLegacyStride == 0)
+                legacyMidstates.push_back(ss.GetState());
+            txTmp.SerializeInput(ss, nInput);
+        }
+    }
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1280,6 +1343,16 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    // Resume from the state before the blank inputs preceding nIn
+    if (cache && !cache->legacyMidstates.empty() && !(nHashType & SIGHASH_ANYONECANPAY) &&
+        (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        unsigned int nMidstate = nIn / cache->nLegacyStride;
+        CMidstateHashWriter ss(cache->legacyMidstates[nMidstate]);
+        txTmp.SerializeFrom(ss, nMidstate * cache->nLegacyStride);
+        ss << nHashType;
+        return ss.GetHash();
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -8,6 +8,7 @@
 
 #include <script/script_error.h>
 #include <primitives/transaction.h>
+#include <crypto/sha256.h>
 
 #include <vector>
 #include <stdint.h>
@@ -121,10 +122,21 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
+/** Maximum number of legacy sighash midstates kept per transaction */
+static const unsigned int MAX_LEGACY_SIGHASH_MIDSTATES = 64;
+
 struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool ready = false;
+    /**
+     * SHA256 states of the legacy SIGHASH_ALL serialization before the inputs
+     * 0, nLegacyStride, 2 * nLegacyStride... with the other inputs blanked out,
+     * so that signing an input does not hash all the inputs before it again.
+     * Empty for transactions with a single input.
+     */
+    std::vector<CSHA256> legacyMidstates;
+    unsigned int nLegacyStride = 0;
 
     explicit PrecomputedTransactionData(const CTransaction& tx);
 };
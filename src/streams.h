@@ -241,6 +241,8 @@ public:
     const_reference operator[](size_type pos) const  { return vch[pos + nReadPos]; }
     reference operator[](size_type pos)              { return vch[pos + nReadPos]; }
     void clear()                                     { vch.clear(); nReadPos = 0; }
+    /** Exchange the underlying buffer with vchIn, and read from its start */
+    void swap(vector_type& vchIn)                    { vch.swap(vchIn); nReadPos = 0; }
     iterator insert(iterator it, const char x=char()) { return vch.insert(it, x); }
     void insert(iterator it, size_type n, const char x) { vch.insert(it, n, x); }
     value_type* data()                               { return vch.data() + nReadPos; }
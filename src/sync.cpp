@@ -10,6 +10,34 @@
 
 #include <stdio.h>
 
+#include <chrono>
+
+int64_t TimedLockClock()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef HAVE_THREAD_LOCAL
+static thread_local int64_t nTimedLocksHeld = 0;
+
+void AddTimedLockHeld(int64_t nMicros)
+{
+    nTimedLocksHeld += nMicros;
+}
+
+int64_t GetTimedLocksHeldMicros()
+{
+    return nTimedLocksHeld;
+}
+#else
+void AddTimedLockHeld(int64_t nMicros) {}
+
+int64_t GetTimedLocksHeldMicros()
+{
+    return 0;
+}
+#endif
+
 #ifdef DEBUG_LOCKCONTENTION
 #if !defined(HAVE_THREAD_LOCAL)
 static_assert(false, "thread_local is not supported");
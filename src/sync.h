@@ -9,6 +9,7 @@
 #include <threadsafety.h>
 
 #include <condition_variable>
+#include <stdint.h>
 #include <thread>
 #include <mutex>
 
@@ -87,6 +88,16 @@ void static inline DeleteLock(void* cs) {}
 #define AssertLockHeld(cs) AssertLockHeldInternal(#cs, __FILE__, __LINE__, &cs)
 #define AssertLockNotHeld(cs) AssertLockNotHeldInternal(#cs, __FILE__, __LINE__, &cs)
 
+/** Microseconds of a monotonic clock, used to time the sections */
+int64_t TimedLockClock();
+/** Add to the time the calling thread held timed sections for */
+void AddTimedLockHeld(int64_t nMicros);
+/**
+ * Total time in microseconds the calling thread held the critical sections
+ * constructed with fTimed for, 0 where thread_local is not supported.
+ */
+int64_t GetTimedLocksHeldMicros();
+
 /**
  * Wrapped mutex: supports recursive locking, but no waiting
  * TODO: We should move away from using the recursive lock by default.
@@ -94,9 +105,42 @@ void static inline DeleteLock(void* cs) {}
 class CCriticalSection : public AnnotatedMixin<std::recursive_mutex>
 {
 public:
+    CCriticalSection() : CCriticalSection(false) {}
+    /** fTimedIn: account the time the section is held for to the holding thread, see GetTimedLocksHeldMicros() */
+    explicit CCriticalSection(bool fTimedIn) : fTimed(fTimedIn), nDepth(0), nLockedSince(0) {}
+
     ~CCriticalSection() {
         DeleteLock((void*)this);
     }
+
+    void lock() EXCLUSIVE_LOCK_FUNCTION()
+    {
+        AnnotatedMixin::lock();
+        if (fTimed && nDepth++ == 0)
+            nLockedSince = TimedLockClock();
+    }
+
+    void unlock() UNLOCK_FUNCTION()
+    {
+        if (fTimed && --nDepth == 0)
+            AddTimedLockHeld(TimedLockClock() - nLockedSince);
+        AnnotatedMixin::unlock();
+    }
+
+    bool try_lock() EXCLUSIVE_TRYLOCK_FUNCTION(true)
+    {
+        if (!AnnotatedMixin::try_lock())
+            return false;
+        if (fTimed && nDepth++ == 0)
+            nLockedSince = TimedLockClock();
+        return true;
+    }
+
+private:
+    const bool fTimed;
+    // Only changed by the thread holding the section
+    int nDepth;
+    int64_t nLockedSince;
 };
 
 /** Wrapped mutex: supports waiting but not recursive locking */
@@ -11,6 +11,7 @@
 #include <pow.h>
 #include <script/sign.h>
 #include <serialize.h>
+#include <stake/tickets.h>
 #include <util.h>
 #include <validation.h>
 
@@ -30,6 +31,8 @@ struct COrphanTx {
     int64_t nTimeExpire;
 };
 extern std::map<uint256, COrphanTx> mapOrphanTransactions;
+extern bool IsWinnerVote(const CTransaction& tx, const std::vector<uint256>& winners);
+extern bool CountReceivedVote(NodeId nodeid, const CTransaction& tx);
 
 CService ip(uint32_t i)
 {
@@ -382,4 +385,94 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactions.empty());
 }
 
+static CTransactionRef MakeVote(const uint256& hashTicket, const uint256& hashVoted, uint32_t nHeightVoted)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(2);
+    tx.vin[0].prevout.SetNull();
+    tx.vin[1].prevout = COutPoint(hashTicket, 0);
+    std::vector<unsigned char> vchVoted(hashVoted.begin(), hashVoted.end());
+    vchVoted.resize(36);
+    WriteLE32(&vchVoted[32], nHeightVoted);
+    tx.vout.resize(2);
+    tx.vout[0].scriptPubKey = CScript() << OP_RETURN << vchVoted;
+    tx.vout[1].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>{0x01, 0x00};
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(DoS_winner_votes)
+{
+    const uint256 hashVoted = InsecureRand256();
+    std::vector<uint256> winners;
+    for (int i = 0; i < 3; i++)
+        winners.push_back(InsecureRand256());
+
+    CValidationStakeState stakestate;
+    BOOST_CHECK(IsSSGen(*MakeVote(winners[0], hashVoted, 0), stakestate));
+
+    // Only votes of winners count, wherever they are in the winners
+    BOOST_CHECK(!IsWinnerVote(*MakeVote(winners[0], hashVoted, 0), std::vector<uint256>()));
+    for (const uint256& hashTicket : winners)
+        BOOST_CHECK(IsWinnerVote(*MakeVote(hashTicket, hashVoted, 0), winners));
+    std::reverse(winners.begin(), winners.end());
+    BOOST_CHECK(IsWinnerVote(*MakeVote(winners[0], hashVoted, 0), winners));
+    BOOST_CHECK(!IsWinnerVote(*MakeVote(InsecureRand256(), hashVoted, 0), winners));
+
+    // Not a vote
+    CMutableTransaction tx(*MakeVote(winners[0], hashVoted, 0));
+    tx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    BOOST_CHECK(!IsWinnerVote(tx, winners));
+}
+
+BOOST_AUTO_TEST_CASE(DoS_vote_limit)
+{
+    CAddress addr1(ip(0xa0b0c001), NODE_NONE);
+    CNode dummyNode1(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr1, 4, 4, CAddress(), "", true);
+    dummyNode1.SetSendVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode1);
+    CAddress addr2(ip(0xa0b0c002), NODE_NONE);
+    CNode dummyNode2(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr2, 5, 5, CAddress(), "", true);
+    dummyNode2.SetSendVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode2);
+
+    // Votes on a block we do not know are bounded by the tickets per block
+    const unsigned int nVotes = MAX_VOTES_PER_WINNER * Params().GetConsensus().TicketsPerBlock;
+    const uint256 hashVoted = InsecureRand256();
+    {
+        LOCK(cs_main);
+        for (unsigned int i = 0; i < nVotes; i++)
+            BOOST_CHECK(CountReceivedVote(dummyNode1.GetId(), *MakeVote(InsecureRand256(), hashVoted, 0)));
+        BOOST_CHECK(!CountReceivedVote(dummyNode1.GetId(), *MakeVote(InsecureRand256(), hashVoted, 0)));
+
+        // Other peers and votes on other blocks have their own budget
+        BOOST_CHECK(CountReceivedVote(dummyNode2.GetId(), *MakeVote(InsecureRand256(), hashVoted, 0)));
+        BOOST_CHECK(CountReceivedVote(dummyNode1.GetId(), *MakeVote(InsecureRand256(), InsecureRand256(), 0)));
+    }
+
+    // Votes on a block nobody can vote on are left to AcceptToMemoryPool
+    CBlockIndex index;
+    index.stakeNode = std::make_shared<TicketNode>();
+    const uint256 hashNoWinners = InsecureRand256();
+    {
+        LOCK(cs_main);
+        mapBlockIndex.emplace(hashNoWinners, &index);
+        for (unsigned int i = 0; i <= nVotes; i++)
+            BOOST_CHECK(CountReceivedVote(dummyNode1.GetId(), *MakeVote(InsecureRand256(), hashNoWinners, 0)));
+        mapBlockIndex.erase(hashNoWinners);
+    }
+
+    // Only so many blocks voted on at or above the tip are counted at a time
+    {
+        LOCK(cs_main);
+        for (unsigned int i = 2; i < MAX_VOTED_BLOCKS_PER_PEER; i++)
+            BOOST_CHECK(CountReceivedVote(dummyNode1.GetId(), *MakeVote(InsecureRand256(), InsecureRand256(), chainActive.Height())));
+        BOOST_CHECK(!CountReceivedVote(dummyNode1.GetId(), *MakeVote(InsecureRand256(), InsecureRand256(), chainActive.Height())));
+        BOOST_CHECK(CountReceivedVote(dummyNode2.GetId(), *MakeVote(InsecureRand256(), InsecureRand256(), chainActive.Height())));
+    }
+
+    bool dummy;
+    peerLogic->FinalizeNode(dummyNode1.GetId(), dummy);
+    peerLogic->FinalizeNode(dummyNode2.GetId(), dummy);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
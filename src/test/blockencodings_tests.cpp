@@ -118,6 +118,7 @@ public:
     uint64_t nonce;
     std::vector<uint64_t> shorttxids;
     std::vector<PrefilledTransaction> prefilledtxn;
+    std::vector<uint64_t> stakeshorttxids;
 
     explicit TestHeaderAndShortIDs(const CBlockHeaderAndShortTxIDs& orig) {
         CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
@@ -152,6 +153,18 @@ public:
             shorttxids[i] = (uint64_t(msb) << 32) | uint64_t(lsb);
         }
         READWRITE(prefilledtxn);
+        if (s.GetVersion() >= STAKE_SHORT_IDS_BLOCKS_VERSION) {
+            size_t stakeshorttxids_size = stakeshorttxids.size();
+            READWRITE(VARINT(stakeshorttxids_size));
+            stakeshorttxids.resize(stakeshorttxids_size);
+            for (size_t i = 0; i < stakeshorttxids.size(); i++) {
+                uint32_t lsb = stakeshorttxids[i] & 0xffffffff;
+                uint16_t msb = (stakeshorttxids[i] >> 32) & 0xffff;
+                READWRITE(lsb);
+                READWRITE(msb);
+                stakeshorttxids[i] = (uint64_t(msb) << 32) | uint64_t(lsb);
+            }
+        }
     }
 };
 
@@ -317,6 +330,71 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(StakeTxRoundTripTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase());
+
+    CMutableTransaction stx;
+    stx.vin.resize(1);
+    stx.vout.resize(1);
+    stx.vout[0].nValue = 7;
+    block.svtx.resize(2);
+    for (size_t i = 0; i < block.svtx.size(); i++) {
+        stx.vin[0].prevout.hash = InsecureRand256();
+        block.svtx[i] = MakeTransactionRef(stx);
+    }
+    bool mutated;
+    uint256 hashStakeMerkle = BlockStakeMerkle(block, &mutated);
+
+    pool.addUnchecked(block.vtx[2]->GetHash(), entry.FromTx(*block.vtx[2]));
+    pool.addUnchecked(block.svtx[0]->GetHash(), entry.FromTx(*block.svtx[0]));
+
+    {
+        CBlockHeaderAndShortTxIDs shortIDs(block, true);
+        BOOST_CHECK_EQUAL(shortIDs.BlockTxCount(), 5U);
+        BOOST_CHECK_EQUAL(shortIDs.BlockStakeTxCount(), 2U);
+
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << shortIDs;
+
+        CBlockHeaderAndShortTxIDs shortIDs2;
+        stream >> shortIDs2;
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+        BOOST_CHECK( partialBlock.IsTxAvailable(0));
+        BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+        BOOST_CHECK( partialBlock.IsTxAvailable(2));
+        BOOST_CHECK( partialBlock.IsTxAvailable(3));
+        BOOST_CHECK(!partialBlock.IsTxAvailable(4));
+
+        // The missing transactions are sent in the order of their indexes, vtx first
+        CBlock block2;
+        BOOST_CHECK(partialBlock.FillBlock(block2, {block.vtx[1], block.svtx[1]}) == READ_STATUS_OK);
+        BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+        BOOST_CHECK_EQUAL(block2.vtx.size(), 3U);
+        BOOST_CHECK_EQUAL(block2.svtx.size(), 2U);
+        BOOST_CHECK_EQUAL(block.hashMerkleRoot.ToString(), BlockMerkleRoot(block2, &mutated).ToString());
+        BOOST_CHECK_EQUAL(hashStakeMerkle.ToString(), BlockStakeMerkle(block2, &mutated).ToString());
+    }
+
+    // Peers before the stake short ids get the vtx only
+    {
+        CBlockHeaderAndShortTxIDs shortIDs(block, true);
+
+        CDataStream stream(SER_NETWORK, STAKE_SHORT_IDS_BLOCKS_VERSION - 1);
+        stream << shortIDs;
+
+        CBlockHeaderAndShortTxIDs shortIDs2;
+        stream >> shortIDs2;
+        BOOST_CHECK(stream.empty());
+        BOOST_CHECK_EQUAL(shortIDs2.BlockTxCount(), 3U);
+        BOOST_CHECK_EQUAL(shortIDs2.BlockStakeTxCount(), 0U);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
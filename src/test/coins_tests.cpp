@@ -656,6 +656,40 @@ BOOST_AUTO_TEST_CASE(ccoins_access)
     CheckAccessCoin(VALUE1, VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
 }
 
+void CheckWarmCoin(CAmount cache_value, CAmount warm_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(ABSENT, cache_value, cache_flags);
+    Coin coin;
+    SetCoinsValue(warm_value, coin);
+    test.cache.WarmCoin(OUTPOINT, std::move(coin));
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_warm)
+{
+    /* Check WarmCoin behavior, inserting a coin read from the base view on
+     * behalf of the cache, and checking that an existing cache entry is never
+     * replaced.
+     *
+     *            Cache   Warm    Result  Cache        Result
+     *            Value   Value   Value   Flags        Flags
+     */
+    CheckWarmCoin(ABSENT, VALUE1, VALUE1, NO_ENTRY   , 0          );
+    CheckWarmCoin(ABSENT, PRUNED, PRUNED, NO_ENTRY   , FRESH      );
+    CheckWarmCoin(PRUNED, VALUE1, PRUNED, 0          , 0          );
+    CheckWarmCoin(PRUNED, VALUE1, PRUNED, DIRTY      , DIRTY      );
+    CheckWarmCoin(PRUNED, VALUE1, PRUNED, DIRTY|FRESH, DIRTY|FRESH);
+    CheckWarmCoin(VALUE2, VALUE1, VALUE2, 0          , 0          );
+    CheckWarmCoin(VALUE2, VALUE1, VALUE2, DIRTY      , DIRTY      );
+    CheckWarmCoin(VALUE2, VALUE1, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
+}
+
 void CheckSpendCoins(CAmount base_value, CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
 {
     SingleEntryCacheTest test(base_value, cache_value, cache_flags);
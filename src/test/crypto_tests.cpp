@@ -10,6 +10,8 @@
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <hash.h>
+#include <libdevcore/SHA3.h>
 #include <random.h>
 #include <utilstrencodings.h>
 #include <test/test_bitcoin.h>
@@ -268,6 +270,25 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        // In place, as the merkle root computation does
+        SHA256D64(in, in, i);
+        BOOST_CHECK(memcmp(out1, in, 32 * i) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -305,6 +326,52 @@ BOOST_AUTO_TEST_CASE(sha512_testvectors) {
                "37de8c3ef5459d76a52cedc02dc499a3c9ed9dedbfb3281afd9653b8a112fafc");
 }
 
+static void TestKECCAK256(const std::string &in, const std::string &hexout)
+{
+    BOOST_CHECK_EQUAL(dev::sha3(in).hex(), hexout);
+}
+
+BOOST_AUTO_TEST_CASE(keccak256_testvectors) {
+    TestKECCAK256("", "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+    TestKECCAK256("abc", "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45");
+    TestKECCAK256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+                  "45d3b367a6904e6e8d502ee04999a7c27647f91fa845d456525fd352ae3d7371");
+    TestKECCAK256("The quick brown fox jumps over the lazy dog",
+                  "4d741b6f1eb29cb2a9b9911c82f56fa8d73b04959d3d9d222895df6c0b28aa15");
+    // One byte short of the block size, and exactly the block size
+    TestKECCAK256(std::string(135, 'x'), "16570bdb055e663ea1cb57ac6f09194f4bc7b7070847971fc0b86710366dc34f");
+    TestKECCAK256(std::string(136, 'x'), "50da8ef3747b7a7f01d08563aa11c72a2a668563fb928adc6e8d2a1ab4e36096");
+    TestKECCAK256(std::string(1000000, 'a'), "fadae6b49f129bbb812be8407b7b2894f34aecf6dbd1f9b0f0c7e9853098fc96");
+}
+
+BOOST_AUTO_TEST_CASE(keccak256_implementations) {
+    // The optimized permutation matches the plain one
+    for (int i = 0; i < 100; i++) {
+        uint64_t lanes[25], expected[25];
+        for (int j = 0; j < 25; j++)
+            lanes[j] = expected[j] = InsecureRandBits(64);
+        dev::keccak::keccakf(lanes);
+        dev::keccak::keccakfPortable(expected);
+        BOOST_CHECK(memcmp(lanes, expected, sizeof(lanes)) == 0);
+    }
+
+    // Hashing in batches gives the same hashes as one by one, whatever the input sizes
+    for (int i = 0; i < 50; i++) {
+        std::vector<std::vector<unsigned char>> inputs(InsecureRandRange(20));
+        std::vector<dev::bytesConstRef> refs;
+        for (auto& input : inputs) {
+            input.resize(InsecureRandRange(400));
+            for (auto& c : input)
+                c = InsecureRandBits(8);
+            refs.push_back(dev::bytesConstRef(input.data(), input.size()));
+        }
+        std::vector<dev::h256> hashes(inputs.size());
+        dev::sha3(refs.data(), refs.size(), hashes.data());
+        for (size_t j = 0; j < refs.size(); j++)
+            BOOST_CHECK(hashes[j] == dev::sha3(refs[j]));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(hmac_sha256_testvectors) {
     // test cases 1, 2, 3, 4, 6 and 7 of RFC 4231
     TestHMACSHA256("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
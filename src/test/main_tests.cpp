@@ -3,6 +3,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <consensus/validation.h>
+#include <miner.h>
+#include <pow.h>
 #include <validation.h>
 #include <net.h>
 
@@ -102,4 +105,54 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+/** Process headers with nThreads header check threads and return the DoS score of the first invalid one */
+static int ProcessInvalidHeaders(const std::vector<CBlockHeader>& headers, int nThreads, CBlockHeader& first_invalid)
+{
+    nHeaderCheckThreads = nThreads;
+    CValidationState state;
+    BOOST_CHECK(!ProcessNewBlockHeaders(headers, state, Params(), nullptr, &first_invalid));
+    nHeaderCheckThreads = 0;
+    int nDoS = 0;
+    BOOST_CHECK(state.IsInvalid(nDoS));
+    return nDoS;
+}
+
+BOOST_FIXTURE_TEST_CASE(header_precheck_test, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    CBlock block = BlockAssembler(chainparams).CreateNewBlock(CScript() << OP_TRUE)->block;
+    unsigned int extraNonce = 0;
+    {
+        LOCK(cs_main);
+        IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+    }
+    CBlockHeader header = block.GetBlockHeader();
+    while (!CheckProofOfWork(header.GetHash(), header.nBits, chainparams.GetConsensus()))
+        ++header.nNonce;
+
+    // A header failing the proof of work, and a proof of stake header with a signature that is not DER
+    CBlockHeader headerHighHash = header;
+    while (CheckProofOfWork(headerHighHash.GetHash(), headerHighHash.nBits, chainparams.GetConsensus()))
+        ++headerHighHash.nNonce;
+    CBlockHeader headerBadSig = header;
+    headerBadSig.prevoutStake = COutPoint(InsecureRand256(), 0);
+    headerBadSig.vchBlockSig = {0x30, 0x01};
+
+    for (int i = 0; i < 2; i++)
+        threadGroup.create_thread(&ThreadHeaderCheck);
+
+    // The headers checked before cs_main is taken are rejected as in the serial path
+    for (const auto& test : {std::make_pair(headerHighHash, 50), std::make_pair(headerBadSig, 100)}) {
+        const std::vector<CBlockHeader> headers = {header, test.first};
+        CBlockHeader first_invalid, first_invalid_serial;
+        const int nDoSSerial = ProcessInvalidHeaders(headers, 0, first_invalid_serial);
+        const int nDoS = ProcessInvalidHeaders(headers, 2, first_invalid);
+        BOOST_CHECK(first_invalid_serial.GetHash() == test.first.GetHash());
+        BOOST_CHECK(first_invalid.GetHash() == first_invalid_serial.GetHash());
+        BOOST_CHECK_EQUAL(nDoSSerial, test.second);
+        BOOST_CHECK_EQUAL(nDoS, nDoSSerial);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
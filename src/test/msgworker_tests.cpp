@@ -0,0 +1,268 @@
+// Unit tests for the processing of received messages behind the message workers
+
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <hash.h>
+#include <miner.h>
+#include <net.h>
+#include <net_processing.h>
+#include <netmessagemaker.h>
+#include <script/script.h>
+#include <pow.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+/** Work on a message that the test finishes */
+class CTestMessageTask : public CNetMessageTask
+{
+public:
+    void Finish() { SetDone(); }
+};
+
+static CService ip(uint32_t i)
+{
+    struct in_addr s;
+    s.s_addr = i;
+    return CService(CNetAddr(s), Params().GetDefaultPort());
+}
+
+/** Receive msg from the network into msgs */
+static CNetMessage& ReceiveMessage(std::list<CNetMessage>& msgs, const CSerializedNetMsg& msg)
+{
+    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+    uint256 hash = Hash(msg.data.begin(), msg.data.end());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << hdr;
+
+    msgs.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    CNetMessage& netmsg = msgs.back();
+    BOOST_CHECK_EQUAL(netmsg.readHeader(stream.data(), stream.size()), (int)stream.size());
+    if (!msg.data.empty())
+        BOOST_CHECK_EQUAL(netmsg.readData((const char*)msg.data.data(), msg.data.size()), (int)msg.data.size());
+    BOOST_CHECK(netmsg.complete());
+    return netmsg;
+}
+
+/** Hand the received messages to the message handler of node, as the socket handler does */
+static void QueueMessages(CNode& node, std::list<CNetMessage>& msgs)
+{
+    LOCK(node.cs_vProcessMsg);
+    for (const CNetMessage& msg : msgs)
+        node.nProcessQueueSize += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+    node.vProcessMsg.splice(node.vProcessMsg.end(), msgs);
+}
+
+/** Keeps the result of the last block checked by ProcessNewBlock */
+class CBlockCheckedListener : public CValidationInterface
+{
+public:
+    CValidationState state;
+
+protected:
+    void BlockChecked(const CBlock& block, const CValidationState& stateIn) override { state = stateIn; }
+};
+
+static size_t ProcessQueueSize(CNode& node)
+{
+    LOCK(node.cs_vProcessMsg);
+    return node.vProcessMsg.size();
+}
+
+BOOST_FIXTURE_TEST_SUITE(msgworker_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(msgworker_message_order)
+{
+    std::atomic<bool> interruptDummy(false);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(ip(0xa0b0c001), NODE_NONE), 0, 0, CAddress(), "", true);
+    node.SetSendVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&node);
+    node.nVersion = PROTOCOL_VERSION;
+    node.fSuccessfullyConnected = true;
+
+    // A message waits for the work on it, and the later messages of the peer wait behind it
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    std::list<CNetMessage> msgs;
+    std::shared_ptr<CTestMessageTask> task = std::make_shared<CTestMessageTask>();
+    ReceiveMessage(msgs, msgMaker.Make(NetMsgType::PING, (uint64_t)1)).task = task;
+    ReceiveMessage(msgs, msgMaker.Make(NetMsgType::PING, (uint64_t)2));
+    QueueMessages(node, msgs);
+    BOOST_CHECK(!peerLogic->ProcessMessages(&node, interruptDummy));
+    BOOST_CHECK_EQUAL(ProcessQueueSize(node), 2U);
+
+    task->Finish();
+    BOOST_CHECK(peerLogic->ProcessMessages(&node, interruptDummy));
+    BOOST_CHECK_EQUAL(ProcessQueueSize(node), 1U);
+    BOOST_CHECK(!peerLogic->ProcessMessages(&node, interruptDummy));
+    BOOST_CHECK_EQUAL(ProcessQueueSize(node), 0U);
+
+    // Nothing is processed while a block is being sent to the peer
+    node.fGetDataPending = true;
+    ReceiveMessage(msgs, msgMaker.Make(NetMsgType::PING, (uint64_t)3));
+    QueueMessages(node, msgs);
+    BOOST_CHECK(!peerLogic->ProcessMessages(&node, interruptDummy));
+    BOOST_CHECK_EQUAL(ProcessQueueSize(node), 1U);
+
+    node.fGetDataPending = false;
+    peerLogic->ProcessMessages(&node, interruptDummy);
+    BOOST_CHECK_EQUAL(ProcessQueueSize(node), 0U);
+    BOOST_CHECK_EQUAL(node.nProcessQueueSize, 0U);
+
+    bool dummy;
+    peerLogic->FinalizeNode(node.GetId(), dummy);
+}
+
+BOOST_AUTO_TEST_CASE(msgworker_stop)
+{
+    CNode node(1, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(ip(0xa0b0c002), NODE_NONE), 1, 1, CAddress(), "", true);
+    node.SetSendVersion(PROTOCOL_VERSION);
+    node.nVersion = PROTOCOL_VERSION;
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    mtx.vin[0].scriptSig << OP_1;
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = 1 * CENT;
+    mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    const CTransaction tx(mtx);
+
+    std::unique_ptr<PeerLogicValidation> logic(new PeerLogicValidation(connman, scheduler, 1));
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    std::list<CNetMessage> msgs;
+    std::vector<std::shared_ptr<CNetMessageTask>> vTasks;
+    for (int i = 0; i < 100; i++) {
+        CNetMessage& msg = ReceiveMessage(msgs, msgMaker.Make(NetMsgType::TX, tx));
+        logic->ReceivedMessage(&node, msg);
+        BOOST_CHECK(msg.task);
+        vTasks.push_back(msg.task);
+    }
+
+    // The work the workers did not get to is dropped
+    logic->StopWorkers();
+    auto IsDone = [](const std::shared_ptr<CNetMessageTask>& task) { return task->IsDone(); };
+    const auto nDone = std::count_if(vTasks.begin(), vTasks.end(), IsDone);
+    MilliSleep(10);
+    BOOST_CHECK_EQUAL(std::count_if(vTasks.begin(), vTasks.end(), IsDone), nDone);
+
+    // and the messages received afterwards are processed without the workers
+    CNetMessage& msg = ReceiveMessage(msgs, msgMaker.Make(NetMsgType::TX, tx));
+    logic->ReceivedMessage(&node, msg);
+    BOOST_CHECK(!msg.task);
+
+    // Each peer logic has workers of its own, which run after the ones of another were stopped
+    logic.reset(new PeerLogicValidation(connman, scheduler, 1));
+    CNetMessage& msgNext = ReceiveMessage(msgs, msgMaker.Make(NetMsgType::TX, tx));
+    logic->ReceivedMessage(&node, msgNext);
+    BOOST_REQUIRE(msgNext.task);
+    for (int i = 0; i < 1000 && !msgNext.task->IsDone(); i++)
+        MilliSleep(10);
+    BOOST_CHECK(msgNext.task->IsDone());
+}
+
+BOOST_FIXTURE_TEST_CASE(msgworker_block_check, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(CScript() << OP_TRUE);
+    CBlock block = pblocktemplate->block;
+    unsigned int extraNonce = 0;
+    {
+        LOCK(cs_main);
+        IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+    }
+
+    // A block failing the checks of the workers, and one failing only the checks that depend on the DGP
+    CBlock blockBadMerkle = block;
+    blockBadMerkle.hashMerkleRoot = InsecureRand256();
+    CBlock blockSigOps = block;
+    CMutableTransaction coinbase(*block.vtx[0]);
+    const std::vector<unsigned char> vchSigOps(dgpMaxBlockSigOps / WITNESS_SCALE_FACTOR + 1, OP_CHECKSIG);
+    coinbase.vout.push_back(CTxOut(0, CScript(vchSigOps.begin(), vchSigOps.end())));
+    blockSigOps.vtx[0] = MakeTransactionRef(coinbase);
+    blockSigOps.hashMerkleRoot = BlockMerkleRoot(blockSigOps);
+
+    CBlockCheckedListener listener;
+    RegisterValidationInterface(&listener);
+    for (CBlock* pblockTest : {&blockBadMerkle, &blockSigOps}) {
+        while (!CheckProofOfWork(pblockTest->GetHash(), pblockTest->nBits, chainparams.GetConsensus()))
+            ++pblockTest->nNonce;
+
+        CValidationState stateSerial;
+        BOOST_CHECK(!CheckBlock(CBlock(*pblockTest), stateSerial, chainparams.GetConsensus()));
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(*pblockTest);
+        CValidationState stateWorker;
+        const bool fContextFree = CheckBlockContextFree(*pblock, stateWorker, chainparams.GetConsensus());
+        BOOST_CHECK_EQUAL(fContextFree, pblockTest == &blockSigOps);
+        BOOST_CHECK_EQUAL(pblock->fCheckedContextFree, fContextFree);
+        BOOST_CHECK(!pblock->fChecked);
+
+        // ProcessNewBlock rejects it as CheckBlock alone does
+        BOOST_CHECK(!ProcessNewBlock(chainparams, pblock, true, nullptr));
+        int nDoSSerial = 0, nDoS = 0;
+        BOOST_CHECK(stateSerial.IsInvalid(nDoSSerial));
+        BOOST_CHECK(listener.state.IsInvalid(nDoS));
+        BOOST_CHECK_EQUAL(nDoS, nDoSSerial);
+        BOOST_CHECK_EQUAL(nDoS, 100);
+        BOOST_CHECK_EQUAL(listener.state.GetRejectReason(), stateSerial.GetRejectReason());
+        BOOST_CHECK(!pblock->fChecked);
+    }
+    UnregisterValidationInterface(&listener);
+}
+
+BOOST_FIXTURE_TEST_CASE(msgworker_block_message, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(CScript() << OP_TRUE);
+    CBlock block = pblocktemplate->block;
+    unsigned int extraNonce = 0;
+    {
+        LOCK(cs_main);
+        IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+    }
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus()))
+        ++block.nNonce;
+
+    std::atomic<bool> interruptDummy(false);
+    std::unique_ptr<PeerLogicValidation> logic(new PeerLogicValidation(connman, scheduler, 1));
+    CNode node(2, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(ip(0xa0b0c003), NODE_NONE), 2, 2, CAddress(), "", true);
+    node.SetSendVersion(PROTOCOL_VERSION);
+    logic->InitializeNode(&node);
+    node.nVersion = PROTOCOL_VERSION;
+    node.SetRecvVersion(PROTOCOL_VERSION);
+    node.fSuccessfullyConnected = true;
+
+    // The workers take the payload of the message, which is not kept twice
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    std::list<CNetMessage> msgs;
+    CNetMessage& msg = ReceiveMessage(msgs, msgMaker.Make(NetMsgType::BLOCK, block));
+    logic->ReceivedMessage(&node, msg);
+    BOOST_REQUIRE(msg.task);
+    BOOST_CHECK(msg.vRecv.empty());
+    std::shared_ptr<CNetMessageTask> task = msg.task;
+    for (int i = 0; i < 1000 && !task->IsDone(); i++)
+        MilliSleep(10);
+    BOOST_REQUIRE(task->IsDone());
+
+    // and ProcessMessage connects the block they decoded
+    QueueMessages(node, msgs);
+    logic->ProcessMessages(&node, interruptDummy);
+    BOOST_CHECK_EQUAL(ProcessQueueSize(node), 0U);
+    BOOST_CHECK_EQUAL(node.nProcessQueueSize, 0U);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    }
+
+    bool dummy;
+    logic->FinalizeNode(node.GetId(), dummy);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <serialize.h>
 #include <streams.h>
 #include <net.h>
+#include <net_processing.h>
 #include <netbase.h>
 #include <chainparams.h>
 #include <util.h>
@@ -185,4 +186,146 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    auto buffer = [](size_t capacity) {
+        CSerializeData buf;
+        buf.reserve(capacity);
+        return buf;
+    };
+    const size_t step = RECV_BUFFER_STEP;
+    CRecvBufferPool pool(5 * step);
+
+    // Small buffers are not worth keeping
+    pool.Put(buffer(step));
+    BOOST_CHECK_EQUAL(pool.Size(), 0U);
+    BOOST_CHECK_EQUAL(pool.Get(step).capacity(), 0U);
+
+    pool.Put(buffer(2 * step));
+    pool.Put(buffer(3 * step));
+    BOOST_CHECK_EQUAL(pool.Size(), 2U);
+    // The smallest buffer large enough, then the largest one
+    BOOST_CHECK_EQUAL(pool.Get(2 * step + 1).capacity(), 3 * step);
+    BOOST_CHECK_EQUAL(pool.Get(10 * step).capacity(), 2 * step);
+    BOOST_CHECK_EQUAL(pool.Size(), 0U);
+
+    // The smallest buffers are dropped when the pool is full
+    pool.Put(buffer(2 * step));
+    pool.Put(buffer(3 * step));
+    pool.Put(buffer(4 * step));
+    BOOST_CHECK_EQUAL(pool.Size(), 1U);
+    BOOST_CHECK_EQUAL(pool.Get(0).capacity(), 4 * step);
+}
+
+BOOST_AUTO_TEST_CASE(cnetmessage_pooled_data)
+{
+    std::vector<char> data(3 * RECV_BUFFER_STEP + 1);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (char)(i * 7);
+    CMessageHeader hdr(Params().MessageStart(), NetMsgType::BLOCK, data.size());
+    CDataStream hdrStream(SER_NETWORK, PROTOCOL_VERSION);
+    hdrStream << hdr;
+
+    size_t nPooled = g_recv_buffer_pool.Size();
+    for (int n = 0; n < 2; n++) {
+        {
+            CNetMessage msg(Params().MessageStart(), SER_NETWORK, PROTOCOL_VERSION);
+            BOOST_CHECK_EQUAL(msg.readHeader(hdrStream.data(), hdrStream.size()), (int)hdrStream.size());
+            // Received in pieces, the second time into the buffer of the first message
+            for (size_t pos = 0; pos < data.size(); pos += 1000)
+                BOOST_CHECK_EQUAL(msg.readData(data.data() + pos, std::min<size_t>(1000, data.size() - pos)), (int)std::min<size_t>(1000, data.size() - pos));
+            BOOST_CHECK(msg.complete());
+            BOOST_CHECK(std::equal(data.begin(), data.end(), msg.vRecv.begin()));
+            BOOST_CHECK(msg.GetMessageHash() == Hash(data.begin(), data.end()));
+        }
+        BOOST_CHECK_EQUAL(g_recv_buffer_pool.Size(), std::max<size_t>(nPooled, 1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shared_net_msg)
+{
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::CMPCTBLOCK;
+    msg.data = {1, 2, 3, 4, 5};
+    const std::vector<unsigned char> data = msg.data;
+    CSharedNetMsg shared(std::move(msg));
+    BOOST_CHECK_EQUAL(shared.command, NetMsgType::CMPCTBLOCK);
+    BOOST_CHECK(*shared.data == data);
+
+    CMessageHeader hdr(Params().MessageStart());
+    CDataStream hdrStream(*shared.header, SER_NETWORK, PROTOCOL_VERSION);
+    hdrStream >> hdr;
+    BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), NetMsgType::CMPCTBLOCK);
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, data.size());
+    uint256 hash = Hash(data.begin(), data.end());
+    BOOST_CHECK(memcmp(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE) == 0);
+
+    // The same buffers are used, not copies
+    CSharedNetMsg fromBuffer(NetMsgType::CMPCTBLOCK, shared.data);
+    BOOST_CHECK(fromBuffer.data == shared.data);
+    BOOST_CHECK(*fromBuffer.header == *shared.header);
+
+    CSerializedNetMsg empty;
+    empty.command = NetMsgType::VERACK;
+    CSharedNetMsg sharedEmpty(std::move(empty));
+    BOOST_CHECK(!sharedEmpty.IsNull());
+    BOOST_CHECK_EQUAL(sharedEmpty.DataSize(), 0U);
+    BOOST_CHECK_EQUAL(sharedEmpty.header->size(), CMessageHeader::HEADER_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(msg_time_stats)
+{
+    CTimeHistogram histogram;
+    for (int64_t nMicros : {0, 1, 3, 4, 1000, -5})
+        histogram.Add(nMicros);
+    histogram.Add((int64_t)1 << 40);
+    BOOST_CHECK_EQUAL(histogram.nCount, 7U);
+    BOOST_CHECK_EQUAL(histogram.vBuckets[0], 2U); // 0 and the negative one
+    BOOST_CHECK_EQUAL(histogram.vBuckets[1], 1U);
+    BOOST_CHECK_EQUAL(histogram.vBuckets[2], 1U);
+    BOOST_CHECK_EQUAL(histogram.vBuckets[3], 1U);
+    BOOST_CHECK_EQUAL(histogram.vBuckets[10], 1U);
+    BOOST_CHECK_EQUAL(histogram.vBuckets[CTimeHistogram::BUCKETS - 1], 1U);
+    BOOST_CHECK_EQUAL(histogram.nTotal, ((int64_t)1 << 40) + 1008);
+    BOOST_CHECK_EQUAL(histogram.nMax, (int64_t)1 << 40);
+
+    // Unknown commands are counted together
+    CAddress addr(CService(CNetAddr(), 7777), NODE_NETWORK);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+    node.RecordMessageTime(NetMsgType::TX, 10, 20, 5);
+    node.RecordMessageTime(NetMsgType::TX, 1, 2, 0);
+    node.RecordMessageTime("nonsense", 1, 1, 1);
+    CNodeStats stats;
+    node.copyStats(stats);
+    BOOST_CHECK_EQUAL(stats.mapRecvTimePerMsgCmd[NetMsgType::TX].nCount, 2U);
+    BOOST_CHECK_EQUAL(stats.mapRecvTimePerMsgCmd[NetMsgType::TX].nWait, 11);
+    BOOST_CHECK_EQUAL(stats.mapRecvTimePerMsgCmd[NetMsgType::TX].nProcess, 22);
+    BOOST_CHECK_EQUAL(stats.mapRecvTimePerMsgCmd[NetMsgType::TX].nCsMain, 5);
+    BOOST_CHECK_EQUAL(stats.mapRecvTimePerMsgCmd[NET_MESSAGE_COMMAND_OTHER].nCount, 1U);
+    BOOST_CHECK(!stats.mapRecvTimePerMsgCmd.count("nonsense"));
+
+#ifdef HAVE_THREAD_LOCAL
+    // Only the outermost lock of a timed section is accounted, in builds that can keep the time per thread
+    CCriticalSection cs(true);
+    int64_t nHeldStart = GetTimedLocksHeldMicros();
+    {
+        LOCK(cs);
+        {
+            LOCK(cs);
+            MilliSleep(2);
+        }
+        MilliSleep(2);
+    }
+    int64_t nHeld = GetTimedLocksHeldMicros() - nHeldStart;
+    BOOST_CHECK(nHeld >= 4000);
+    {
+        CCriticalSection csUntimed;
+        LOCK(csUntimed);
+        MilliSleep(2);
+    }
+    BOOST_CHECK_EQUAL(GetTimedLocksHeldMicros() - nHeldStart, nHeld);
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_bitcoin.h>
+
+#include <libdevcore/AsyncWriteQueue.h>
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/SHA3.h>
+#include <libdevcore/TrieNodeCache.h>
+#include <leveldb/db.h>
+#include <leveldb/env.h>
+#include <memenv.h>
+
+#include <atomic>
+
+namespace {
+
+/** A state database in memory, read back without the shared trie node cache */
+struct AsyncCommitSetup : public BasicTestingSetup
+{
+    AsyncCommitSetup() : env(leveldb::NewMemEnv(leveldb::Env::Default())), prevMaxSize(dev::TrieNodeCache::instance().stats().maxSize)
+    {
+        dev::TrieNodeCache::instance().setMaxSize(0);
+        leveldb::Options options;
+        options.create_if_missing = true;
+        options.env = env.get();
+        BOOST_CHECK(leveldb::DB::Open(options, "/state", &pdb).ok());
+    }
+
+    ~AsyncCommitSetup()
+    {
+        dev::TrieNodeCache::instance().setMaxSize(prevMaxSize);
+    }
+
+    bool OnDisk(const dev::h256& hash)
+    {
+        std::string value;
+        return pdb->Get(leveldb::ReadOptions(), leveldb::Slice((const char*)hash.data(), hash.size), &value).ok();
+    }
+
+    std::unique_ptr<leveldb::Env> env;
+    leveldb::DB* pdb = nullptr;
+    size_t prevMaxSize;
+};
+
+std::string NodeValue(int n)
+{
+    return std::string(100, (char)n) + std::to_string(n);
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(asynccommit_tests, AsyncCommitSetup)
+
+BOOST_AUTO_TEST_CASE(asyncwritequeue_order){
+    std::vector<int> done;
+    {
+        dev::AsyncWriteQueue queue("test-writer");
+        for (int i = 0; i < 100; i++)
+            queue.enqueue([&done, i]() { done.push_back(i); });
+        queue.wait();
+        BOOST_CHECK_EQUAL(queue.pending(), 0);
+        BOOST_CHECK_EQUAL(done.size(), 100);
+        // Writes still queued are run before the queue is destroyed
+        for (int i = 100; i < 200; i++)
+            queue.enqueue([&done, i]() { done.push_back(i); });
+    }
+    BOOST_CHECK_EQUAL(done.size(), 200);
+    for (int i = 0; i < 200; i++)
+        BOOST_CHECK_EQUAL(done[i], i);
+}
+
+BOOST_AUTO_TEST_CASE(asyncwritequeue_error){
+    std::vector<int> done;
+    dev::AsyncWriteQueue queue("test-writer");
+    queue.enqueue([&done]() { done.push_back(0); });
+    queue.wait();
+    queue.enqueue([]() { throw std::runtime_error("disk full"); });
+    queue.enqueue([&done]() { done.push_back(1); });
+    BOOST_CHECK_THROW(queue.wait(), std::runtime_error);
+    BOOST_CHECK_EQUAL(queue.pending(), 0);
+    BOOST_CHECK_EQUAL(done.size(), 2);
+
+    // The failure is not forgotten by the next writes
+    queue.enqueue([&done]() { done.push_back(2); });
+    try {
+        queue.wait();
+        BOOST_ERROR("wait() did not throw");
+    } catch (const std::runtime_error& e) {
+        BOOST_CHECK(std::string(e.what()).find("disk full") != std::string::npos);
+    }
+    BOOST_CHECK_EQUAL(done.size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(overlaydb_async_commit){
+    dev::OverlayDB odb(pdb);
+    odb.setAsyncCommit();
+    dev::OverlayDB copy(odb);
+
+    std::vector<dev::h256> hashes;
+    for (int i = 0; i < 1000; i++) {
+        std::string value = NodeValue(i);
+        hashes.push_back(dev::sha3(value));
+        odb.insert(hashes.back(), &value);
+        dev::bytes aux(value.begin(), value.end());
+        odb.insertAux(hashes.back(), &aux);
+        // Many small commits, as with one commit per contract transaction
+        if (i % 10 == 9)
+            odb.commit();
+    }
+
+    // Committed nodes are readable at once, on disk or not, also by the copies
+    for (int i = 0; i < 1000; i++) {
+        BOOST_CHECK(odb.lookup(hashes[i]) == NodeValue(i));
+        BOOST_CHECK(copy.exists(hashes[i]));
+        BOOST_CHECK(copy.lookupAux(hashes[i]).size() == NodeValue(i).size());
+    }
+
+    odb.flushCommits(true);
+    BOOST_CHECK_EQUAL(odb.pendingCommits(), 0);
+    for (int i = 0; i < 1000; i++)
+        BOOST_CHECK(OnDisk(hashes[i]));
+
+    // Deleting from disk waits for the commits that could write the node again
+    std::string value = NodeValue(1000);
+    dev::h256 hash = dev::sha3(value);
+    odb.insert(hash, &value);
+    odb.commit();
+    BOOST_CHECK(odb.deepkill(hash));
+    BOOST_CHECK(!OnDisk(hash));
+    BOOST_CHECK(odb.lookup(hash).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
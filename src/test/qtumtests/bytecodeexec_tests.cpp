@@ -114,6 +114,17 @@ void checkBCEResult(ByteCodeExecResult result, uint64_t usedGas, CAmount refundS
     BOOST_CHECK(result.valueTransfers.size() == nTxs);
 }
 
+std::vector<ResultExecute> executeCalls(const std::vector<QtumTransaction>& txsCreate, const std::vector<QtumTransaction>& txsCall, bool oneByOne){
+    initState();
+    executeBC(txsCreate);
+    if(!oneByOne)
+        return executeBC(txsCall).first;
+    std::vector<ResultExecute> result;
+    for(const QtumTransaction& tx : txsCall)
+        result.push_back(executeBC(std::vector<QtumTransaction>(1, tx)).first[0]);
+    return result;
+}
+
 BOOST_FIXTURE_TEST_SUITE(bytecodeexec_tests, TestingSetup)
 
 BOOST_AUTO_TEST_CASE(bytecodeexec_txs_empty){
@@ -374,4 +385,46 @@ BOOST_AUTO_TEST_CASE(bytecodeexec_contract_create_contracts){
     BOOST_CHECK(result.second.valueTransfers.size() == 0);
 }
 
+BOOST_AUTO_TEST_CASE(bytecodeexec_write_back_state_root){
+    std::vector<QtumTransaction> txsCreate;
+    std::vector<dev::Address> newAddresses;
+    dev::h256 hash(HASHTX);
+    for(size_t i = 0; i < 4; i++){
+        valtype code = i == 0 ? CODE[3] : CODE[4];
+        QtumTransaction txEthCreate = createQtumTransaction(code, 0, GASLIMIT, dev::u256(1), hash, dev::Address(), i);
+        txsCreate.push_back(txEthCreate);
+        newAddresses.push_back(createQtumAddress(txEthCreate.getHashWith(), txEthCreate.getNVout()));
+        if(i != 0)
+            txsCreate.push_back(createQtumTransaction(valtype(), 13, GASLIMIT, dev::u256(1), hash, newAddresses.back(), i));
+        ++hash;
+    }
+
+    // Storage writes to the same contract, suicides and value sent to a
+    // contract killed earlier in the block
+    std::vector<QtumTransaction> txsCall;
+    for(size_t i = 0; i < 5; i++)
+        txsCall.push_back(createQtumTransaction(valtype(ParseHex("3f811b80")), 0, GASLIMIT, dev::u256(1), HASHTX, newAddresses[0], i));
+    txsCall.push_back(createQtumTransaction(valtype(ParseHex("41c0e1b5")), 0, GASLIMIT, dev::u256(1), HASHTX, newAddresses[1], 5));
+    txsCall.push_back(createQtumTransaction(valtype(), 13, GASLIMIT, dev::u256(1), HASHTX, newAddresses[1], 6));
+    txsCall.push_back(createQtumTransaction(valtype(), 13, GASLIMIT, dev::u256(1), HASHTX, newAddresses[2], 7));
+    txsCall.push_back(createQtumTransaction(valtype(ParseHex("41c0e1b5")), 0, GASLIMIT, dev::u256(1), HASHTX, newAddresses[2], 8));
+    txsCall.push_back(createQtumTransaction(valtype(ParseHex("3f811b80")), 0, GASLIMIT, dev::u256(1), HASHTX, newAddresses[0], 9));
+
+    std::vector<ResultExecute> resultOneByOne = executeCalls(txsCreate, txsCall, true);
+    dev::h256 rootOneByOne = globalState->rootHash();
+    dev::h256 rootUTXOOneByOne = globalState->rootHashUTXO();
+
+    std::vector<ResultExecute> result = executeCalls(txsCreate, txsCall, false);
+    BOOST_CHECK(globalState->rootHash() == rootOneByOne);
+    BOOST_CHECK(globalState->rootHashUTXO() == rootUTXOOneByOne);
+    BOOST_CHECK(!globalState->addressInUse(newAddresses[1]));
+    BOOST_CHECK(!globalState->addressInUse(newAddresses[2]));
+    BOOST_CHECK(result.size() == resultOneByOne.size());
+    for(size_t i = 0; i < result.size(); i++){
+        BOOST_CHECK(result[i].execRes.excepted == resultOneByOne[i].execRes.excepted);
+        BOOST_CHECK(result[i].execRes.gasUsed == resultOneByOne[i].execRes.gasUsed);
+        BOOST_CHECK(result[i].tx.GetHash() == resultOneByOne[i].tx.GetHash());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
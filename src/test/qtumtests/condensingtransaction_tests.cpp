@@ -342,4 +342,39 @@ BOOST_AUTO_TEST_CASE(condensingtransactionpaytopubkeyhash_tests){
     BOOST_CHECK(result.second.valueTransfers[0].vout[1].scriptPubKey.HasOpCall());
 }
 
+BOOST_AUTO_TEST_CASE(condensingtransactionorder_tests){
+    initState();
+    // The transfers visit the addresses out of order, the inputs and outputs
+    // have to come out sorted by address every time the state is reused.
+    std::vector<dev::Address> addresses = {dev::Address("0000000000000000000000000000000000000003"),
+        dev::Address("0000000000000000000000000000000000000001"), dev::Address("0000000000000000000000000000000000000002")};
+    std::vector<dev::u256> values = {1000, 1000, 2000};
+    for(size_t i = 0; i < addresses.size(); i++){
+        globalState->setCacheUTXO(addresses[i], Vin{hash, (uint32_t)i, values[i], 1});
+    }
+    std::vector<TransferInfo> transfers = {{addresses[0], addresses[1], 600}, {addresses[1], addresses[2], 100}, {addresses[0], addresses[2], 400}};
+    QtumTransaction tx = createQtumTransaction(valtype(), 0, dev::u256(500000), dev::u256(1), hash, addresses[0]);
+    std::set<dev::Address> deleteAddresses;
+
+    for(size_t n = 0; n < 2; n++){
+        CondensingTX ctx(globalState.get(), transfers, tx, deleteAddresses);
+        CTransaction condensed(ctx.createCondensingTX());
+        checkTx(condensed, 3, 2, {1500, 2500});
+        BOOST_CHECK(condensed.vin[0].prevout.n == 1);
+        BOOST_CHECK(condensed.vin[1].prevout.n == 2);
+        BOOST_CHECK(condensed.vin[2].prevout.n == 0);
+
+        std::vector<std::pair<dev::Address, Vin>> vins = ctx.createVin(condensed);
+        BOOST_CHECK(vins.size() == 3);
+        BOOST_CHECK(vins[0].first == addresses[1] && vins[0].second.nVout == 0 && vins[0].second.value == 1500);
+        BOOST_CHECK(vins[1].first == addresses[2] && vins[1].second.nVout == 1 && vins[1].second.value == 2500);
+        BOOST_CHECK(vins[2].first == addresses[0] && vins[2].second.alive == 0);
+    }
+
+    std::vector<TransferInfo> overspend = {{addresses[1], addresses[0], 500}, {addresses[0], addresses[2], 5000}};
+    CondensingTX ctx(globalState.get(), overspend, tx, deleteAddresses);
+    CTransaction condensed(ctx.createCondensingTX());
+    BOOST_CHECK(condensed.vin.empty() && condensed.vout.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
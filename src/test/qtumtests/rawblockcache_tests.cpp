@@ -0,0 +1,131 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_bitcoin.h>
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <qtum/rawblockcache.h>
+#include <validation.h>
+
+namespace {
+CRawBlockCache::RawBlock MakeBlock(size_t size, unsigned char fill)
+{
+    return std::make_shared<const std::vector<unsigned char>>(size, fill);
+}
+
+uint256 Hash(unsigned char n)
+{
+    uint256 hash;
+    *hash.begin() = n;
+    return hash;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(rawblockcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(rawblockcache_lru)
+{
+    CRawBlockCache cache(300);
+    BOOST_CHECK(!cache.Get(Hash(1)));
+
+    cache.Insert(Hash(1), MakeBlock(100, 1));
+    cache.Insert(Hash(2), MakeBlock(100, 2));
+    cache.Insert(Hash(3), MakeBlock(100, 3));
+    BOOST_CHECK_EQUAL(cache.Size(), 3U);
+    BOOST_CHECK_EQUAL(cache.Bytes(), 300U);
+
+    // Block 1 becomes the most recently used, block 2 is evicted for block 4
+    CRawBlockCache::RawBlock block = cache.Get(Hash(1));
+    BOOST_REQUIRE(block);
+    BOOST_CHECK(*block == std::vector<unsigned char>(100, 1));
+    cache.Insert(Hash(4), MakeBlock(100, 4));
+    BOOST_CHECK(cache.Get(Hash(1)));
+    BOOST_CHECK(!cache.Get(Hash(2)));
+    BOOST_CHECK(cache.Get(Hash(3)));
+    BOOST_CHECK(cache.Get(Hash(4)));
+    BOOST_CHECK_EQUAL(cache.Bytes(), 300U);
+
+    // A large block evicts as many blocks as needed
+    cache.Insert(Hash(5), MakeBlock(250, 5));
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.Get(Hash(5)));
+
+    // Blocks larger than the cache are not added, duplicates are ignored
+    cache.Insert(Hash(6), MakeBlock(301, 6));
+    BOOST_CHECK(!cache.Get(Hash(6)));
+    cache.Insert(Hash(5), MakeBlock(10, 7));
+    BOOST_CHECK_EQUAL(cache.Bytes(), 250U);
+
+    cache.SetMaxBytes(0);
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    BOOST_CHECK_EQUAL(cache.Bytes(), 0U);
+    // A block handed out stays valid after its eviction
+    BOOST_CHECK(*block == std::vector<unsigned char>(100, 1));
+}
+
+BOOST_FIXTURE_TEST_CASE(rawblockcache_read_raw_block, TestingSetup)
+{
+    // A block with a witness, written to a block file of its own
+    CBlock block = Params().GenesisBlock();
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    mtx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(32, 1));
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = CENT;
+    mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(MakeTransactionRef(mtx));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    const CMessageHeader::MessageStartChars& messageStart = Params().MessageStart();
+    CDiskBlockPos pos(1, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(block, pos, messageStart));
+    const uint256 hash = block.GetHash();
+    CBlockIndex index(block.GetBlockHeader());
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus |= BLOCK_HAVE_DATA;
+
+    // The bytes read are the network serialization of the block with witness
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    const std::vector<unsigned char> vchExpected(ss.begin(), ss.end());
+    BOOST_CHECK(vchExpected.size() > ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    std::vector<unsigned char> vchBlock;
+    BOOST_REQUIRE(ReadRawBlockFromDisk(vchBlock, &index, messageStart));
+    BOOST_CHECK(vchBlock == vchExpected);
+
+    // Another network magic
+    CMessageHeader::MessageStartChars otherStart;
+    memcpy(otherStart, messageStart, CMessageHeader::MESSAGE_START_SIZE);
+    otherStart[0] ^= 0xff;
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, &index, otherStart));
+
+    // A block stored while the DGP allowed larger blocks than it does now
+    const unsigned int nMaxBlockSerSize = dgpMaxBlockSerSize;
+    dgpMaxBlockSerSize = vchExpected.size() - 1;
+    vchBlock.clear();
+    BOOST_CHECK(ReadRawBlockFromDisk(vchBlock, &index, messageStart));
+    BOOST_CHECK(vchBlock == vchExpected);
+    dgpMaxBlockSerSize = nMaxBlockSerSize;
+
+    // A size over the largest block the DGP can allow
+    CDiskBlockPos posOversized(2, 0);
+    {
+        CAutoFile fileout(OpenBlockFile(posOversized), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!fileout.IsNull());
+        fileout << FLATDATA(messageStart) << (unsigned int)(MAX_STORED_BLOCK_SER_SIZE + 1) << block;
+    }
+    CBlockIndex indexOversized(block.GetBlockHeader());
+    indexOversized.phashBlock = &hash;
+    indexOversized.nFile = posOversized.nFile;
+    indexOversized.nDataPos = 8;
+    indexOversized.nStatus |= BLOCK_HAVE_DATA;
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, &indexOversized, messageStart));
+
+    // A block that is not the one of the index
+    const uint256 hashOther = InsecureRand256();
+    index.phashBlock = &hashOther;
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, &index, messageStart));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
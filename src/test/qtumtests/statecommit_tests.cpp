@@ -0,0 +1,108 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_bitcoin.h>
+#include <libethereum/State.h>
+
+namespace {
+
+/** The same state trie committed serially and with the storage tries updated concurrently */
+struct CommitPair
+{
+    dev::OverlayDB dbSerial;
+    dev::OverlayDB dbConcurrent;
+    dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> serial;
+    dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> concurrent;
+
+    CommitPair() : serial(&dbSerial), concurrent(&dbConcurrent)
+    {
+        serial.init();
+        concurrent.init();
+    }
+
+    size_t Commit(const dev::eth::AccountMap& accounts, unsigned threads)
+    {
+        dev::eth::commit(accounts, serial);
+        dev::eth::StorageUpdates updates = dev::eth::updateStorageTries(accounts, dbConcurrent, threads);
+        dev::eth::commit(accounts, concurrent, nullptr, &updates);
+        return updates.size();
+    }
+
+    void Check()
+    {
+        BOOST_CHECK(serial.root() == concurrent.root());
+        // Same nodes with the same reference counts
+        BOOST_CHECK(dbSerial.get() == dbConcurrent.get());
+        BOOST_CHECK(dbSerial.keys() == dbConcurrent.keys());
+    }
+};
+
+dev::eth::Account StoredAccount(const dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB>& state, const dev::Address& addr)
+{
+    std::string value = state.at(addr);
+    dev::RLP rlp(value);
+    return dev::eth::Account(rlp[0].toInt<dev::u256>(), rlp[1].toInt<dev::u256>(), rlp[2].toHash<dev::h256>(), rlp[3].toHash<dev::h256>(), dev::eth::Account::Changed);
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(statecommit_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(statecommit_concurrent_storage_tries){
+    CommitPair tries;
+    dev::eth::AccountMap accounts;
+    for (unsigned i = 1; i <= 6; i++) {
+        dev::eth::Account& account = accounts[dev::Address(i)] = dev::eth::Account(0, i);
+        for (unsigned j = 0; j < 60 * i; j++)
+            account.setStorage(j, j * i + 1);
+    }
+    accounts[dev::Address(7)] = dev::eth::Account(1, 7);
+    BOOST_CHECK_EQUAL(tries.Commit(accounts, 4), 6);
+    tries.Check();
+
+    // Change, clear and add slots of the stored accounts
+    accounts.clear();
+    for (unsigned i = 1; i <= 6; i++) {
+        dev::eth::Account& account = accounts[dev::Address(i)] = StoredAccount(tries.serial, dev::Address(i));
+        for (unsigned j = 0; j < 60 * i; j += 3)
+            account.setStorage(j, j % 2 ? 0 : j);
+        account.setStorage(1000 + i, 1);
+    }
+    BOOST_CHECK_EQUAL(tries.Commit(accounts, 3), 6);
+    tries.Check();
+
+    // Clearing all the slots of an account leaves it with the empty trie
+    accounts.clear();
+    dev::eth::Account& account = accounts[dev::Address(6)] = StoredAccount(tries.serial, dev::Address(6));
+    for (unsigned j = 0; j < 360; j++)
+        account.setStorage(j, 0);
+    account.setStorage(1006, 0);
+    accounts[dev::Address(5)] = StoredAccount(tries.serial, dev::Address(5));
+    accounts[dev::Address(5)].setStorage(1005, 2);
+    BOOST_CHECK_EQUAL(tries.Commit(accounts, 2), 2);
+    tries.Check();
+    std::string value = tries.concurrent.at(dev::Address(6));
+    BOOST_CHECK(dev::RLP(value)[2].toHash<dev::h256>() == dev::EmptyTrie);
+}
+
+BOOST_AUTO_TEST_CASE(statecommit_small_batches_are_serial){
+    CommitPair tries;
+    dev::eth::AccountMap accounts;
+    for (unsigned i = 1; i <= 2; i++) {
+        dev::eth::Account& account = accounts[dev::Address(i)] = dev::eth::Account(0, i);
+        for (unsigned j = 0; j < 100; j++)
+            account.setStorage(j, j + 1);
+    }
+
+    // Too few slots, too few storage tries or a single thread
+    BOOST_CHECK_EQUAL(tries.Commit(accounts, 4), 0);
+    accounts.erase(dev::Address(2));
+    for (unsigned j = 100; j < dev::eth::c_minConcurrentStorageSlots; j++)
+        accounts[dev::Address(1)].setStorage(j, j + 1);
+    BOOST_CHECK_EQUAL(tries.Commit(accounts, 4), 0);
+    accounts[dev::Address(2)] = dev::eth::Account(0, 2);
+    accounts[dev::Address(2)].setStorage(1, 1);
+    BOOST_CHECK_EQUAL(tries.Commit(accounts, 1), 0);
+    BOOST_CHECK_EQUAL(tries.Commit(accounts, 2), 2);
+    tries.Check();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
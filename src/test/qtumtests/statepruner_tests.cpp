@@ -0,0 +1,101 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_bitcoin.h>
+#include <qtumtests/test_utils.h>
+#include <qtum/statepruner.h>
+
+/*
+    contract store {
+        // slot 0 counts the slots written so far, calldata holds n
+        function () {
+            for (uint256 i = slot[0] + 1; i <= slot[0] + n; i++)
+                slot[i] = i;
+            slot[0] += n;
+        }
+    }
+*/
+static const valtype STORE_CODE = valtype(ParseHex("6100228061000d6000396000f36000546000358101905b8181101561001c57600101808055610009565b5060005500"));
+
+static dev::h256 PRUNE_HASHTX = dev::h256(ParseHex("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"));
+
+BOOST_FIXTURE_TEST_SUITE(statepruner_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(statepruner_keeps_current_state){
+    initState();
+    dev::h256 hash(PRUNE_HASHTX);
+    QtumTransaction txCreate = createQtumTransaction(STORE_CODE, 0, dev::u256(500000), dev::u256(1), hash, dev::Address());
+    auto result = executeBC({txCreate});
+    dev::Address store = result.first[0].execRes.newAddress;
+    BOOST_CHECK(globalState->addressInUse(store));
+
+    // Every call writes new slots and updates slot 0, leaving old nodes behind
+    for (int i = 0; i < 5; i++) {
+        valtype data = dev::toBigEndian(dev::u256(8));
+        executeBC({createQtumTransaction(data, 0, dev::u256(500000), dev::u256(1), ++hash, store)});
+    }
+    dev::h256 hashStateRoot = globalState->rootHash();
+    dev::h256 hashUTXORoot = globalState->rootHashUTXO();
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storage = globalState->storage(store);
+    BOOST_CHECK_EQUAL(storage.size(), 41);
+
+    nStatePruneDepth = 1;
+    BOOST_CHECK(PruneState() > 0);
+    BOOST_CHECK(fHavePrunedState);
+
+    // The state at the current roots is still complete
+    globalState->setRoot(hashStateRoot);
+    globalState->setRootUTXO(hashUTXORoot);
+    BOOST_CHECK(globalState->addressInUse(store));
+    BOOST_CHECK(globalState->storage(store) == storage);
+    BOOST_CHECK(globalState->code(store).size() > 0);
+
+    // Nothing is left to delete, and execution goes on from the pruned state
+    BOOST_CHECK_EQUAL(PruneState(), 0);
+    executeBC({createQtumTransaction(dev::toBigEndian(dev::u256(8)), 0, dev::u256(500000), dev::u256(1), ++hash, store)});
+    BOOST_CHECK_EQUAL(globalState->storage(store).size(), 49);
+
+    nStatePruneDepth = 0;
+    fHavePrunedState = false;
+}
+
+BOOST_FIXTURE_TEST_CASE(statepruner_keeps_flushed_state, TestChain100Setup){
+    initState();
+    dev::h256 hash(PRUNE_HASHTX);
+    QtumTransaction txCreate = createQtumTransaction(STORE_CODE, 0, dev::u256(500000), dev::u256(1), hash, dev::Address());
+    dev::Address store = executeBC({txCreate}).first[0].execRes.newAddress;
+    executeBC({createQtumTransaction(dev::toBigEndian(dev::u256(8)), 0, dev::u256(500000), dev::u256(1), ++hash, store)});
+    dev::h256 hashStateRootFlushed = globalState->rootHash();
+    dev::h256 hashUTXORootFlushed = globalState->rootHashUTXO();
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storageFlushed = globalState->storage(store);
+    BOOST_CHECK_EQUAL(storageFlushed.size(), 9);
+
+    // The coins were last flushed at a block far more than the prune depth behind the tip
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexFlushed = chainActive[chainActive.Height() - 50];
+        pindexFlushed->hashStateRoot = h256Touint(hashStateRootFlushed);
+        pindexFlushed->hashUTXORoot = h256Touint(hashUTXORootFlushed);
+        CCoinsMap mapCoins;
+        BOOST_CHECK(pcoinsdbview->BatchWrite(mapCoins, pindexFlushed->GetBlockHash()));
+    }
+    for (int i = 0; i < 5; i++)
+        executeBC({createQtumTransaction(dev::toBigEndian(dev::u256(8)), 0, dev::u256(500000), dev::u256(1), ++hash, store)});
+    dev::h256 hashStateRoot = globalState->rootHash();
+    dev::h256 hashUTXORoot = globalState->rootHashUTXO();
+
+    nStatePruneDepth = 1;
+    BOOST_CHECK(PruneState() > 0);
+
+    // The state the node would restart from is still complete
+    globalState->setRoot(hashStateRootFlushed);
+    globalState->setRootUTXO(hashUTXORootFlushed);
+    BOOST_CHECK(globalState->storage(store) == storageFlushed);
+    BOOST_CHECK(globalState->code(store).size() > 0);
+    globalState->setRoot(hashStateRoot);
+    globalState->setRootUTXO(hashUTXORoot);
+    BOOST_CHECK_EQUAL(globalState->storage(store).size(), 49);
+
+    nStatePruneDepth = 0;
+    fHavePrunedState = false;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_bitcoin.h>
+#include <qtumtests/test_utils.h>
+#include <libethereum/StateSnapshot.h>
+
+/*
+    contract store {
+        // slot 0 counts the slots written so far, calldata holds n
+        function () {
+            for (uint256 i = slot[0] + 1; i <= slot[0] + n; i++)
+                slot[i] = i;
+            slot[0] += n;
+        }
+    }
+*/
+static const valtype STORE_CODE = valtype(ParseHex("6100228061000d6000396000f36000546000358101905b8181101561001c57600101808055610009565b5060005500"));
+
+static dev::h256 SNAPSHOT_HASHTX = dev::h256(ParseHex("cccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccc"));
+
+static void CheckSnapshotStorage(dev::eth::StateSnapshot& snapshot, const dev::Address& addr)
+{
+    dev::h256 root = globalState->rootHash();
+    for (const auto& slot : globalState->storage(addr)) {
+        dev::u256 value;
+        BOOST_CHECK(snapshot.storage(root, addr, slot.second.first, value));
+        BOOST_CHECK(value == slot.second.second);
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(statesnapshot_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(statesnapshot_follows_state){
+    initState();
+    fs::path pathSnapshot = GetDataDir() / "snapshot";
+    std::shared_ptr<dev::eth::StateSnapshot> snapshot = std::make_shared<dev::eth::StateSnapshot>(pathSnapshot.string());
+    globalState->setSnapshot(snapshot);
+    UpdateStateSnapshot();
+    BOOST_CHECK(snapshot->diskRoot() == globalState->rootHash());
+
+    dev::h256 hash(SNAPSHOT_HASHTX);
+    auto result = executeBC({createQtumTransaction(STORE_CODE, 0, dev::u256(500000), dev::u256(1), hash, dev::Address())});
+    dev::Address store = result.first[0].execRes.newAddress;
+    UpdateStateSnapshot();
+
+    // Every call adds a diff layer, reads go through the snapshot
+    std::vector<dev::h256> roots;
+    for (int i = 0; i < 5; i++) {
+        executeBC({createQtumTransaction(dev::toBigEndian(dev::u256(8)), 0, dev::u256(500000), dev::u256(1), ++hash, store)});
+        UpdateStateSnapshot();
+        roots.push_back(globalState->rootHash());
+        BOOST_CHECK(snapshot->knows(roots.back()));
+        BOOST_CHECK(globalState->storage(store, 0) == 8 * (i + 1));
+    }
+    dev::eth::StateSnapshot::Stats stats = snapshot->stats();
+    BOOST_CHECK_EQUAL(stats.layers, 6);
+    BOOST_CHECK(stats.hits > 0);
+    CheckSnapshotStorage(*snapshot, store);
+
+    std::string account;
+    BOOST_CHECK(!snapshot->account(dev::h256(42), store, account));
+    BOOST_CHECK(snapshot->account(globalState->rootHash(), dev::Address(42), account) && account.empty());
+
+    // Building on an earlier root drops the abandoned layers
+    globalState->setRoot(roots[2]);
+    BOOST_CHECK(globalState->storage(store, 0) == 24);
+    executeBC({createQtumTransaction(dev::toBigEndian(dev::u256(1)), 0, dev::u256(500000), dev::u256(1), ++hash, store)});
+    UpdateStateSnapshot();
+    BOOST_CHECK_EQUAL(snapshot->stats().layers, 5);
+    BOOST_CHECK(!snapshot->knows(roots[4]));
+    BOOST_CHECK(globalState->storage(store, 0) == 25);
+    CheckSnapshotStorage(*snapshot, store);
+
+    // Older layers are flattened into the disk layer, which is kept across restarts
+    dev::h256 root = globalState->rootHash();
+    BOOST_CHECK(snapshot->cap(root, 2));
+    BOOST_CHECK_EQUAL(snapshot->stats().layers, 2);
+    BOOST_CHECK(!snapshot->knows(roots[0]));
+    CheckSnapshotStorage(*snapshot, store);
+    BOOST_CHECK(snapshot->cap(root, 0));
+    BOOST_CHECK(snapshot->diskRoot() == root);
+
+    globalState->setSnapshot(nullptr);
+    snapshot.reset();
+    snapshot = std::make_shared<dev::eth::StateSnapshot>(pathSnapshot.string());
+    BOOST_CHECK(snapshot->diskRoot() == root);
+    CheckSnapshotStorage(*snapshot, store);
+    BOOST_CHECK(snapshot->account(root, store, account) && !account.empty());
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_generate){
+    initState();
+    dev::h256 hash(SNAPSHOT_HASHTX);
+    auto result = executeBC({createQtumTransaction(STORE_CODE, 0, dev::u256(500000), dev::u256(1), hash, dev::Address())});
+    dev::Address store = result.first[0].execRes.newAddress;
+    executeBC({createQtumTransaction(dev::toBigEndian(dev::u256(8)), 0, dev::u256(500000), dev::u256(1), ++hash, store)});
+
+    // A snapshot that does not know the current root is regenerated from the trie
+    std::shared_ptr<dev::eth::StateSnapshot> snapshot = std::make_shared<dev::eth::StateSnapshot>((GetDataDir() / "snapshot").string());
+    BOOST_CHECK(!snapshot->knows(globalState->rootHash()));
+    globalState->setSnapshot(snapshot);
+    UpdateStateSnapshot();
+    BOOST_CHECK(snapshot->diskRoot() == globalState->rootHash());
+    BOOST_CHECK_EQUAL(snapshot->stats().layers, 0);
+    CheckSnapshotStorage(*snapshot, store);
+    BOOST_CHECK(globalState->storage(store, 0) == 8);
+
+    globalState->setSnapshot(nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_bitcoin.h>
+
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/SHA3.h>
+#include <libdevcore/TrieNodeCache.h>
+#include <leveldb/db.h>
+#include <leveldb/env.h>
+#include <memenv.h>
+
+// Restores the size of the process wide cache when a test is done
+struct TrieNodeCacheSetup : public BasicTestingSetup
+{
+    TrieNodeCacheSetup() : prevMaxSize(dev::TrieNodeCache::instance().stats().maxSize) {
+        dev::TrieNodeCache::instance().clear();
+    }
+    ~TrieNodeCacheSetup() {
+        dev::TrieNodeCache::instance().clear();
+        dev::TrieNodeCache::instance().setMaxSize(prevMaxSize);
+    }
+    size_t prevMaxSize;
+};
+
+static std::string NodeValue(int n)
+{
+    return std::string(100, (char)n);
+}
+
+BOOST_FIXTURE_TEST_SUITE(trienodecache_tests, TrieNodeCacheSetup)
+
+BOOST_AUTO_TEST_CASE(trienodecache_lru){
+    dev::TrieNodeCache cache;
+    std::string value;
+
+    // Disabled until it has a size
+    cache.insert(dev::h256(1), NodeValue(1));
+    BOOST_CHECK(!cache.lookup(dev::h256(1), value));
+    BOOST_CHECK_EQUAL(cache.stats().entries, 0);
+
+    cache.setMaxSize(1000);
+    for (int i = 1; i <= 100; i++)
+        cache.insert(dev::h256(i), NodeValue(i));
+    dev::TrieNodeCache::Stats stats = cache.stats();
+    BOOST_CHECK(stats.entries > 0 && stats.entries < 10);
+    BOOST_CHECK(stats.usage <= stats.maxSize);
+
+    // The most recent entries are kept
+    BOOST_CHECK(cache.lookup(dev::h256(100), value));
+    BOOST_CHECK(value == NodeValue(100));
+    BOOST_CHECK(!cache.lookup(dev::h256(1), value));
+
+    // A hit makes the entry the most recently used one
+    size_t entries = stats.entries;
+    int oldest = 100 - entries + 1;
+    BOOST_CHECK(cache.lookup(dev::h256(oldest), value));
+    cache.insert(dev::h256(101), NodeValue(101));
+    BOOST_CHECK(cache.lookup(dev::h256(oldest), value));
+    BOOST_CHECK(!cache.lookup(dev::h256(oldest + 1), value));
+
+    stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits, 3);
+    BOOST_CHECK_EQUAL(stats.misses, 2);
+
+    cache.erase(dev::h256(101));
+    BOOST_CHECK(!cache.lookup(dev::h256(101), value));
+    BOOST_CHECK_EQUAL(cache.stats().entries, entries - 1);
+
+    cache.setMaxSize(0);
+    stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.entries, 0);
+    BOOST_CHECK_EQUAL(stats.usage, 0);
+}
+
+BOOST_AUTO_TEST_CASE(trienodecache_overlaydb){
+    std::unique_ptr<leveldb::Env> env(leveldb::NewMemEnv(leveldb::Env::Default()));
+    leveldb::Options options;
+    options.create_if_missing = true;
+    options.env = env.get();
+    leveldb::DB* pdb = nullptr;
+    BOOST_CHECK(leveldb::DB::Open(options, "/state", &pdb).ok());
+
+    dev::TrieNodeCache& cache = dev::TrieNodeCache::instance();
+    cache.setMaxSize(1 << 20);
+    dev::OverlayDB odb(pdb);
+
+    std::vector<dev::h256> hashes;
+    for (int i = 0; i < 10; i++) {
+        std::string value = NodeValue(i);
+        hashes.push_back(dev::sha3(value));
+        odb.insert(hashes.back(), &value);
+    }
+    odb.commit();
+    BOOST_CHECK_EQUAL(cache.stats().entries, hashes.size());
+
+    // Committed nodes are served by the cache
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK(odb.lookup(hashes[i]) == NodeValue(i));
+    BOOST_CHECK_EQUAL(cache.stats().hits, hashes.size());
+
+    // Nodes read from disk are added
+    cache.clear();
+    BOOST_CHECK(odb.lookup(hashes[0]) == NodeValue(0));
+    BOOST_CHECK(odb.lookup(hashes[0]) == NodeValue(0));
+    dev::TrieNodeCache::Stats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.misses, 1);
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+
+    // Unknown nodes are not cached
+    BOOST_CHECK(odb.lookup(dev::h256(42)).empty());
+    BOOST_CHECK_EQUAL(cache.stats().entries, 1);
+
+    // Deleting a node from disk drops it from the cache
+    BOOST_CHECK(odb.deepkill(hashes[0]));
+    BOOST_CHECK(odb.lookup(hashes[0]).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -155,6 +155,10 @@ BOOST_AUTO_TEST_CASE(sighash_test)
         std::cout << "\n";
         #endif
         BOOST_CHECK(sh == sho);
+        // Resuming from the precomputed midstates gives the same hash
+        const CTransaction tx(txTo);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata) == sho);
     }
     #if defined(PRINT_SIGHASH_JSON)
     std::cout << "]\n";
@@ -206,6 +210,33 @@ BOOST_AUTO_TEST_CASE(sighash_from_data)
 
         sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SIGVERSION_BASE);
         BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+        PrecomputedTransactionData txdata(*tx);
+        sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata);
+        BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sighash_legacy_midstates)
+{
+    // Enough inputs for the midstates to be kept every few inputs only
+    CMutableTransaction txTo;
+    RandomTransaction(txTo, false);
+    txTo.vin.resize(MAX_LEGACY_SIGHASH_MIDSTATES * 3 + 5);
+    for (CTxIn& txin : txTo.vin) {
+        txin.prevout.hash = InsecureRand256();
+        txin.prevout.n = InsecureRandBits(2);
+        txin.nSequence = InsecureRand32();
+    }
+    const CTransaction tx(txTo);
+    PrecomputedTransactionData txdata(tx);
+    BOOST_CHECK_EQUAL(txdata.nLegacyStride, 4U);
+    BOOST_CHECK_EQUAL(txdata.legacyMidstates.size(), (tx.vin.size() + 3) / 4);
+
+    for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        int nHashType = InsecureRand32();
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata) == SignatureHashOld(scriptCode, tx, nIn, nHashType));
     }
 }
 BOOST_AUTO_TEST_SUITE_END()
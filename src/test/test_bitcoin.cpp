@@ -8,6 +8,7 @@
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <libdevcore/SHA3.h>
 #include <miner.h>
 #include <net_processing.h>
 #include <ui_interface.h>
@@ -41,6 +42,7 @@ extern void noui_connect();
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
         SHA256AutoDetect();
+        dev::sha3AutoDetect();
         RandomInit();
         ECC_Start();
         SetupEnvironment();
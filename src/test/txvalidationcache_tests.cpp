@@ -19,7 +19,7 @@
 
 #include <boost/test/unit_test.hpp>
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, const PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks);
 
 BOOST_AUTO_TEST_SUITE(tx_validationcache_tests)
 
@@ -368,4 +368,53 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(precheck_relayed_tx, TestChain100Setup)
+{
+    // Relayed transactions pre-verified into the script execution cache are
+    // not verified again by AcceptToMemoryPool.
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    std::vector<CMutableTransaction> spends(2);
+    for (int i = 0; i < 2; i++)
+    {
+        spends[i].nVersion = 1;
+        spends[i].vin.resize(1);
+        spends[i].vin[0].prevout.hash = coinbaseTxns[i].GetHash();
+        spends[i].vin[0].prevout.n = 0;
+        spends[i].vout.resize(1);
+        spends[i].vout[0].nValue = 11*CENT;
+        spends[i].vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spends[i], 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spends[i].vin[0].scriptSig << vchSig;
+    }
+    // Invalidate the signature of the second spend
+    spends[1].vout[0].nValue = 12*CENT;
+
+    std::vector<CTransactionRef> vtx = {MakeTransactionRef(spends[0]), MakeTransactionRef(spends[1])};
+    BOOST_CHECK_EQUAL(PreCheckTransactions(vtx), 2);
+
+    LOCK(cs_main);
+    for (int i = 0; i < 2; i++)
+    {
+        CValidationState state;
+        PrecomputedTransactionData txdata(*vtx[i]);
+        std::vector<CScriptCheck> scriptchecks;
+        BOOST_CHECK(CheckInputs(*vtx[i], state, pcoinsTip.get(), true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdata, &scriptchecks));
+        // Only the invalid spend is left to verify
+        BOOST_CHECK_EQUAL(scriptchecks.size(), i == 0 ? 0 : 1);
+    }
+
+    // Transactions already in the mempool are skipped
+    BOOST_CHECK(ToMemPool(spends[0]));
+    BOOST_CHECK_EQUAL(PreCheckTransactions({vtx[0]}), 0);
+    // The signature hash data is kept for block validation
+    std::shared_ptr<const PrecomputedTransactionData> txdata = mempool.GetTxData(vtx[0]->GetHash());
+    BOOST_CHECK(txdata && txdata->legacyMidstates.empty());
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -41,6 +41,18 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -statedbcache default (MiB), shared by the contract state databases
+static const int64_t nDefaultStateDbCache = 32;
+//! -statedbbloombits default
+static const int nDefaultStateDbBloomBits = 10;
+//! max. -statedbbloombits
+static const int nMaxStateDbBloomBits = 32;
+//! -statedbwritebuffer default (MiB), per contract state database
+static const int64_t nDefaultStateDbWriteBuffer = 4;
+//! -statetriecache default (MiB), shared by the contract state databases
+static const int64_t nDefaultStateTrieCache = 32;
+//! -asyncstatecommit default
+static const bool DEFAULT_ASYNC_STATE_COMMIT = true;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -12,6 +12,7 @@
 #include <policy/policy.h>
 #include <policy/fees.h>
 #include <reverse_iterator.h>
+#include <script/interpreter.h>
 #include <streams.h>
 #include <timedata.h>
 #include <util.h>
@@ -40,6 +41,15 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
     nSigOpCostWithAncestors = sigOpCost;
 }
 
+void CTxMemPoolEntry::SetTxData(const std::shared_ptr<const PrecomputedTransactionData>& txdataIn)
+{
+    if (txdata)
+        nUsageSize -= memusage::DynamicUsage(txdata) + memusage::DynamicUsage(txdata->legacyMidstates);
+    txdata = txdataIn;
+    if (txdata)
+        nUsageSize += memusage::DynamicUsage(txdata) + memusage::DynamicUsage(txdata->legacyMidstates);
+}
+
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
 {
     nModFeesWithDescendants += newFeeDelta - feeDelta;
@@ -838,6 +848,15 @@ CTransactionRef CTxMemPool::get(const uint256& hash) const
     return i->GetSharedTx();
 }
 
+std::shared_ptr<const PrecomputedTransactionData> CTxMemPool::GetTxData(const uint256& hash) const
+{
+    LOCK(cs);
+    indexed_transaction_set::const_iterator i = mapTx.find(hash);
+    if (i == mapTx.end())
+        return nullptr;
+    return i->GetTxData();
+}
+
 TxMempoolInfo CTxMemPool::info(const uint256& hash) const
 {
     LOCK(cs);
@@ -29,6 +29,7 @@
 #include <boost/signals2/signal.hpp>
 
 class CBlockIndex;
+struct PrecomputedTransactionData;
 
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const uint32_t MEMPOOL_HEIGHT = 0x0FFFFFFF;
@@ -76,6 +77,7 @@ private:
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
     CAmount nMinGasPrice;      //!< The minimum gas price among the contract outputs of the tx
+    std::shared_ptr<const PrecomputedTransactionData> txdata; //!< Signature hash data computed when accepting the tx, reused by block validation
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -108,6 +110,10 @@ public:
     size_t DynamicMemoryUsage() const { return nUsageSize; }
     const LockPoints& GetLockPoints() const { return lockPoints; }
     const CAmount& GetMinGasPrice() const { return nMinGasPrice; }
+    const std::shared_ptr<const PrecomputedTransactionData>& GetTxData() const { return txdata; }
+
+    // Keeps the signature hash data of the tx, before the entry is added to the mempool
+    void SetTxData(const std::shared_ptr<const PrecomputedTransactionData>& txdataIn);
 
     // Adjusts the descendant state.
     void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
@@ -719,6 +725,8 @@ public:
     }
 
     CTransactionRef get(const uint256& hash) const;
+    /** The signature hash data of the tx with txid hash computed on acceptance, nullptr if there is none */
+    std::shared_ptr<const PrecomputedTransactionData> GetTxData(const uint256& hash) const;
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
@@ -195,7 +195,7 @@ public:
 
     bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock);
 
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fPreChecked = false);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock);
 
     // Block (dis)connection on a given view:
@@ -254,7 +254,8 @@ private:
 
 
 
-CCriticalSection cs_main;
+// Timed, so the time it is held for can be attributed to the messages processed
+CCriticalSection cs_main(true);
 
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
 std::set<std::pair<COutPoint, unsigned int>>& setStakeSeen = g_chainstate.setStakeSeen;
@@ -264,12 +265,18 @@ CBlockIndex *pindexBestHeader = nullptr;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nCoinPrefetchThreads = 0;
+int nTxPreCheckThreads = 0;
+int64_t nTxPreCheckWindow = DEFAULT_TXPRECHECK_WINDOW;
+int nHeaderCheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fTxIndex = true;	// for ssgen check must set fTxIndex true
 bool fLogEvents = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
+bool fHavePrunedState = false;
+unsigned int nStatePruneDepth = 0;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
@@ -356,7 +363,7 @@ static int GetWitnessCommitmentIndex(const CBlock& block);
 static bool FlushStateToDisk(const CChainParams& chainParams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight=0);
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, const PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -571,10 +578,20 @@ void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool, bool f
     LimitMempoolSize(mempool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
 }
 
+/** Script verification flags of the transactions accepted to the mempool */
+static unsigned int GetMempoolScriptFlags(const CChainParams& chainparams)
+{
+    unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
+    if (!chainparams.RequireStandard()) {
+        scriptVerifyFlags = gArgs.GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
+    }
+    return scriptVerifyFlags;
+}
+
 // Used to avoid mempool polluting consensus critical paths if CCoinsViewMempool
 // were somehow broken and returning the wrong scriptPubKeys
 static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &view, CTxMemPool& pool,
-                 unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata) {
+                 unsigned int flags, bool cacheSigStore, const PrecomputedTransactionData& txdata) {
     AssertLockHeld(cs_main);
 
     // pool.cs should be locked already, but go ahead and re-take the lock here
@@ -614,7 +631,7 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
 
 static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool rawTx)
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool rawTx, bool fPreChecked)
 {
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
@@ -625,16 +642,21 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         *pfMissingInputs = false;
     }
 
-    if (!CheckTransaction(tx, state))
-        return false; // state filled in by CheckTransaction
+    // The message workers run the checks that do not depend on the chain ahead of time
+    if (!fPreChecked) {
+        if (!CheckTransaction(tx, state))
+            return false; // state filled in by CheckTransaction
 
-    // Coinbase is only valid in a block, not as a loose transaction
-    if (tx.IsCoinBase())
-        return state.DoS(100, false, REJECT_INVALID, "coinbase");
+        // Coinbase is only valid in a block, not as a loose transaction
+        if (tx.IsCoinBase())
+            return state.DoS(100, false, REJECT_INVALID, "coinbase");
 
-    // ppcoin: coinstake is also only valid in a block, not as a loose transaction
-    if (tx.IsCoinStake())
-        return state.DoS(100, false, REJECT_INVALID, "coinstake");
+        // ppcoin: coinstake is also only valid in a block, not as a loose transaction
+        if (tx.IsCoinStake())
+            return state.DoS(100, false, REJECT_INVALID, "coinstake");
+    } else if (!CheckTransactionBlockWeight(tx, state)) {
+        return false;
+    }
 
     // Reject transactions with witness before segregated witness activates (override with -prematurewitness)
     bool witnessEnabled = IsWitnessEnabled(chainActive.Tip(), chainparams.GetConsensus());
@@ -1062,14 +1084,12 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             }
         }
 
-        unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
-        if (!chainparams.RequireStandard()) {
-            scriptVerifyFlags = gArgs.GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
-        }
+        unsigned int scriptVerifyFlags = GetMempoolScriptFlags(chainparams);
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        PrecomputedTransactionData txdata(tx);
+        std::shared_ptr<const PrecomputedTransactionData> ptxdata = std::make_shared<const PrecomputedTransactionData>(tx);
+        const PrecomputedTransactionData& txdata = *ptxdata;
         if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
@@ -1137,7 +1157,8 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // - the transaction is not dependent on any other transactions in the mempool
         bool validForFeeEstimation = !fReplacementTransaction && !bypass_limits && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
 
-        // Store transaction in memory
+        // Store transaction in memory, with its signature hash data for block validation
+        entry.SetTxData(ptxdata);
         pool.addUnchecked(hash, entry, setAncestors, validForFeeEstimation);
 
         // trim mempool and check if tx was trimmed
@@ -1156,10 +1177,10 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 /** (try to) add transaction to memory pool with a specified acceptance time **/
 static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                        bool bypass_limits, const CAmount nAbsurdFee, bool rawTx = false)
+                        bool bypass_limits, const CAmount nAbsurdFee, bool rawTx = false, bool fPreChecked = false)
 {
     std::vector<COutPoint> coins_to_uncache;
-    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, rawTx);
+    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, rawTx, fPreChecked);
     if (!res) {
         for (const COutPoint& hashTx : coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
@@ -1185,10 +1206,10 @@ bool IsConfirmedInNPrevBlocks(const CDiskTxPos& txindex, const CBlockIndex* pind
 
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
-                        bool bypass_limits, const CAmount nAbsurdFee, bool rawTx)
+                        bool bypass_limits, const CAmount nAbsurdFee, bool rawTx, bool fPreChecked)
 {
     const CChainParams& chainparams = Params();
-    return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee, rawTx);
+    return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee, rawTx, fPreChecked);
 }
 
 /**
@@ -1310,7 +1331,7 @@ bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensu
 // CBlock and CBlockIndex
 //
 
-static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
@@ -1376,6 +1397,52 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = pindex->GetBlockPos();
+    }
+    if (pos.nPos < 8)
+        return error("%s: Invalid block position %s", __func__, pos.ToString());
+
+    // Open history file at the index header written by WriteBlockToDisk
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+        filein >> FLATDATA(blk_start) >> blk_size;
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE) != 0)
+            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                    HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
+                    HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+        if (blk_size > MAX_STORED_BLOCK_SER_SIZE)
+            return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
+                    blk_size, MAX_STORED_BLOCK_SER_SIZE);
+
+        // Check that the block is the one of the index from its header, then rewind to read it whole
+        CBlockHeader header;
+        filein >> header;
+        if (header.GetHash() != pindex->GetBlockHash())
+            return error("%s: GetHash() doesn't match index for %s at %s", __func__, pindex->ToString(), pos.ToString());
+        if (fseek(filein.Get(), pos.nPos, SEEK_SET))
+            return error("%s: fseek failed for %s", __func__, pos.ToString());
+
+        block.resize(blk_size);
+        filein.read((char*)block.data(), blk_size);
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
 bool ReadFromDisk(CBlockHeader& block, unsigned int nFile, unsigned int nBlockPos)
 {
     return ReadBlockFromDisk(block, CDiskBlockPos(nFile, nBlockPos), Params().GetConsensus());
@@ -1657,6 +1724,17 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
 
+/** Entry of the script execution cache for the scripts of tx checked with flags */
+static uint256 GetScriptExecutionCacheEntry(const CTransaction& tx, unsigned int flags)
+{
+    uint256 hashCacheEntry;
+    // We only use the first 19 bytes of nonce to avoid a second SHA
+    // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
+    static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
+    CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+    return hashCacheEntry;
+}
+
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
@@ -1680,7 +1758,7 @@ void InitScriptExecutionCache() {
  *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, const PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
@@ -1702,11 +1780,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             // correct (ie that the transaction hash which is in tx's prevouts
             // properly commits to the scriptPubKey in the inputs view of that
             // transaction).
-            uint256 hashCacheEntry;
-            // We only use the first 19 bytes of nonce to avoid a second SHA
-            // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
-            static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
-            CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            uint256 hashCacheEntry = GetScriptExecutionCacheEntry(tx, flags);
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
                 return true;
@@ -2052,6 +2126,273 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure representing one lookup of a block input in the coins database.
+ * The result is written to a slot owned by the caller, so that lookups can
+ * run on the prefetch queue while the coins cache itself is only touched
+ * from the thread holding cs_main.
+ */
+class CCoinPrefetch
+{
+private:
+    const CCoinsView *pbase;
+    COutPoint outpoint;
+    Coin *pcoin;
+    char *pfound;
+
+public:
+    CCoinPrefetch(): pbase(nullptr), pcoin(nullptr), pfound(nullptr) {}
+    CCoinPrefetch(const CCoinsView *pbaseIn, const COutPoint &outpointIn, Coin *pcoinIn, char *pfoundIn) :
+        pbase(pbaseIn), outpoint(outpointIn), pcoin(pcoinIn), pfound(pfoundIn) {}
+
+    bool operator()() {
+        try {
+            *pfound = pbase->GetCoin(outpoint, *pcoin);
+        } catch (const std::exception&) {
+            // Leave it to the serial path (and CCoinsViewErrorCatcher) to report read errors
+            *pfound = false;
+        }
+        return true;
+    }
+
+    void swap(CCoinPrefetch &check) {
+        std::swap(pbase, check.pbase);
+        std::swap(outpoint, check.outpoint);
+        std::swap(pcoin, check.pcoin);
+        std::swap(pfound, check.pfound);
+    }
+};
+
+static CCheckQueue<CCoinPrefetch> coinprefetchqueue(16);
+
+void ThreadCoinPrefetch() {
+    RenameThread("bitcoin-coinpf");
+    coinprefetchqueue.Thread();
+}
+
+/**
+ * Read the inputs of all vtx and svtx transactions of a block that are not yet
+ * in pcoinsTip from the coins database concurrently, and insert them into
+ * pcoinsTip, so that ConnectBlock() finds them in memory instead of going to
+ * disk one input at a time.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (!nCoinPrefetchThreads || !pcoinsdbview)
+        return;
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    // Outputs created by the block itself can never be found on disk
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+    for (const auto& stx : block.svtx)
+        setBlockTxids.insert(stx->GetHash());
+
+    std::vector<COutPoint> vOutPoints;
+    for (const std::vector<CTransactionRef>* pvtx : {&block.vtx, &block.svtx}) {
+        for (const auto& tx : *pvtx) {
+            if (tx->IsCoinBase())
+                continue;
+            for (const CTxIn& txin : tx->vin) {
+                if (txin.prevout.IsNull() || setBlockTxids.count(txin.prevout.hash))
+                    continue;
+                if (pcoinsTip->HaveCoinInCache(txin.prevout))
+                    continue;
+                vOutPoints.push_back(txin.prevout);
+            }
+        }
+    }
+    if (vOutPoints.empty())
+        return;
+
+    std::vector<Coin> vCoins(vOutPoints.size());
+    std::vector<char> vFound(vOutPoints.size(), false);
+    {
+        CCheckQueueControl<CCoinPrefetch> control(&coinprefetchqueue);
+        std::vector<CCoinPrefetch> vChecks;
+        vChecks.reserve(vOutPoints.size());
+        for (size_t i = 0; i < vOutPoints.size(); i++)
+            vChecks.emplace_back(pcoinsdbview.get(), vOutPoints[i], &vCoins[i], &vFound[i]);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    size_t nFound = 0;
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        if (vFound[i]) {
+            pcoinsTip->WarmCoin(vOutPoints[i], std::move(vCoins[i]));
+            nFound++;
+        }
+    }
+
+    int64_t nTimeEnd = GetTimeMicros();
+    LogPrint(BCLog::BENCH, "    - Prefetch %u/%u inputs: %.2fms\n", (unsigned int)nFound, (unsigned int)vOutPoints.size(), MILLI * (nTimeEnd - nTimeStart));
+}
+
+/**
+ * Closure representing one script verification of a relayed transaction.
+ * It always succeeds so that the queue keeps running the other checks, a
+ * failure only clears the flag of the transaction, which then stays out of
+ * the script execution cache.
+ */
+class CTxPreCheck
+{
+private:
+    CScriptCheck check;
+    std::atomic<bool> *pfOk;
+
+public:
+    CTxPreCheck(): pfOk(nullptr) {}
+    CTxPreCheck(CScriptCheck &checkIn, std::atomic<bool> *pfOkIn) : pfOk(pfOkIn) {
+        check.swap(checkIn);
+    }
+
+    bool operator()() {
+        if (!check())
+            *pfOk = false;
+        return true;
+    }
+
+    void swap(CTxPreCheck &other) {
+        check.swap(other.check);
+        std::swap(pfOk, other.pfOk);
+    }
+};
+
+static CCheckQueue<CTxPreCheck> txprecheckqueue(128);
+
+void ThreadTxPreCheck() {
+    RenameThread("bitcoin-txprech");
+    txprecheckqueue.Thread();
+}
+
+/** A relayed transaction being pre-verified, kept alive until its checks are done */
+struct CTxPreChecked
+{
+    CTransactionRef tx;
+    PrecomputedTransactionData txdata;
+    std::atomic<bool> fOk;
+
+    explicit CTxPreChecked(const CTransactionRef& txIn) : tx(txIn), txdata(*txIn), fOk(true) {}
+};
+
+size_t PreCheckTransactions(const std::vector<CTransactionRef>& vtx)
+{
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<std::unique_ptr<CTxPreChecked>> vPreChecked;
+    std::vector<CTxPreCheck> vChecks;
+    unsigned int flags;
+    {
+        LOCK2(cs_main, mempool.cs);
+        if (!pcoinsTip)
+            return 0;
+        const CChainParams& chainparams = Params();
+        flags = GetMempoolScriptFlags(chainparams);
+        bool witnessEnabled = IsWitnessEnabled(chainActive.Tip(), chainparams.GetConsensus());
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), mempool);
+        CCoinsViewCache view(&viewMemPool);
+
+        for (const CTransactionRef& ptx : vtx) {
+            const CTransaction& tx = *ptx;
+            // Only the transactions whose inputs CheckInputs verifies one by one,
+            // the same ones ConnectBlock hands to the script check queue
+            if (tx.IsCoinBase() || tx.IsCoinStake() || tx.HasOpSpend() || tx.HasCreateOrCall())
+                continue;
+            CValidationStakeState stakestate;
+            if (DetermineTxType(tx, stakestate) != TxTypeRegular)
+                continue;
+            CValidationState state;
+            std::string reason;
+            if (!CheckTransaction(tx, state) || (fRequireStandard && !IsStandardTx(tx, reason, witnessEnabled)))
+                continue;
+            if (mempool.exists(tx.GetHash()) || !view.HaveInputs(tx))
+                continue;
+            if (fRequireStandard && !AreInputsStandard(tx, view))
+                continue;
+            if (scriptExecutionCache.contains(GetScriptExecutionCacheEntry(tx, flags), false))
+                continue;
+
+            vPreChecked.emplace_back(new CTxPreChecked(ptx));
+            CTxPreChecked& prechecked = *vPreChecked.back();
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                CScriptCheck check(view.AccessCoin(tx.vin[i].prevout).out, tx, i, flags, true, &prechecked.txdata);
+                vChecks.emplace_back(check, &prechecked.fOk);
+            }
+        }
+    }
+    if (vPreChecked.empty())
+        return 0;
+
+    // The signature cache is filled by the checks themselves
+    CCheckQueueControl<CTxPreCheck> control(&txprecheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+
+    size_t nOk = 0;
+    {
+        LOCK(cs_main);
+        for (const auto& prechecked : vPreChecked) {
+            if (prechecked->fOk) {
+                scriptExecutionCache.insert(GetScriptExecutionCacheEntry(*prechecked->tx, flags));
+                nOk++;
+            }
+        }
+    }
+
+    LogPrint(BCLog::MEMPOOL, "Pre-verified %u/%u relayed transactions (%u inputs, %u failed): %.2fms\n",
+        (unsigned int)vPreChecked.size(), (unsigned int)vtx.size(), (unsigned int)vChecks.size(),
+        (unsigned int)(vPreChecked.size() - nOk), MILLI * (GetTimeMicros() - nTimeStart));
+    return vPreChecked.size();
+}
+
+static CWaitableCriticalSection csTxPreCheck;
+static CConditionVariable condTxPreCheck;
+static std::vector<CTransactionRef> vTxPreCheckPending;
+
+void QueueTxPreCheck(const CTransactionRef& tx)
+{
+    if (!nTxPreCheckThreads)
+        return;
+    WaitableLock lock(csTxPreCheck);
+    if (vTxPreCheckPending.size() >= MAX_TXPRECHECK_PENDING)
+        return;
+    vTxPreCheckPending.push_back(tx);
+    // The collector only waits for the first transaction of a window
+    if (vTxPreCheckPending.size() == 1)
+        condTxPreCheck.notify_one();
+}
+
+void ThreadTxPreCheckCollector()
+{
+    RenameThread("bitcoin-txprecc");
+    while (true) {
+        std::vector<CTransactionRef> vtx;
+        {
+            WaitableLock lock(csTxPreCheck);
+            while (vTxPreCheckPending.empty()) {
+                // Not an interruption point, wake up regularly for shutdown
+                condTxPreCheck.wait_for(lock, std::chrono::milliseconds(100));
+                lock.unlock();
+                boost::this_thread::interruption_point();
+                lock.lock();
+            }
+        }
+        // Let more transactions arrive, so that the window is verified in parallel
+        MilliSleep(nTxPreCheckWindow);
+        {
+            WaitableLock lock(csTxPreCheck);
+            vtx.swap(vTxPreCheckPending);
+        }
+        // The workers may be interrupted while this thread waits for them as the master,
+        // it then runs the remaining checks itself
+        boost::this_thread::disable_interruption di;
+        PreCheckTransactions(vtx);
+    }
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2489,6 +2830,10 @@ void writeVMlog(const std::vector<ResultExecute>& res, const CTransaction& tx, c
 }
 
 bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
+    // Accounts changed by the transactions are written to the state trie once,
+    // after the last one, or at the end of the block when connecting one. The
+    // receipts carry the state root from before that.
+    AccountWriteBack writeBack(globalState);
     for(QtumTransaction& tx : txs){
         //validate VM version
         if(tx.getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw()){
@@ -2503,6 +2848,7 @@ bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
         }
         result.push_back(globalState->execute(envInfo, *globalSealEngine.get(), tx, type, OnOpFunc()));
     }
+    writeBack.flush();
     globalState->db().commit();
     globalState->dbUtxo().commit();
     globalSealEngine.get()->deleteAddresses.clear();
@@ -2693,6 +3039,15 @@ QtumTransaction QtumTxConverter::createEthTX(const EthTransactionParams& etp, ui
 }
 ///////////////////////////////////////////////////////////////////////
 
+/** The signature hash data of tx, reusing the one computed when it was accepted to the mempool */
+static std::shared_ptr<const PrecomputedTransactionData> GetPrecomputedTxData(const CTransaction& tx)
+{
+    std::shared_ptr<const PrecomputedTransactionData> txdata = mempool.GetTxData(tx.GetHash());
+    if (!txdata)
+        txdata = std::make_shared<const PrecomputedTransactionData>(tx);
+    return txdata;
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -2855,8 +3210,13 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
     /////////////////////////////////////////////////////////
 
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    // Accounts changed by the contract executions are hashed into the state
+    // trie once, before the state root is checked
+    AccountWriteBack blockWriteBack(globalState);
+
+    // Shared, so that the checks keep pointing to them as the vector grows
+    std::vector<std::shared_ptr<const PrecomputedTransactionData>> txdata;
+    txdata.reserve(block.vtx.size() + block.svtx.size());
     uint64_t blockGasUsed = 0;
     CAmount gasRefunds=0;
 
@@ -2904,7 +3264,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        txdata.push_back(GetPrecomputedTxData(tx));
 
         bool hasOpSpend = tx.HasOpSpend();
 
@@ -2916,7 +3276,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
             //note that coinbase and coinstake can not contain any contract opcodes, this is checked in CheckBlock
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, *txdata.back(), (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
@@ -3116,14 +3476,14 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        txdata.push_back(GetPrecomputedTxData(tx));
 
         bool hasOpSpend = tx.HasOpSpend();
 
 		std::vector<CScriptCheck> vChecks;
 		bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
 		//note that coinbase and coinstake can not contain any contract opcodes, this is checked in CheckBlock
-		if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
+		if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, *txdata.back(), (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
 			return error("ConnectBlock(): CheckInputs on %s failed with %s",
 				tx.GetHash().ToString(), FormatStateMessage(state));
 		control.Add(vChecks);
@@ -3167,6 +3527,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
 ////////////////////////////////////////////////////////////////// // qtum
     checkBlock.hashMerkleRoot = BlockMerkleRoot(checkBlock);
+    blockWriteBack.flush();
+    globalState->db().commit();
     checkBlock.hashStateRoot = h256Touint(globalState->rootHash());
     checkBlock.hashUTXORoot = h256Touint(globalState->rootHashUTXO());
 
@@ -3526,8 +3888,13 @@ bool CChainState::ConnectBlockMock(const CBlock& block, const CBlock& parent, CV
     }
     ////////////////////////////////////////////////////////////////
 
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    // Accounts changed by the contract executions are hashed into the state
+    // trie once, before the state root is checked
+    AccountWriteBack blockWriteBack(globalState);
+
+    // Shared, so that the checks keep pointing to them as the vector grows
+    std::vector<std::shared_ptr<const PrecomputedTransactionData>> txdata;
+    txdata.reserve(block.vtx.size() + block.svtx.size());
     uint64_t blockGasUsed = 0;
     CAmount gasRefunds=0;
 
@@ -3581,7 +3948,7 @@ bool CChainState::ConnectBlockMock(const CBlock& block, const CBlock& parent, CV
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        txdata.push_back(GetPrecomputedTxData(tx));
 
         bool hasOpSpend = tx.HasOpSpend();
 
@@ -3593,7 +3960,7 @@ bool CChainState::ConnectBlockMock(const CBlock& block, const CBlock& parent, CV
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
             //note that coinbase and coinstake can not contain any contract opcodes, this is checked in CheckBlock
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, *txdata.back(), (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
@@ -3808,14 +4175,14 @@ bool CChainState::ConnectBlockMock(const CBlock& block, const CBlock& parent, CV
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        txdata.push_back(GetPrecomputedTxData(tx));
 
         bool hasOpSpend = tx.HasOpSpend();
 
 		std::vector<CScriptCheck> vChecks;
 		bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
 		//note that coinbase and coinstake can not contain any contract opcodes, this is checked in CheckBlock
-		if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
+		if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, *txdata.back(), (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
 			return error("ConnectBlock(): CheckInputs on %s failed with %s",
 				tx.GetHash().ToString(), FormatStateMessage(state));
 		control.Add(vChecks);
@@ -3864,6 +4231,8 @@ bool CChainState::ConnectBlockMock(const CBlock& block, const CBlock& parent, CV
 
 ////////////////////////////////////////////////////////////////// // qtum
     checkBlock.hashMerkleRoot = BlockMerkleRoot(checkBlock);
+    blockWriteBack.flush();
+    globalState->db().commit();
     checkBlock.hashStateRoot = h256Touint(globalState->rootHash());
     checkBlock.hashUTXORoot = h256Touint(globalState->rootHashUTXO());
 
@@ -4099,6 +4468,13 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
+            // The contract state of the best block must be durable before the chainstate points to it.
+            if (globalState) {
+                globalState->db().flushCommits(true);
+                globalState->dbUtxo().flushCommits(true);
+            }
+            if (pstorageresult)
+                pstorageresult->flushResults(true);
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
@@ -4129,6 +4505,28 @@ void PruneAndFlush() {
     FlushStateToDisk(chainparams, state, FLUSH_STATE_NONE);
 }
 
+void UpdateStateSnapshot()
+{
+    const std::shared_ptr<dev::eth::StateSnapshot> snapshot = globalState->snapshot();
+    if (!snapshot)
+        return;
+    dev::h256 hashStateRoot = globalState->rootHash();
+    if (snapshot->cap(hashStateRoot))
+        return;
+
+    // After an unclean shutdown or a reorganization deeper than the diff layers
+    LogPrintf("Generating the contract state snapshot at %s\n", hashStateRoot.hex());
+    int64_t nStart = GetTimeMillis();
+    try {
+        snapshot->generate(globalState->db(), hashStateRoot);
+    } catch (const std::exception& e) {
+        LogPrintf("Error generating the contract state snapshot, reading the state trie instead: %s\n", e.what());
+        globalState->setSnapshot(nullptr);
+        return;
+    }
+    LogPrintf("Generated the contract state snapshot (%dms)\n", GetTimeMillis() - nStart);
+}
+
 static void DoWarning(const std::string& strWarning)
 {
     static bool fWarned = false;
@@ -4343,6 +4741,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    PrefetchBlockInputs(blockConnecting);
     {
         CCoinsViewCache view(pcoinsTip.get());
 
@@ -4376,6 +4775,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
+        UpdateStateSnapshot(); // qtum
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
@@ -5165,23 +5565,31 @@ bool CheckSSGenVote(const CBlock& block, const CTransaction& stx){
 }
 
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
+/**
+ * CheckBlock, with fContextFreeOnly only the checks that depend on nothing but the block:
+ * neither the adjusted time, the tip nor the parameters of the DGP. Those may run without
+ * cs_main and are skipped by later calls once the block passed them.
+ */
+static bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig, bool fContextFreeOnly)
 {
     // These are checks that are independent of context.
 
-    if (block.fChecked)
+    if (block.fChecked || (fContextFreeOnly && block.fCheckedContextFree))
         return true;
 
+    const bool fContextFree = !block.fCheckedContextFree;
+    const bool fContextual = !fContextFreeOnly;
+
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW, false))
+    if (fContextFree && !CheckBlockHeader(block, state, consensusParams, fCheckPOW, false))
         return false;
 
-    if (block.IsProofOfStake() &&  block.GetBlockTime() > FutureDrift(GetAdjustedTime()))
+    if (fContextual && block.IsProofOfStake() &&  block.GetBlockTime() > FutureDrift(GetAdjustedTime()))
         return error("CheckBlock() : block timestamp too far in the future");
 
     // Check the merkle root.
-    if (fCheckMerkleRoot) {
+    if (fContextFree && fCheckMerkleRoot) {
         bool mutated;
         uint256 hashMerkleRoot2 = BlockMerkleRoot(block, &mutated);
         if (block.hashMerkleRoot != hashMerkleRoot2)
@@ -5205,58 +5613,60 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     // Note that witness malleability is checked in ContextualCheckBlock, so no
     // checks that use witness data may be performed here.
 
-    // First transaction must be coinbase, the rest must not be
-    if (block.vtx.empty() || !block.vtx[0]->IsCoinBase())
-        return state.DoS(100, false, REJECT_INVALID, "bad-cb-missing", false, "first tx is not coinbase");
-    for (unsigned int i = 1; i < block.vtx.size(); i++)
-        if (block.vtx[i]->IsCoinBase())
-            return state.DoS(100, false, REJECT_INVALID, "bad-cb-multiple", false, "more than one coinbase");
+    if (fContextFree) {
+        // First transaction must be coinbase, the rest must not be
+        if (block.vtx.empty() || !block.vtx[0]->IsCoinBase())
+            return state.DoS(100, false, REJECT_INVALID, "bad-cb-missing", false, "first tx is not coinbase");
+        for (unsigned int i = 1; i < block.vtx.size(); i++)
+            if (block.vtx[i]->IsCoinBase())
+                return state.DoS(100, false, REJECT_INVALID, "bad-cb-multiple", false, "more than one coinbase");
 
-    //Don't allow contract opcodes in coinbase
-    if(block.vtx[0]->HasOpSpend() || block.vtx[0]->HasCreateOrCall()){
-        return state.DoS(100, false, REJECT_INVALID, "bad-cb-contract", false, "coinbase must not contain OP_SPEND, OP_CALL, or OP_CREATE");
-    }
+        //Don't allow contract opcodes in coinbase
+        if(block.vtx[0]->HasOpSpend() || block.vtx[0]->HasCreateOrCall()){
+            return state.DoS(100, false, REJECT_INVALID, "bad-cb-contract", false, "coinbase must not contain OP_SPEND, OP_CALL, or OP_CREATE");
+        }
 
-    // Second transaction must be coinbase in case of PoS block, the rest must not be
-    if (block.IsProofOfStake())
-    {
-        // Coinbase output should be empty if proof-of-stake block
-        if (!CheckFirstCoinstakeOutput(block))
-            return state.DoS(100, false, REJECT_INVALID, "bad-cb-missing", false, "coinbase output not empty for proof-of-stake block");
+        // Second transaction must be coinbase in case of PoS block, the rest must not be
+        if (block.IsProofOfStake())
+        {
+            // Coinbase output should be empty if proof-of-stake block
+            if (!CheckFirstCoinstakeOutput(block))
+                return state.DoS(100, false, REJECT_INVALID, "bad-cb-missing", false, "coinbase output not empty for proof-of-stake block");
 
-        // Second transaction must be coinstake
-        if (block.vtx.empty() || block.vtx.size() < 2 || !block.vtx[1]->IsCoinStake())
-            return state.DoS(100, false, REJECT_INVALID, "bad-cs-missing", false, "second tx is not coinstake");
+            // Second transaction must be coinstake
+            if (block.vtx.empty() || block.vtx.size() < 2 || !block.vtx[1]->IsCoinStake())
+                return state.DoS(100, false, REJECT_INVALID, "bad-cs-missing", false, "second tx is not coinstake");
 
-        //prevoutStake must exactly match the coinstake in the block body
-        if(block.vtx[1]->vin.empty() || block.prevoutStake != block.vtx[1]->vin[0].prevout){
-            return state.DoS(100, false, REJECT_INVALID, "bad-cs-invalid", false, "prevoutStake in block header does not match coinstake in block body");
+            //prevoutStake must exactly match the coinstake in the block body
+            if(block.vtx[1]->vin.empty() || block.prevoutStake != block.vtx[1]->vin[0].prevout){
+                return state.DoS(100, false, REJECT_INVALID, "bad-cs-invalid", false, "prevoutStake in block header does not match coinstake in block body");
+            }
+            //the rest of the transactions must not be coinstake
+            for (unsigned int i = 2; i < block.vtx.size(); i++)
+                if (block.vtx[i]->IsCoinStake())
+                   return state.DoS(100, false, REJECT_INVALID, "bad-cs-multiple", false, "more than one coinstake");
+
+            //Don't allow contract opcodes in coinstake
+            //We might allow this later, but it hasn't been tested enough to determine if safe
+            if(block.vtx[1]->HasOpSpend() || block.vtx[1]->HasCreateOrCall()){
+                return state.DoS(100, false, REJECT_INVALID, "bad-cs-contract", false, "coinstake must not contain OP_SPEND, OP_CALL, or OP_CREATE");
+            }
         }
-        //the rest of the transactions must not be coinstake
-        for (unsigned int i = 2; i < block.vtx.size(); i++)
-            if (block.vtx[i]->IsCoinStake())
-               return state.DoS(100, false, REJECT_INVALID, "bad-cs-multiple", false, "more than one coinstake");
 
-        //Don't allow contract opcodes in coinstake
-        //We might allow this later, but it hasn't been tested enough to determine if safe
-        if(block.vtx[1]->HasOpSpend() || block.vtx[1]->HasCreateOrCall()){
-            return state.DoS(100, false, REJECT_INVALID, "bad-cs-contract", false, "coinstake must not contain OP_SPEND, OP_CALL, or OP_CREATE");
-        }
+        // Check proof-of-stake block signature
+        if (fCheckSig && !CheckBlockSignature(block))
+            return state.DoS(100, false, REJECT_INVALID, "bad-blk-signature", false, "bad proof-of-stake block signature");
     }
 
-    // Check proof-of-stake block signature
-    if (fCheckSig && !CheckBlockSignature(block))
-        return state.DoS(100, false, REJECT_INVALID, "bad-blk-signature", false, "bad proof-of-stake block signature");
-
     bool lastWasContract=false;
     // Check transactions
     for (const auto& tx : block.vtx) {
-        if (!CheckTransaction(*tx, state, true))
+        if (!(fContextFree ? CheckTransaction(*tx, state, true, fContextual) : CheckTransactionBlockWeight(*tx, state)))
             return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
                                  strprintf("Transaction check failed (tx hash %s) %s", tx->GetHash().ToString(), state.GetDebugMessage()));
         //OP_SPEND can only exist immediately after a contract tx in a block, or after another OP_SPEND
         //So, if the previous tx was not a contract tx, fail it.
-        if(tx->HasOpSpend()){
+        if(fContextFree && tx->HasOpSpend()){
             if(!lastWasContract){
                 return state.DoS(100, false, REJECT_INVALID, "bad-opspend-tx", false, "OP_SPEND transaction without corresponding contract transaction");
             }
@@ -5264,6 +5674,11 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
         lastWasContract = tx->HasCreateOrCall() || tx->HasOpSpend();
     }
 
+    if (fContextFreeOnly) {
+        block.fCheckedContextFree = fCheckPOW && fCheckMerkleRoot && fCheckSig;
+        return true;
+    }
+
     unsigned int nSigOps = 0;
     for (const auto& tx : block.vtx)
     {
@@ -5296,6 +5711,16 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     return true;
 }
 
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
+{
+    return CheckBlock(block, state, consensusParams, fCheckPOW, fCheckMerkleRoot, fCheckSig, false);
+}
+
+bool CheckBlockContextFree(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams)
+{
+    return CheckBlock(block, state, consensusParams, true, true, true, true);
+}
+
 bool IsWitnessEnabled(const CBlockIndex* pindexPrev, const Consensus::Params& params)
 {
     LOCK(cs_main);
@@ -5593,7 +6018,10 @@ bool CheckPOS(const CBlockHeader& block, CBlockIndex* pindexPrev)
     return false;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+/**
+ * fPreChecked skips the checks done by CHeaderCheck, the caller ran them and they passed
+ */
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fPreChecked)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -5625,7 +6053,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
         }
 
         // Check for the signiture encoding
-        if (!CheckCanonicalBlockSignature(&block))
+        if (!fPreChecked && !CheckCanonicalBlockSignature(&block))
         {
             return state.DoS(100, false, REJECT_INVALID, "bad-signature-encoding", false,"AcceptBlockHeader(): bad block signature encoding");
         }
@@ -5675,7 +6103,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 
         // Check block header
         // if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), true, CheckPOS(block, pindexPrev)))
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), !fPreChecked))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
     }
     if (pindex == nullptr)
@@ -5689,16 +6117,70 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     return true;
 }
 
+/**
+ * Closure representing the checks of one block header that do not depend on
+ * the chain: the proof of work of PoW headers and the encoding of the block
+ * signature. The result is written to a slot owned by the caller, a failed
+ * check is left to AcceptBlockHeader to report.
+ */
+class CHeaderCheck
+{
+private:
+    const CBlockHeader *pheader;
+    const Consensus::Params *pconsensus;
+    char *pfOk;
+
+public:
+    CHeaderCheck(): pheader(nullptr), pconsensus(nullptr), pfOk(nullptr) {}
+    CHeaderCheck(const CBlockHeader *pheaderIn, const Consensus::Params *pconsensusIn, char *pfOkIn) :
+        pheader(pheaderIn), pconsensus(pconsensusIn), pfOk(pfOkIn) {}
+
+    bool operator()() {
+        *pfOk = CheckCanonicalBlockSignature(pheader) &&
+                (!pheader->IsProofOfWork() || CheckHeaderPoW(*pheader, *pconsensus));
+        return true;
+    }
+
+    void swap(CHeaderCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(pconsensus, check.pconsensus);
+        std::swap(pfOk, check.pfOk);
+    }
+};
+
+static CCheckQueue<CHeaderCheck> headercheckqueue(64);
+
+void ThreadHeaderCheck() {
+    RenameThread("bitcoin-headerch");
+    headercheckqueue.Thread();
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid,  const CBlockIndex** pindexFirst)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Check the headers of a batch concurrently before cs_main is taken
+    std::vector<char> vPreChecked(headers.size(), false);
+    if (nHeaderCheckThreads && headers.size() > 1) {
+        int64_t nTimeStart = GetTimeMicros();
+        CCheckQueueControl<CHeaderCheck> control(&headercheckqueue);
+        std::vector<CHeaderCheck> vChecks;
+        vChecks.reserve(headers.size());
+        for (size_t i = 0; i < headers.size(); i++)
+            vChecks.emplace_back(&headers[i], &chainparams.GetConsensus(), &vPreChecked[i]);
+        control.Add(vChecks);
+        control.Wait();
+        LogPrint(BCLog::BENCH, "    - Check %u headers: %.2fms\n", (unsigned int)headers.size(), MILLI * (GetTimeMicros() - nTimeStart));
+    }
+
     {
         LOCK(cs_main);
         bool bFirst = true;
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, vPreChecked[i])) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -6311,6 +6793,9 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("logevents", fLogEvents);
     LogPrintf("%s: log events index %s\n", __func__, fLogEvents ? "enabled" : "disabled");
 
+    // Check whether contract state trie nodes have been pruned
+    pblocktree->ReadFlag("prunedstate", fHavePrunedState);
+
     return true;
 }
 
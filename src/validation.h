@@ -106,11 +106,29 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** The maximum serialized size of a stored block, the largest the DGP can allow whatever it allows now */
+static const unsigned int MAX_STORED_BLOCK_SER_SIZE = WITNESS_SCALE_FACTOR * MAX_BLOCK_SIZE_DGP;
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of coin prefetch threads allowed */
+static const int MAX_COINPREFETCH_THREADS = 16;
+/** -prefetchthreads default (number of threads reading block inputs from the coins db, 0 = disabled) */
+static const int DEFAULT_COINPREFETCH_THREADS = 4;
+/** Maximum number of relayed transaction pre-verification threads allowed */
+static const int MAX_TXPRECHECK_THREADS = 16;
+/** -txprecheckthreads default (number of threads verifying relayed transactions before AcceptToMemoryPool, 0 = disabled) */
+static const int DEFAULT_TXPRECHECK_THREADS = 0;
+/** -txprecheckwindow default (milliseconds relayed transactions are collected for before being pre-verified together) */
+static const int64_t DEFAULT_TXPRECHECK_WINDOW = 20;
+/** Maximum number of relayed transactions waiting for pre-verification, more are left to AcceptToMemoryPool */
+static const size_t MAX_TXPRECHECK_PENDING = 10000;
+/** Maximum number of header checking threads allowed */
+static const int MAX_HEADERCHECK_THREADS = 16;
+/** -headercheckthreads default (number of threads checking received headers before cs_main is taken, 0 = disabled) */
+static const int DEFAULT_HEADERCHECK_THREADS = 2;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -165,6 +183,8 @@ static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = true;	// for check ssgen script must set -txindex true
 static const bool DEFAULT_LOGEVENTS = false;
+/** Default for -statesnapshot */
+static const bool DEFAULT_STATE_SNAPSHOT = true;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -212,6 +232,10 @@ extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+extern int nCoinPrefetchThreads;
+extern int nTxPreCheckThreads;
+extern int64_t nTxPreCheckWindow;
+extern int nHeaderCheckThreads;
 extern bool fTxIndex;
 extern bool fLogEvents;
 extern bool fIsBareMultisigStd;
@@ -248,6 +272,12 @@ extern bool fPruneMode;
 extern uint64_t nPruneTarget;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
 static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
+/** True if contract state trie nodes have ever been pruned. */
+extern bool fHavePrunedState;
+/** Number of blocks whose contract state is kept by -prunestate, 0 to keep the state of all blocks. */
+extern unsigned int nStatePruneDepth;
+/** Minimum number of blocks whose contract state is kept by -prunestate, enough for reorgs and -checkblocks. */
+static const unsigned int MIN_STATE_BLOCKS_TO_KEEP = 288;
 /** Minimum blocks required to signal NODE_NETWORK_LIMITED */
 static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
@@ -321,6 +351,24 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the coin prefetch thread */
+void ThreadCoinPrefetch();
+/** Run an instance of the relayed transaction pre-verification worker thread */
+void ThreadTxPreCheck();
+/** Run the thread collecting relayed transactions for pre-verification, it verifies them together with the workers */
+void ThreadTxPreCheckCollector();
+/** Run an instance of the header checking thread */
+void ThreadHeaderCheck();
+/** Queue a relayed transaction for pre-verification, if enabled */
+void QueueTxPreCheck(const CTransactionRef& tx);
+/**
+ * Verify the scripts of relayed transactions that are not in the mempool yet on the
+ * pre-verification threads, filling the signature cache and, for the transactions whose
+ * inputs all pass, the script execution cache with the mempool's script flags. Transactions
+ * that are invalid, non-standard or spend unknown outputs are left to AcceptToMemoryPool.
+ * @return the number of transactions pre-verified
+ */
+size_t PreCheckTransactions(const std::vector<CTransactionRef>& vtx);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -351,6 +399,8 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
+/** Move the contract state snapshot to the current state root, regenerating it from the trie if it lost track of it. */
+void UpdateStateSnapshot();
 /** Prune block files up to a given height */
 void PruneBlockFilesManual(int nManualPruneHeight);
 /** Check if the transaction is confirmed in N previous blocks */
@@ -358,10 +408,12 @@ bool IsConfirmedInNPrevBlocks(const CDiskTxPos& txindex, const CBlockIndex* pind
 
 
 /** (try to) add transaction to memory pool
- * plTxnReplaced will be appended to with all transactions replaced from mempool **/
+ * plTxnReplaced will be appended to with all transactions replaced from mempool
+ * fPreChecked skips CheckTransaction and the coinbase/coinstake checks, the caller did them
+ * without the size check against the block weight of the DGP **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
-                        bool bypass_limits, const CAmount nAbsurdFee, bool rawTx = false);
+                        bool bypass_limits, const CAmount nAbsurdFee, bool rawTx = false, bool fPreChecked = false);
 
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
@@ -487,11 +539,11 @@ private:
     unsigned int nFlags;
     bool cacheStore;
     ScriptError error;
-    PrecomputedTransactionData *txdata;
+    const PrecomputedTransactionData *txdata;
 
 public:
     CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
+    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, const PrecomputedTransactionData* txdataIn) :
         m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
     bool operator()();
@@ -518,6 +570,10 @@ void InitScriptExecutionCache();
 template <typename Block>
 bool ReadBlockFromDisk(Block& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Append block with its index header to the block file at pos, and set pos to the position of the block */
+bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+/** Read the serialized block of pindex as stored in the block files, after checking its index header and block hash */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 bool ReadFromDisk(CBlockHeader& block, unsigned int nFile, unsigned int nBlockPos);
 bool ReadFromDisk(CMutableTransaction& tx, CDiskTxPos& txindex, CBlockTreeDB& txdb, COutPoint prevout);
 bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensusParams);
@@ -526,6 +582,8 @@ bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensu
 
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig=true);
+/** The checks of CheckBlock that do not read the adjusted time, the tip or the DGP, which may run without cs_main. CheckBlock skips them for a block that passed. */
+bool CheckBlockContextFree(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams);
 bool GetBlockPublicKey(const CBlock& block, std::vector<unsigned char>& vchPubKey);
 bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& nTotalFees, uint32_t nTime);
 bool CheckCanonicalBlockSignature(const CBlockHeader* pblock);
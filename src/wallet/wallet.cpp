@@ -2220,9 +2220,15 @@ bool CWalletTx::RelayWalletTransaction(CConnman* connman)
             LogPrintf("Relaying wtx %s\n", GetHash().ToString());
             if (connman) {
                 CInv inv(MSG_TX, GetHash());
-                connman->ForEachNode([&inv](CNode* pnode)
+                // Votes skip the inventory trickle, the next block needs them
+                CValidationStakeState stakestate;
+                const bool fVote = IsSSGen(*tx, stakestate);
+                connman->ForEachNode([&inv, fVote](CNode* pnode)
                 {
-                    pnode->PushInventory(inv);
+                    if (fVote)
+                        pnode->PushVoteInventory(inv.hash);
+                    else
+                        pnode->PushInventory(inv);
                 });
                 return true;
             }
@@ -8,14 +8,18 @@
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util.h>
+#include <rpc/net.h>
 #include <rpc/server.h>
 
+#include <univalue.h>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_MSGSTATS  = "msgstats";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -195,3 +199,10 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishMsgStatsNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish msgstats at %s\n", pindex->GetBlockHash().GetHex());
+    std::string strStats = msgTimeStatsToJSON().write();
+    return SendMessage(MSG_MSGSTATS, strStats.data(), strStats.size());
+}
@@ -52,4 +52,11 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+/** Publishes the time spent on received messages, as returned by getmsgtimestats, on each new tip */
+class CZMQPublishMsgStatsNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H